@@ -0,0 +1,629 @@
+#include "headless_graphics_provider.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace hui
+{
+void HeadlessTextureArray::resize(u32 count, u32 newWidth, u32 newHeight)
+{
+	textureCount = count;
+	width = newWidth;
+	height = newHeight;
+
+	if (keepPixels)
+	{
+		pixels.assign((size_t)count * width * height, 0);
+	}
+}
+
+void HeadlessTextureArray::updateData(Rgba32* newPixels)
+{
+	if (!keepPixels)
+		return;
+
+	memcpy(pixels.data(), newPixels, pixels.size() * sizeof(Rgba32));
+}
+
+void HeadlessTextureArray::updateLayerData(u32 textureIndex, Rgba32* newPixels)
+{
+	if (!keepPixels || textureIndex >= textureCount)
+		return;
+
+	size_t layerSize = (size_t)width * height;
+
+	memcpy(pixels.data() + layerSize * textureIndex, newPixels, layerSize * sizeof(Rgba32));
+}
+
+void HeadlessTextureArray::updateRectData(u32 textureIndex, const Rect& rect, Rgba32* newPixels)
+{
+	if (!keepPixels || textureIndex >= textureCount)
+		return;
+
+	u32 rectX = rect.x;
+	u32 rectY = rect.y;
+	u32 rectWidth = rect.width;
+	u32 rectHeight = rect.height;
+	Rgba32* layer = pixels.data() + (size_t)width * height * textureIndex;
+
+	for (u32 y = 0; y < rectHeight; y++)
+	{
+		if (rectY + y >= height)
+			break;
+
+		u32 copyWidth = rectX + rectWidth > width ? width - rectX : rectWidth;
+
+		memcpy(layer + (size_t)(rectY + y) * width + rectX, newPixels + (size_t)y * rectWidth, copyWidth * sizeof(Rgba32));
+	}
+}
+
+Rgba32 HeadlessTextureArray::getTexel(u32 textureIndex, i32 x, i32 y) const
+{
+	if (pixels.empty() || textureIndex >= textureCount)
+		return ~0;
+
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x >= (i32)width) x = width - 1;
+	if (y >= (i32)height) y = height - 1;
+
+	return pixels[(size_t)width * height * textureIndex + (size_t)y * width + x];
+}
+
+void HeadlessVertexBuffer::resize(u32 count)
+{
+	vertexCount = count;
+
+	if (keepVertices)
+	{
+		vertices.resize(count);
+		packedVertices.resize(count);
+	}
+}
+
+void HeadlessVertexBuffer::updateData(Vertex* newVertices, u32 startVertexIndex, u32 count)
+{
+	updateDataRange(newVertices + startVertexIndex, startVertexIndex, count);
+}
+
+bool HeadlessVertexBuffer::updateDataRange(Vertex* newVertices, u32 startVertexIndex, u32 count)
+{
+	if (!keepVertices || startVertexIndex + count > vertices.size())
+		return true;
+
+	std::copy(newVertices, newVertices + count, vertices.begin() + startVertexIndex);
+	return true;
+}
+
+void HeadlessVertexBuffer::updatePackedData(PackedVertex* newVertices, u32 startVertexIndex, u32 count)
+{
+	if (!keepVertices || startVertexIndex + count > packedVertices.size())
+		return;
+
+	std::copy(newVertices + startVertexIndex, newVertices + startVertexIndex + count, packedVertices.begin() + startVertexIndex);
+}
+
+void HeadlessIndexBuffer::resize(u32 count)
+{
+	if (keepIndices)
+	{
+		indices.resize(count);
+	}
+}
+
+void HeadlessIndexBuffer::updateData(u32* newIndices, u32 startIndex, u32 count)
+{
+	if (!keepIndices || startIndex + count > indices.size())
+		return;
+
+	memcpy(indices.data() + startIndex, newIndices + startIndex, count * sizeof(u32));
+}
+
+HeadlessGraphicsProvider::HeadlessGraphicsProvider(HeadlessRenderMode newMode, VertexFormat format)
+	: mode(newMode)
+	, vertexFormat(format)
+{}
+
+HeadlessGraphicsProvider::~HeadlessGraphicsProvider()
+{}
+
+TextureArray* HeadlessGraphicsProvider::createTextureArray()
+{
+	return new HeadlessTextureArray(mode == HeadlessRenderMode::Software);
+}
+
+VertexBuffer* HeadlessGraphicsProvider::createVertexBuffer()
+{
+	return new HeadlessVertexBuffer(mode == HeadlessRenderMode::Software);
+}
+
+IndexBuffer* HeadlessGraphicsProvider::createIndexBuffer()
+{
+	return new HeadlessIndexBuffer(mode == HeadlessRenderMode::Software);
+}
+
+GraphicsApiRenderTarget HeadlessGraphicsProvider::createRenderTarget(u32 width, u32 height)
+{
+	HeadlessRenderTarget* rt = new HeadlessRenderTarget();
+
+	rt->width = width;
+	rt->height = height;
+	rt->textureArray = new HeadlessTextureArray(mode == HeadlessRenderMode::Software);
+	rt->textureArray->resize(1, width, height);
+
+	if (mode == HeadlessRenderMode::Software)
+	{
+		rt->pixels.assign((size_t)width * height, 0);
+	}
+
+	return rt;
+}
+
+void HeadlessGraphicsProvider::destroyRenderTarget(GraphicsApiRenderTarget rt)
+{
+	HeadlessRenderTarget* headlessRt = (HeadlessRenderTarget*)rt;
+
+	if (currentRenderTarget == headlessRt)
+	{
+		currentRenderTarget = &framebuffer;
+	}
+
+	delete headlessRt->textureArray;
+	delete headlessRt;
+}
+
+void HeadlessGraphicsProvider::setRenderTarget(GraphicsApiRenderTarget rt)
+{
+	// like a GPU resolve, the texture gets what was drawn into the render target
+	if (currentRenderTarget->textureArray && currentRenderTarget->textureArray->keepPixels)
+	{
+		currentRenderTarget->textureArray->pixels = currentRenderTarget->pixels;
+	}
+
+	currentRenderTarget = rt ? (HeadlessRenderTarget*)rt : &framebuffer;
+}
+
+void HeadlessGraphicsProvider::setViewport(const Point& windowSize, const Rect& viewport)
+{
+	currentViewport = viewport;
+
+	if (currentRenderTarget != &framebuffer)
+		return;
+
+	u32 width = windowSize.x;
+	u32 height = windowSize.y;
+
+	if (framebuffer.width != width || framebuffer.height != height)
+	{
+		framebuffer.width = width;
+		framebuffer.height = height;
+
+		if (mode == HeadlessRenderMode::Software)
+		{
+			framebuffer.pixels.assign((size_t)width * height, 0);
+		}
+	}
+}
+
+void HeadlessGraphicsProvider::clear(const Color& color)
+{
+	if (mode == HeadlessRenderMode::Null)
+		return;
+
+	auto rt = currentRenderTarget;
+
+	if (!scissorEnabled)
+	{
+		std::fill(rt->pixels.begin(), rt->pixels.end(), color.getRgba());
+		return;
+	}
+
+	i32 minX = std::max((i32)scissorRect.x, 0);
+	i32 minY = std::max((i32)scissorRect.y, 0);
+	i32 maxX = std::min((i32)(scissorRect.x + scissorRect.width), (i32)rt->width);
+	i32 maxY = std::min((i32)(scissorRect.y + scissorRect.height), (i32)rt->height);
+
+	for (i32 y = minY; y < maxY && minX < maxX; y++)
+	{
+		Rgba32* row = rt->pixels.data() + (size_t)y * rt->width;
+
+		std::fill(row + minX, row + maxX, color.getRgba());
+	}
+}
+
+void HeadlessGraphicsProvider::draw(RenderBatch* batches, u32 count)
+{
+	for (u32 i = 0; i < count; i++)
+	{
+		auto& batch = batches[i];
+		u32 elementCount = batch.indexBuffer ? batch.indexCount : batch.vertexCount;
+
+		drawnBatchCount++;
+
+		if (batch.primitiveType == RenderBatch::PrimitiveType::TriangleList)
+			drawnTriangleCount += elementCount / 3;
+		else if (elementCount >= 3)
+			drawnTriangleCount += elementCount - 2;
+
+		if (mode == HeadlessRenderMode::Null)
+			continue;
+
+		auto vertexBuffer = (HeadlessVertexBuffer*)batch.vertexBuffer;
+		auto indexBuffer = (HeadlessIndexBuffer*)batch.indexBuffer;
+		auto textureArray = (HeadlessTextureArray*)batch.textureArray;
+		u32 start = batch.indexBuffer ? batch.startIndex : batch.startVertexIndex;
+
+		if (indexBuffer && start + elementCount > indexBuffer->indices.size())
+			continue;
+
+		auto getVertexIndex = [&](u32 element)
+		{
+			return indexBuffer ? indexBuffer->indices[start + element] : start + element;
+		};
+
+		for (u32 t = 0; t + 2 < elementCount;)
+		{
+			u32 i0, i1, i2;
+
+			switch (batch.primitiveType)
+			{
+			case RenderBatch::PrimitiveType::TriangleList:
+				i0 = getVertexIndex(t);
+				i1 = getVertexIndex(t + 1);
+				i2 = getVertexIndex(t + 2);
+				t += 3;
+				break;
+			case RenderBatch::PrimitiveType::TriangleStrip:
+				i0 = getVertexIndex(t);
+				i1 = getVertexIndex(t + 1);
+				i2 = getVertexIndex(t + 2);
+				t++;
+				break;
+			case RenderBatch::PrimitiveType::TriangleFan:
+			default:
+				i0 = getVertexIndex(0);
+				i1 = getVertexIndex(t + 1);
+				i2 = getVertexIndex(t + 2);
+				t++;
+				break;
+			}
+
+			if (i0 >= vertexBuffer->vertexCount
+				|| i1 >= vertexBuffer->vertexCount
+				|| i2 >= vertexBuffer->vertexCount)
+				continue;
+
+			rasterizeTriangle(
+				getBatchVertex(vertexBuffer, i0),
+				getBatchVertex(vertexBuffer, i1),
+				getBatchVertex(vertexBuffer, i2),
+				textureArray);
+		}
+	}
+}
+
+Vertex HeadlessGraphicsProvider::getBatchVertex(const HeadlessVertexBuffer* vertexBuffer, u32 index) const
+{
+	if (vertexFormat == VertexFormat::Full)
+		return vertexBuffer->vertices[index];
+
+	auto& packed = vertexBuffer->packedVertices[index];
+	Vertex vtx;
+
+	vtx.position = packed.position;
+	vtx.uv.x = (f32)(packed.uvAndTextureIndex & packedVertexUvMask) / (f32)packedVertexUvMask;
+	vtx.uv.y = (f32)((packed.uvAndTextureIndex >> packedVertexUvBits) & packedVertexUvMask) / (f32)packedVertexUvMask;
+	vtx.textureIndex = packed.uvAndTextureIndex >> (packedVertexUvBits * 2);
+	vtx.color = packed.color;
+
+	return vtx;
+}
+
+static inline f32 edgeFunction(const Point& a, const Point& b, f32 x, f32 y)
+{
+	return (x - a.x) * (b.y - a.y) - (y - a.y) * (b.x - a.x);
+}
+
+// the top-left fill rule, so pixels on edges shared by two triangles are only blended once
+static inline bool isTopLeftEdge(const Point& a, const Point& b)
+{
+	return (a.y == b.y && b.x < a.x) || b.y > a.y;
+}
+
+/// \return the texture alpha at the given uv, filtered linearly like the OpenGL provider's texture sampling
+static f32 sampleTextureAlpha(const HeadlessTextureArray* textureArray, u32 textureIndex, f32 u, f32 v)
+{
+	f32 x = u * textureArray->width - 0.5f;
+	f32 y = v * textureArray->height - 0.5f;
+	i32 x0 = (i32)floorf(x);
+	i32 y0 = (i32)floorf(y);
+	f32 fx = x - x0;
+	f32 fy = y - y0;
+	f32 a00 = (f32)(textureArray->getTexel(textureIndex, x0, y0) >> 24);
+	f32 a10 = (f32)(textureArray->getTexel(textureIndex, x0 + 1, y0) >> 24);
+	f32 a01 = (f32)(textureArray->getTexel(textureIndex, x0, y0 + 1) >> 24);
+	f32 a11 = (f32)(textureArray->getTexel(textureIndex, x0 + 1, y0 + 1) >> 24);
+	f32 top = a00 + (a10 - a00) * fx;
+	f32 bottom = a01 + (a11 - a01) * fx;
+
+	return (top + (bottom - top) * fy) / 255.0f;
+}
+
+/// \return the signed distance from a shape's edge, negative inside, as the OpenGL provider's pixel shader computes it
+static f32 getShapeDistance(const ShapeParameters& shape, f32 x, f32 y)
+{
+	const f32 pi = 3.14159265f;
+
+	if (shape.type == (u32)ShapeType::RoundedRectangle || shape.type == (u32)ShapeType::Circle)
+	{
+		f32 qx = fabsf(x) - shape.halfSize.x + shape.cornerRadius;
+		f32 qy = fabsf(y) - shape.halfSize.y + shape.cornerRadius;
+		f32 outside = sqrtf(std::max(qx, 0.0f) * std::max(qx, 0.0f) + std::max(qy, 0.0f) * std::max(qy, 0.0f));
+
+		return outside + std::min(std::max(qx, qy), 0.0f) - shape.cornerRadius;
+	}
+
+	f32 halfThickness = shape.borderWidth / 2;
+	f32 radius = shape.cornerRadius - halfThickness;
+	f32 halfSpan = shape.type == (u32)ShapeType::Arc ? std::min((shape.endAngle - shape.startAngle) / 2, pi) : pi;
+	f32 middle = (shape.startAngle + shape.endAngle) / 2;
+	// rotated so the arc's middle points down, mirrored on the arc's axis
+	f32 rx = fabsf(sinf(middle) * x - cosf(middle) * y);
+	f32 ry = cosf(middle) * x + sinf(middle) * y;
+	f32 sx = sinf(halfSpan);
+	f32 sy = cosf(halfSpan);
+
+	if (sy * rx > sx * ry)
+	{
+		// past the arc's ends, the distance from the nearest end
+		return sqrtf((rx - sx * radius) * (rx - sx * radius) + (ry - sy * radius) * (ry - sy * radius)) - halfThickness;
+	}
+
+	return fabsf(sqrtf(rx * rx + ry * ry) - radius) - halfThickness;
+}
+
+void HeadlessGraphicsProvider::rasterizeTriangle(
+	const Vertex& v0, const Vertex& v1, const Vertex& v2,
+	const HeadlessTextureArray* textureArray)
+{
+	auto rt = currentRenderTarget;
+
+	if (rt->pixels.empty())
+		return;
+
+	// vertex positions are relative to the viewport
+	Point p[3] = {
+		{ v0.position.x + currentViewport.x, v0.position.y + currentViewport.y },
+		{ v1.position.x + currentViewport.x, v1.position.y + currentViewport.y },
+		{ v2.position.x + currentViewport.x, v2.position.y + currentViewport.y } };
+	const Vertex* v[3] = { &v0, &v1, &v2 };
+	f32 area = edgeFunction(p[0], p[1], p[2].x, p[2].y);
+
+	if (area == 0)
+		return;
+
+	if (area < 0)
+	{
+		std::swap(p[1], p[2]);
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	i32 clipMinX = std::max((i32)currentViewport.x, 0);
+	i32 clipMinY = std::max((i32)currentViewport.y, 0);
+	i32 clipMaxX = std::min((i32)(currentViewport.x + currentViewport.width), (i32)rt->width);
+	i32 clipMaxY = std::min((i32)(currentViewport.y + currentViewport.height), (i32)rt->height);
+
+	if (scissorEnabled)
+	{
+		clipMinX = std::max(clipMinX, (i32)scissorRect.x);
+		clipMinY = std::max(clipMinY, (i32)scissorRect.y);
+		clipMaxX = std::min(clipMaxX, (i32)(scissorRect.x + scissorRect.width));
+		clipMaxY = std::min(clipMaxY, (i32)(scissorRect.y + scissorRect.height));
+	}
+
+	// the shader clip rect, a pixel is inside when its center is inside the rect, like the OpenGL provider's pixel shader
+	if (v0.clipRectIndex && v0.clipRectIndex < clipRects.size())
+	{
+		const Rect& clip = clipRects[v0.clipRectIndex];
+
+		clipMinX = std::max(clipMinX, (i32)ceilf(clip.x + currentViewport.x - 0.5f));
+		clipMinY = std::max(clipMinY, (i32)ceilf(clip.y + currentViewport.y - 0.5f));
+		clipMaxX = std::min(clipMaxX, (i32)ceilf(clip.right() + currentViewport.x - 0.5f));
+		clipMaxY = std::min(clipMaxY, (i32)ceilf(clip.bottom() + currentViewport.y - 0.5f));
+	}
+
+	i32 minX = std::max((i32)floorf(std::min(p[0].x, std::min(p[1].x, p[2].x))), clipMinX);
+	i32 minY = std::max((i32)floorf(std::min(p[0].y, std::min(p[1].y, p[2].y))), clipMinY);
+	i32 maxX = std::min((i32)ceilf(std::max(p[0].x, std::max(p[1].x, p[2].x))), clipMaxX);
+	i32 maxY = std::min((i32)ceilf(std::max(p[0].y, std::max(p[1].y, p[2].y))), clipMaxY);
+
+	if (minX >= maxX || minY >= maxY)
+		return;
+
+	bool topLeft0 = isTopLeftEdge(p[1], p[2]);
+	bool topLeft1 = isTopLeftEdge(p[2], p[0]);
+	bool topLeft2 = isTopLeftEdge(p[0], p[1]);
+	f32 colors[3][4];
+
+	for (u32 i = 0; i < 3; i++)
+	{
+		for (u32 c = 0; c < 4; c++)
+		{
+			colors[i][c] = (f32)((v[i]->color >> (c * 8)) & 0xff) / 255.0f;
+		}
+	}
+
+	f32 invArea = 1.0f / area;
+	u32 textureIndex = v0.textureIndex;
+	const ShapeParameters* shape = nullptr;
+	f32 borderColor[4];
+
+	if ((textureIndex & shapeTextureIndexFlag) && (textureIndex & ~shapeTextureIndexFlag) < shapes.size())
+	{
+		shape = &shapes[textureIndex & ~shapeTextureIndexFlag];
+
+		for (u32 c = 0; c < 4; c++)
+		{
+			borderColor[c] = (f32)((shape->borderColor >> (c * 8)) & 0xff) / 255.0f;
+		}
+	}
+
+	i32 textureWidth = textureArray ? textureArray->width : 0;
+	i32 textureHeight = textureArray ? textureArray->height : 0;
+	bool distanceField = !shape && (textureIndex & distanceFieldTextureIndexFlag);
+	Point uvDx;
+	Point uvDy;
+
+	textureIndex &= ~distanceFieldTextureIndexFlag;
+
+	// the uv change for one pixel to the right and down, for the distance field glyphs' screen space derivatives
+	if (distanceField)
+	{
+		for (u32 i = 0; i < 3; i++)
+		{
+			const Point& a = p[(i + 1) % 3];
+			const Point& b = p[(i + 2) % 3];
+			f32 dx = (edgeFunction(a, b, 1, 0) - edgeFunction(a, b, 0, 0)) * invArea;
+			f32 dy = (edgeFunction(a, b, 0, 1) - edgeFunction(a, b, 0, 0)) * invArea;
+
+			uvDx.x += v[i]->uv.x * dx;
+			uvDx.y += v[i]->uv.y * dx;
+			uvDy.x += v[i]->uv.x * dy;
+			uvDy.y += v[i]->uv.y * dy;
+		}
+	}
+
+	for (i32 y = minY; y < maxY; y++)
+	{
+		f32 py = (f32)y + 0.5f;
+		Rgba32* row = rt->pixels.data() + (size_t)y * rt->width;
+
+		for (i32 x = minX; x < maxX; x++)
+		{
+			f32 px = (f32)x + 0.5f;
+			f32 w0 = edgeFunction(p[1], p[2], px, py);
+			f32 w1 = edgeFunction(p[2], p[0], px, py);
+			f32 w2 = edgeFunction(p[0], p[1], px, py);
+
+			if (w0 < 0 || w1 < 0 || w2 < 0)
+				continue;
+
+			if ((w0 == 0 && !topLeft0) || (w1 == 0 && !topLeft1) || (w2 == 0 && !topLeft2))
+				continue;
+
+			w0 *= invArea;
+			w1 *= invArea;
+			w2 *= invArea;
+
+			Rgba32 texel = ~0;
+			f32 src[4];
+
+			if (shape)
+			{
+				// the uvs are the offsets from the shape's center
+				f32 u = v[0]->uv.x * w0 + v[1]->uv.x * w1 + v[2]->uv.x * w2;
+				f32 vv = v[0]->uv.y * w0 + v[1]->uv.y * w1 + v[2]->uv.y * w2;
+				f32 distance = getShapeDistance(*shape, u, vv);
+				f32 fillAmount = 1;
+
+				if (shape->type <= (u32)ShapeType::Circle && shape->borderWidth > 0)
+					fillAmount = std::min(std::max(0.5f - distance - shape->borderWidth, 0.0f), 1.0f);
+
+				for (u32 c = 0; c < 4; c++)
+				{
+					f32 vertexColor = colors[0][c] * w0 + colors[1][c] * w1 + colors[2][c] * w2;
+
+					src[c] = borderColor[c] + (vertexColor - borderColor[c]) * fillAmount;
+				}
+
+				src[3] *= std::min(std::max(0.5f - distance, 0.0f), 1.0f);
+			}
+			else if (textureArray)
+			{
+				f32 u = v[0]->uv.x * w0 + v[1]->uv.x * w1 + v[2]->uv.x * w2;
+				f32 vv = v[0]->uv.y * w0 + v[1]->uv.y * w1 + v[2]->uv.y * w2;
+
+				if (distanceField)
+				{
+					f32 alpha = sampleTextureAlpha(textureArray, textureIndex, u, vv);
+					f32 alphaDx = sampleTextureAlpha(textureArray, textureIndex, u + uvDx.x, vv + uvDx.y) - alpha;
+					f32 alphaDy = sampleTextureAlpha(textureArray, textureIndex, u + uvDy.x, vv + uvDy.y) - alpha;
+					f32 width = std::max(sqrtf(alphaDx * alphaDx + alphaDy * alphaDy), 0.0001f);
+					f32 coverage = std::min(std::max((alpha - 0.5f) / width + 0.5f, 0.0f), 1.0f);
+
+					texel = 0x00FFFFFF | ((u32)(coverage * 255.0f + 0.5f) << 24);
+				}
+				else
+				{
+					texel = textureArray->getTexel(
+						textureIndex,
+						(i32)floorf(u * textureWidth),
+						(i32)floorf(vv * textureHeight));
+				}
+			}
+
+			if (!shape)
+			{
+				for (u32 c = 0; c < 4; c++)
+				{
+					f32 vertexColor = colors[0][c] * w0 + colors[1][c] * w1 + colors[2][c] * w2;
+
+					src[c] = (f32)((texel >> (c * 8)) & 0xff) / 255.0f * vertexColor;
+				}
+			}
+
+			Rgba32& dst = row[x];
+			Rgba32 result = 0;
+			f32 alpha = src[3];
+
+			for (u32 c = 0; c < 3; c++)
+			{
+				f32 dstChannel = (f32)((dst >> (c * 8)) & 0xff) / 255.0f;
+				f32 value = src[c] * alpha + dstChannel * (1.0f - alpha);
+
+				result |= (u32)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f) << (c * 8);
+			}
+
+			// the render targets keep the coverage, to be blended when they are drawn
+			if (rt != &framebuffer)
+				alpha += (f32)(dst >> 24) / 255.0f * (1.0f - alpha);
+
+			result |= (u32)(std::min(std::max(alpha, 0.0f), 1.0f) * 255.0f + 0.5f) << 24;
+			dst = result;
+		}
+	}
+}
+
+bool HeadlessGraphicsProvider::saveFramebuffer(const char* filename) const
+{
+	if (framebuffer.pixels.empty())
+		return false;
+
+	FILE* file = fopen(filename, "wb");
+
+	if (!file)
+		return false;
+
+	fprintf(file, "P6\n%u %u\n255\n", framebuffer.width, framebuffer.height);
+
+	std::vector<u8> rgb(framebuffer.pixels.size() * 3);
+
+	for (size_t i = 0; i < framebuffer.pixels.size(); i++)
+	{
+		Rgba32 pixel = framebuffer.pixels[i];
+
+		rgb[i * 3] = pixel & 0xff;
+		rgb[i * 3 + 1] = (pixel >> 8) & 0xff;
+		rgb[i * 3 + 2] = (pixel >> 16) & 0xff;
+	}
+
+	bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+
+	fclose(file);
+
+	return ok;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+#include "horus.h"
+#include "horus_interfaces.h"
+#include <vector>
+
+namespace hui
+{
+/// What the headless graphics provider does with the rendered batches
+enum class HeadlessRenderMode
+{
+	Null, /// discard the texture, vertex data and draws, used to measure only the library's CPU cost
+	Software /// rasterize the batches into an in-memory RGBA framebuffer, used for golden image tests
+};
+
+struct HeadlessTextureArray : TextureArray
+{
+	HeadlessTextureArray(bool keepPixels) : keepPixels(keepPixels) {}
+
+	void resize(u32 count, u32 newWidth, u32 newHeight) override;
+	void updateData(Rgba32* pixels) override;
+	void updateLayerData(u32 textureIndex, Rgba32* pixels) override;
+	void updateRectData(u32 textureIndex, const Rect& rect, Rgba32* pixels) override;
+	GraphicsApiTexture getHandle() const override { return (GraphicsApiTexture)this; }
+	u32 getWidth() const override { return width; }
+	u32 getHeight() const override { return height; }
+	u32 getCount() const override { return textureCount; }
+
+	/// \return the texel at the given coordinates, clamped to the texture edges
+	Rgba32 getTexel(u32 textureIndex, i32 x, i32 y) const;
+
+	bool keepPixels = false; /// if false, the texture data is not stored, only the size
+	u32 width = 0;
+	u32 height = 0;
+	u32 textureCount = 0;
+	std::vector<Rgba32> pixels; /// all the layers, one after another
+};
+
+struct HeadlessVertexBuffer : VertexBuffer
+{
+	HeadlessVertexBuffer(bool keepVertices) : keepVertices(keepVertices) {}
+
+	void resize(u32 count) override;
+	void setStreamingMode(VertexStreamingMode mode, u32 ringSize) override {}
+	void beginFrameUpload() override {}
+	void updateData(Vertex* vertices, u32 startVertexIndex, u32 count) override;
+	bool updateDataRange(Vertex* vertices, u32 startVertexIndex, u32 count) override;
+	void updatePackedData(PackedVertex* vertices, u32 startVertexIndex, u32 count) override;
+	GraphicsApiVertexBuffer getHandle() const override { return (GraphicsApiVertexBuffer)this; }
+
+	bool keepVertices = false; /// if false, the uploads are discarded
+	u32 vertexCount = 0;
+	std::vector<Vertex> vertices;
+	std::vector<PackedVertex> packedVertices;
+};
+
+struct HeadlessIndexBuffer : IndexBuffer
+{
+	HeadlessIndexBuffer(bool keepIndices) : keepIndices(keepIndices) {}
+
+	void resize(u32 count) override;
+	void updateData(u32* indices, u32 startIndex, u32 count) override;
+	GraphicsApiIndexBuffer getHandle() const override { return (GraphicsApiIndexBuffer)this; }
+
+	bool keepIndices = false; /// if false, the uploads are discarded
+	std::vector<u32> indices;
+};
+
+struct HeadlessRenderTarget
+{
+	u32 width = 0;
+	u32 height = 0;
+	std::vector<Rgba32> pixels;
+	HeadlessTextureArray* textureArray = nullptr; /// the pixels as a texture, updated when another render target is set, null for the framebuffer
+};
+
+/// A graphics provider which doesn't need a GPU or a window, used for benchmarking and for rendering golden images in tests.
+/// In software mode the triangles are rasterized with nearest texel sampling and source alpha blending, like the OpenGL provider's shader and blend state
+struct HeadlessGraphicsProvider : GraphicsProvider
+{
+	/// \param mode what to do with the rendered batches
+	/// \param format the vertex format the library will upload
+	HeadlessGraphicsProvider(HeadlessRenderMode mode = HeadlessRenderMode::Null, VertexFormat format = VertexFormat::Full);
+	~HeadlessGraphicsProvider();
+	bool initialize() override { return true; }
+	void shutdown() override {}
+	ApiType getApiType() const override { return GraphicsProvider::ApiType::Custom; }
+	VertexFormat getVertexFormat() const override { return vertexFormat; }
+	TextureArray* createTextureArray() override;
+	VertexBuffer* createVertexBuffer() override;
+	IndexBuffer* createIndexBuffer() override;
+	GraphicsApiRenderTarget createRenderTarget(u32 width, u32 height) override;
+	void destroyRenderTarget(GraphicsApiRenderTarget rt) override;
+	void setRenderTarget(GraphicsApiRenderTarget rt) override;
+	TextureArray* getRenderTargetTextureArray(GraphicsApiRenderTarget rt) override { return ((HeadlessRenderTarget*)rt)->textureArray; }
+	void setViewport(const Point& windowSize, const Rect& viewport) override;
+	void clear(const Color& color) override;
+	bool isBackBufferPreserved() const override { return true; }
+	void setScissor(const Rect& rect) override { scissorRect = rect; scissorEnabled = true; }
+	void disableScissor() override { scissorEnabled = false; }
+	bool supportsShaderClipping() const override { return vertexFormat == VertexFormat::Full; }
+	void setClipRects(const Rect* rects, u32 count) override { clipRects.assign(rects, rects + count); }
+	bool supportsShaderShapes() const override { return vertexFormat == VertexFormat::Full; }
+	bool supportsDistanceFieldGlyphs() const override { return vertexFormat == VertexFormat::Full; }
+	void setShapes(const ShapeParameters* shapes, u32 count) override { this->shapes.assign(shapes, shapes + count); }
+	void draw(struct RenderBatch* batches, u32 count) override;
+
+	/// \return the framebuffer the main render target draws are rasterized into, it has the size of the last window passed to setViewport
+	const HeadlessRenderTarget& getFramebuffer() const { return framebuffer; }
+
+	/// Save the framebuffer as a binary PPM image, the alpha channel is dropped
+	/// \param filename the image filename
+	/// \return true if the file was written
+	bool saveFramebuffer(const char* filename) const;
+
+	void rasterizeTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const HeadlessTextureArray* textureArray);
+	Vertex getBatchVertex(const HeadlessVertexBuffer* vertexBuffer, u32 index) const;
+
+	HeadlessRenderMode mode = HeadlessRenderMode::Null;
+	VertexFormat vertexFormat = VertexFormat::Full;
+	HeadlessRenderTarget framebuffer;
+	HeadlessRenderTarget* currentRenderTarget = &framebuffer;
+	Rect currentViewport;
+	Rect scissorRect;
+	bool scissorEnabled = false;
+	std::vector<Rect> clipRects; /// the clip rect table set by the renderer, indexed by the vertex clip rect index
+	std::vector<ShapeParameters> shapes; /// the shape table set by the renderer, the shape vertices are rasterized with their shape's coverage
+	u32 drawnBatchCount = 0; /// how many batches were passed to draw, since creation
+	u64 drawnTriangleCount = 0; /// how many triangles were passed to draw, since creation
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "null_input_provider.h"
+#include <algorithm>
+#include <string.h>
+
+namespace hui
+{
+NullInputProvider::NullInputProvider()
+{}
+
+NullInputProvider::~NullInputProvider()
+{
+	shutdown();
+}
+
+bool NullInputProvider::copyToClipboard(const char* text)
+{
+	clipboardText = text;
+
+	return true;
+}
+
+bool NullInputProvider::pasteFromClipboard(char* outText, u32 maxTextSize)
+{
+	if (!maxTextSize)
+		return false;
+
+	u32 size = std::min((u32)clipboardText.size(), maxTextSize - 1);
+
+	memcpy(outText, clipboardText.c_str(), size);
+	outText[size] = 0;
+
+	return true;
+}
+
+void NullInputProvider::processEvents()
+{
+	setFrameDeltaTime(deltaTime);
+}
+
+Window NullInputProvider::createWindow(
+	const char* title, i32 width, i32 height,
+	WindowFlags flags, Point customPosition)
+{
+	NullWindow* wnd = new NullWindow();
+
+	wnd->title = title ? title : "";
+	wnd->rect.set(customPosition.x, customPosition.y, width, height);
+
+	if (!mainWindow)
+	{
+		mainWindow = wnd;
+		focusedWindow = wnd;
+		hoveredWindow = wnd;
+		currentWindow = wnd;
+	}
+
+	windows.push_back(wnd);
+
+	return wnd;
+}
+
+void NullInputProvider::setWindowTitle(Window window, const char* title)
+{
+	((NullWindow*)window)->title = title ? title : "";
+}
+
+void NullInputProvider::setWindowRect(Window window, const Rect& rect)
+{
+	((NullWindow*)window)->rect = rect;
+}
+
+Rect NullInputProvider::getWindowRect(Window window)
+{
+	return ((NullWindow*)window)->rect;
+}
+
+void NullInputProvider::destroyWindow(Window window)
+{
+	NullWindow* wnd = (NullWindow*)window;
+	auto iter = std::find(windows.begin(), windows.end(), wnd);
+
+	if (iter == windows.end())
+		return;
+
+	windows.erase(iter);
+
+	if (focusedWindow == wnd) focusedWindow = mainWindow == wnd ? nullptr : mainWindow;
+	if (hoveredWindow == wnd) hoveredWindow = mainWindow == wnd ? nullptr : mainWindow;
+	if (currentWindow == wnd) currentWindow = mainWindow == wnd ? nullptr : mainWindow;
+
+	if (mainWindow == wnd)
+	{
+		mainWindow = nullptr;
+		quitApp = true;
+	}
+
+	delete wnd;
+}
+
+void NullInputProvider::showWindow(Window window)
+{
+	((NullWindow*)window)->state = WindowState::Normal;
+}
+
+void NullInputProvider::hideWindow(Window window)
+{
+	((NullWindow*)window)->state = WindowState::Hidden;
+}
+
+void NullInputProvider::maximizeWindow(Window window)
+{
+	((NullWindow*)window)->state = WindowState::Maximized;
+}
+
+void NullInputProvider::minimizeWindow(Window window)
+{
+	((NullWindow*)window)->state = WindowState::Minimized;
+}
+
+WindowState NullInputProvider::getWindowState(Window window)
+{
+	return ((NullWindow*)window)->state;
+}
+
+void NullInputProvider::shutdown()
+{
+	for (auto wnd : windows)
+	{
+		delete wnd;
+	}
+
+	windows.clear();
+	mainWindow = focusedWindow = hoveredWindow = currentWindow = nullptr;
+}
+
+MouseCursor NullInputProvider::createCustomCursor(Rgba32* pixels, u32 width, u32 height, u32 hotX, u32 hotY)
+{
+	// only a unique non-null handle is needed
+	return (MouseCursor)++customCursorCount;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+#include "horus.h"
+#include "horus_interfaces.h"
+#include <string>
+#include <vector>
+
+namespace hui
+{
+struct NullWindow
+{
+	std::string title;
+	Rect rect;
+	WindowState state = WindowState::Normal;
+};
+
+/// An input provider without an OS window or event queue, used with the headless graphics provider for benchmarking and tests.
+/// The windows are only kept in memory and the input events must be added by the caller with hui::addInputEvent
+struct NullInputProvider : InputProvider
+{
+	NullInputProvider();
+	~NullInputProvider();
+	void startTextInput(Window window, const Rect& imeRect) override {}
+	void stopTextInput() override {}
+	bool copyToClipboard(const char* text) override;
+	bool pasteFromClipboard(char* outText, u32 maxTextSize) override;
+	void processEvents() override;
+	void setCurrentWindow(Window window) override { currentWindow = (NullWindow*)window; }
+	Window getCurrentWindow() override { return currentWindow; }
+	Window getFocusedWindow() override { return focusedWindow; }
+	Window getHoveredWindow() override { return hoveredWindow; }
+	Window getMainWindow() override { return mainWindow; }
+	Window createWindow(
+		const char* title, i32 width, i32 height,
+		WindowFlags flags = WindowFlags::Resizable | WindowFlags::Centered,
+		Point customPosition = { 0, 0 }) override;
+	void setWindowTitle(Window window, const char* title) override;
+	void setWindowRect(Window window, const Rect& rect) override;
+	Rect getWindowRect(Window window) override;
+	void presentWindow(Window window) override {}
+	void destroyWindow(Window window) override;
+	void showWindow(Window window) override;
+	void hideWindow(Window window) override;
+	void raiseWindow(Window window) override { focusedWindow = (NullWindow*)window; }
+	void maximizeWindow(Window window) override;
+	void minimizeWindow(Window window) override;
+	WindowState getWindowState(Window window) override;
+	void setCapture(Window window) override {}
+	void releaseCapture() override {}
+	Point getMousePosition() override { return mousePosition; }
+	bool mustQuit() override { return quitApp; }
+	bool wantsToQuit() override { return wantsToQuitApp; }
+	void cancelQuitApplication() override { wantsToQuitApp = false; }
+	void quitApplication() override { quitApp = true; }
+	void shutdown() override;
+	void setCursor(MouseCursorType type) override {}
+	MouseCursor createCustomCursor(Rgba32* pixels, u32 width, u32 height, u32 hotX, u32 hotY) override;
+	void deleteCustomCursor(MouseCursor cursor) override {}
+	void setCustomCursor(MouseCursor cursor) override {}
+
+	bool quitApp = false; /// if true, it will end the main app loop
+	bool wantsToQuitApp = false; /// true when the user wants to quit the app
+	f32 deltaTime = 1.0f / 60.0f; /// the fixed frame delta time set on each processEvents, so the runs are deterministic
+	Point mousePosition; /// the mouse position returned by getMousePosition, set it together with the mouse events
+	std::string clipboardText;
+	std::vector<NullWindow*> windows;
+	NullWindow* mainWindow = nullptr;
+	NullWindow* focusedWindow = nullptr;
+	NullWindow* hoveredWindow = nullptr;
+	NullWindow* currentWindow = nullptr;
+	uintptr_t customCursorCount = 0;
+};
+
+}
\ No newline at end of file
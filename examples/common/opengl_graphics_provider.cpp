@@ -2,6 +2,7 @@
 #include "horus.h"
 #include "opengl_texture_array.h"
 #include "opengl_vertex_buffer.h"
+#include "opengl_index_buffer.h"
 #include <string.h>
 
 namespace hui
@@ -81,6 +82,8 @@ static void setIntValueInGpuProgram(
 	OGL_CHECK_ERROR;
 }
 
+// the clip rect index is in the top 16 bits of the texture index, its rect is fetched from the clip rect texture, as left, top, right, bottom.
+// the shape vertices have the shape flag set in the texture index, their shape is fetched from the shape texture, in three texels
 static const char* uiVertexShaderSource =
 "\
 #version 130\r\n\
@@ -91,9 +94,16 @@ in uint inCOLOR;\
 in uint inTEXINDEX;\
 \
 uniform mat4 mvp;\
+uniform sampler2D clipRectSampler;\
+uniform sampler2D shapeSampler;\
 out vec2 outTEXCOORD;\
 out vec4 outCOLOR;\
+out vec2 outPOSITION;\
 flat out uint outTEXINDEX;\
+flat out vec4 outCLIPRECT;\
+flat out vec4 outSHAPESIZE;\
+flat out vec4 outSHAPEARC;\
+flat out vec4 outSHAPEBORDERCOLOR;\
 \
 void main()\
 {\
@@ -102,11 +112,61 @@ void main()\
 	outTEXCOORD = inTEXCOORD0;\
 	vec4 color = vec4(float(inCOLOR & uint(0x000000FF))/255.0, float((inCOLOR & uint(0x0000FF00)) >> uint(8))/255.0, float((inCOLOR & uint(0x00FF0000)) >> uint(16))/255.0, float((inCOLOR & uint(0xFF000000))>> uint(24))/255.0);\
 	outCOLOR = color;\
-	outTEXINDEX = inTEXINDEX;\
+	outPOSITION = inPOSITION;\
+	outTEXINDEX = inTEXINDEX & uint(0xFFFF);\
+	uint clipIndex = inTEXINDEX >> uint(16);\
+	outCLIPRECT = clipIndex == uint(0) ? vec4(-1e30, -1e30, 1e30, 1e30) : texelFetch(clipRectSampler, ivec2(int(clipIndex % uint(1024)), int(clipIndex / uint(1024))), 0);\
+	outSHAPESIZE = vec4(0.0);\
+	outSHAPEARC = vec4(-1.0, 0.0, 0.0, 0.0);\
+	outSHAPEBORDERCOLOR = vec4(0.0);\
+	if ((outTEXINDEX & uint(0x8000)) != uint(0))\
+	{\
+		int texel = int(outTEXINDEX & uint(0x7FFF)) * 3;\
+		outSHAPESIZE = texelFetch(shapeSampler, ivec2(texel % 1024, texel / 1024), 0);\
+		outSHAPEARC = texelFetch(shapeSampler, ivec2((texel + 1) % 1024, (texel + 1) / 1024), 0);\
+		outSHAPEBORDERCOLOR = texelFetch(shapeSampler, ivec2((texel + 2) % 1024, (texel + 2) / 1024), 0);\
+	}\
 	return;\
 }\
 ";
 
+// decodes the PackedVertex: 14 bit unorm UVs and the texture index in the top 4 bits
+static const char* uiPackedVertexShaderSource =
+"\
+#version 130\r\n\
+\
+in vec2 inPOSITION;\
+in uint inUVTEXINDEX;\
+in uint inCOLOR;\
+\
+uniform mat4 mvp;\
+out vec2 outTEXCOORD;\
+out vec4 outCOLOR;\
+out vec2 outPOSITION;\
+flat out uint outTEXINDEX;\
+flat out vec4 outCLIPRECT;\
+flat out vec4 outSHAPESIZE;\
+flat out vec4 outSHAPEARC;\
+flat out vec4 outSHAPEBORDERCOLOR;\
+\
+void main()\
+{\
+	vec4 v = mvp * vec4(inPOSITION.x, inPOSITION.y, 0, 1);\
+	gl_Position = v;\
+	outPOSITION = inPOSITION;\
+	outCLIPRECT = vec4(-1e30, -1e30, 1e30, 1e30);\
+	outSHAPESIZE = vec4(0.0);\
+	outSHAPEARC = vec4(-1.0, 0.0, 0.0, 0.0);\
+	outSHAPEBORDERCOLOR = vec4(0.0);\
+	outTEXCOORD = vec2(float(inUVTEXINDEX & uint(0x3FFF)), float((inUVTEXINDEX >> uint(14)) & uint(0x3FFF))) / 16383.0;\
+	vec4 color = vec4(float(inCOLOR & uint(0x000000FF))/255.0, float((inCOLOR & uint(0x0000FF00)) >> uint(8))/255.0, float((inCOLOR & uint(0x00FF0000)) >> uint(16))/255.0, float((inCOLOR & uint(0xFF000000))>> uint(24))/255.0);\
+	outCOLOR = color;\
+	outTEXINDEX = inUVTEXINDEX >> uint(28);\
+	return;\
+}\
+";
+
+// the distance field glyphs have the distance field flag in the texture index, their coverage is the texel alpha's distance to 0.5, in screen pixels
 static const char* uiPixelShaderSource =
 "\
 #version 130\r\n\
@@ -115,16 +175,57 @@ uniform sampler2DArray diffuseSampler;\
 \
 in vec2 outTEXCOORD;\
 in vec4 outCOLOR;\
+in vec2 outPOSITION;\
 flat in uint outTEXINDEX;\
+flat in vec4 outCLIPRECT;\
+flat in vec4 outSHAPESIZE;\
+flat in vec4 outSHAPEARC;\
+flat in vec4 outSHAPEBORDERCOLOR;\
 out vec4 finalCOLOR;\
 \
+float shapeDistance(vec2 p)\
+{\
+	if (outSHAPEARC.x < 1.5)\
+	{\
+		vec2 q = abs(p) - outSHAPESIZE.xy + outSHAPESIZE.z;\
+		return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - outSHAPESIZE.z;\
+	}\
+	float halfThickness = outSHAPESIZE.w * 0.5;\
+	float radius = outSHAPESIZE.z - halfThickness;\
+	float halfSpan = outSHAPEARC.x > 2.5 ? min((outSHAPEARC.z - outSHAPEARC.y) * 0.5, 3.14159265) : 3.14159265;\
+	float middle = (outSHAPEARC.y + outSHAPEARC.z) * 0.5;\
+	vec2 r = vec2(sin(middle) * p.x - cos(middle) * p.y, cos(middle) * p.x + sin(middle) * p.y);\
+	vec2 sc = vec2(sin(halfSpan), cos(halfSpan));\
+	r.x = abs(r.x);\
+	return (sc.y * r.x > sc.x * r.y ? length(r - sc * radius) : abs(length(r) - radius)) - halfThickness;\
+}\
+\
 void main()\
 {\
-	finalCOLOR = outCOLOR * texture2DArray(diffuseSampler, vec3(outTEXCOORD, float(outTEXINDEX)));\
+	if (outPOSITION.x < outCLIPRECT.x || outPOSITION.y < outCLIPRECT.y || outPOSITION.x >= outCLIPRECT.z || outPOSITION.y >= outCLIPRECT.w)\
+		discard;\
+	if (outSHAPEARC.x < 0.0)\
+	{\
+		vec4 texel = texture2DArray(diffuseSampler, vec3(outTEXCOORD, float(outTEXINDEX & uint(0x3FFF))));\
+		if ((outTEXINDEX & uint(0x4000)) != uint(0))\
+		{\
+			float width = max(length(vec2(dFdx(texel.a), dFdy(texel.a))), 0.0001);\
+			texel = vec4(1.0, 1.0, 1.0, clamp((texel.a - 0.5) / width + 0.5, 0.0, 1.0));\
+		}\
+		finalCOLOR = outCOLOR * texel;\
+		return;\
+	}\
+	float d = shapeDistance(outTEXCOORD);\
+	vec4 color = outCOLOR;\
+	if (outSHAPEARC.x < 1.5 && outSHAPESIZE.w > 0.0)\
+		color = mix(outSHAPEBORDERCOLOR, outCOLOR, clamp(0.5 - d - outSHAPESIZE.w, 0.0, 1.0));\
+	color.a *= clamp(0.5 - d, 0.0, 1.0);\
+	finalCOLOR = color;\
 }\
 ";
 
-OpenGLGraphicsProvider::OpenGLGraphicsProvider()
+OpenGLGraphicsProvider::OpenGLGraphicsProvider(VertexFormat format)
+	: vertexFormat(format)
 {}
 
 OpenGLGraphicsProvider::~OpenGLGraphicsProvider()
@@ -155,7 +256,10 @@ bool OpenGLGraphicsProvider::initialize()
 	OGL_CHECK_ERROR;
 
 	vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &uiVertexShaderSource, nullptr);
+	glShaderSource(
+		vertexShader, 1,
+		vertexFormat == VertexFormat::Packed ? &uiPackedVertexShaderSource : &uiVertexShaderSource,
+		nullptr);
 	OGL_CHECK_ERROR;
 	glCompileShader(vertexShader);
 	OGL_CHECK_ERROR;
@@ -245,6 +349,12 @@ void OpenGLGraphicsProvider::shutdown()
 	glDeleteShader(vertexShader);
 	glDeleteShader(pixelShader);
 	glDeleteProgram(program);
+
+	if (clipRectTexture)
+		glDeleteTextures(1, &clipRectTexture);
+
+	if (shapeTexture)
+		glDeleteTextures(1, &shapeTexture);
 }
 
 TextureArray* OpenGLGraphicsProvider::createTextureArray()
@@ -254,29 +364,31 @@ TextureArray* OpenGLGraphicsProvider::createTextureArray()
 
 VertexBuffer* OpenGLGraphicsProvider::createVertexBuffer()
 {
-	return (VertexBuffer*)new OpenGLVertexBuffer();
+	return (VertexBuffer*)new OpenGLVertexBuffer(vertexFormat);
+}
+
+IndexBuffer* OpenGLGraphicsProvider::createIndexBuffer()
+{
+	return (IndexBuffer*)new OpenGLIndexBuffer();
 }
 
 GraphicsApiRenderTarget OpenGLGraphicsProvider::createRenderTarget(u32 width, u32 height)
 {
 	OpenGLRenderTarget* rt = new OpenGLRenderTarget();
 	GLuint fb;
-	GLuint tex;
 
 	rt->width = width;
 	rt->height = height;
+	rt->textureArray = new OpenGLTextureArray(1, width, height);
 	glGenFramebuffers(1, &fb);
 	OGL_CHECK_ERROR;
-	glGenTextures(1, &tex);
-	OGL_CHECK_ERROR;
-	glBindTexture(GL_TEXTURE_2D, tex);
+	glBindFramebuffer(GL_FRAMEBUFFER, fb);
 	OGL_CHECK_ERROR;
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, rt->textureArray->handle, 0, 0);
 	OGL_CHECK_ERROR;
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, currentRenderTarget ? currentRenderTarget->frameBuffer : 0);
 	OGL_CHECK_ERROR;
 	rt->frameBuffer = fb;
-	rt->texture = tex;
 
 	return rt;
 }
@@ -290,29 +402,42 @@ void OpenGLGraphicsProvider::destroyRenderTarget(GraphicsApiRenderTarget rt)
 
 	OpenGLRenderTarget* oglRt = (OpenGLRenderTarget*)rt;
 
-	GLuint tex = (GLuint)oglRt->texture;
 	GLuint fb = (GLuint)oglRt->frameBuffer;
 
+	if (currentRenderTarget == oglRt)
+	{
+		setRenderTarget(nullptr);
+	}
+
 	glDeleteFramebuffers(1, &fb);
 	OGL_CHECK_ERROR;
-	glDeleteTextures(1, &tex);
-	OGL_CHECK_ERROR;
-
-	delete rt;
+	delete oglRt->textureArray;
+	delete oglRt;
 }
 
 void OpenGLGraphicsProvider::setRenderTarget(GraphicsApiRenderTarget rt)
 {
 	OpenGLRenderTarget* oglRt = (OpenGLRenderTarget*)rt;
-	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)oglRt->frameBuffer);
+	currentRenderTarget = oglRt;
+	glBindFramebuffer(GL_FRAMEBUFFER, oglRt ? (GLuint)oglRt->frameBuffer : 0);
 	OGL_CHECK_ERROR;
 }
 
+TextureArray* OpenGLGraphicsProvider::getRenderTargetTextureArray(GraphicsApiRenderTarget rt)
+{
+	return ((OpenGLRenderTarget*)rt)->textureArray;
+}
+
 void OpenGLGraphicsProvider::commitRenderState()
 {
 	glEnable(GL_BLEND);
 	glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
-	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
+
+	// the render targets keep the coverage of what's drawn into them, to be blended when they are drawn
+	if (currentRenderTarget)
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	else
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
 	glDisable(GL_CULL_FACE);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	glDisable(GL_DEPTH_TEST);
@@ -322,6 +447,7 @@ void OpenGLGraphicsProvider::setViewport(const Point& windowSize, const Rect& vi
 {
 	Rect glRc = { viewport.x, windowSize.y - viewport.y - viewport.height, viewport.width, viewport.height };
 	currentViewport = glRc;
+	currentWindowSize = windowSize;
 	glViewport(glRc.x, glRc.y, glRc.width, glRc.height);
 	OGL_CHECK_ERROR;
 }
@@ -334,10 +460,121 @@ void OpenGLGraphicsProvider::clear(const Color& color)
 	OGL_CHECK_ERROR;
 }
 
+void OpenGLGraphicsProvider::setScissor(const Rect& rect)
+{
+	glEnable(GL_SCISSOR_TEST);
+	OGL_CHECK_ERROR;
+	glScissor(rect.x, currentWindowSize.y - rect.y - rect.height, rect.width, rect.height);
+	OGL_CHECK_ERROR;
+}
+
+void OpenGLGraphicsProvider::disableScissor()
+{
+	glDisable(GL_SCISSOR_TEST);
+	OGL_CHECK_ERROR;
+}
+
+/// Upload the texels of a float data texture, fetched by the vertex shader, creating the texture if needed
+static void updateDataTexture(GLuint& texture, const std::vector<f32>& texels, u32 width)
+{
+	u32 height = texels.size() / 4 / width;
+
+	if (!texture)
+	{
+		glGenTextures(1, &texture);
+		OGL_CHECK_ERROR;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	OGL_CHECK_ERROR;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	OGL_CHECK_ERROR;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	OGL_CHECK_ERROR;
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, texels.data());
+	OGL_CHECK_ERROR;
+	glBindTexture(GL_TEXTURE_2D, 0);
+	OGL_CHECK_ERROR;
+}
+
+static void bindDataTexture(GLuint program, GLuint texture, const char* samplerName, u32 stage)
+{
+	GLint loc = glGetUniformLocation(program, samplerName);
+	OGL_CHECK_ERROR;
+
+	if (!texture || loc == -1)
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + stage);
+	OGL_CHECK_ERROR;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	OGL_CHECK_ERROR;
+	glUniform1i(loc, stage);
+	OGL_CHECK_ERROR;
+	glActiveTexture(GL_TEXTURE0);
+	OGL_CHECK_ERROR;
+}
+
+void OpenGLGraphicsProvider::setClipRects(const Rect* rects, u32 count)
+{
+	const u32 width = dataTextureWidth;
+	u32 height = (count + width - 1) / width;
+
+	// one texel per rect, as left, top, right, bottom
+	clipRectTexels.resize(width * height * 4);
+
+	for (u32 i = 0; i < count; i++)
+	{
+		f32* texel = &clipRectTexels[i * 4];
+
+		texel[0] = rects[i].x;
+		texel[1] = rects[i].y;
+		texel[2] = rects[i].right();
+		texel[3] = rects[i].bottom();
+	}
+
+	updateDataTexture(clipRectTexture, clipRectTexels, width);
+}
+
+void OpenGLGraphicsProvider::setShapes(const ShapeParameters* shapes, u32 count)
+{
+	const u32 width = dataTextureWidth;
+	u32 height = (count * 3 + width - 1) / width;
+
+	// three texels per shape: the sizes, the type and arc angles, the border color
+	shapeTexels.resize(width * height * 4);
+
+	for (u32 i = 0; i < count; i++)
+	{
+		auto& shape = shapes[i];
+		f32* texel = &shapeTexels[i * 12];
+
+		texel[0] = shape.halfSize.x;
+		texel[1] = shape.halfSize.y;
+		texel[2] = shape.cornerRadius;
+		texel[3] = shape.borderWidth;
+		texel[4] = shape.type;
+		texel[5] = shape.startAngle;
+		texel[6] = shape.endAngle;
+		texel[7] = 0;
+
+		for (u32 c = 0; c < 4; c++)
+		{
+			texel[8 + c] = (f32)((shape.borderColor >> (c * 8)) & 0xFF) / 255.0f;
+		}
+	}
+
+	updateDataTexture(shapeTexture, shapeTexels, width);
+}
+
 void OpenGLGraphicsProvider::draw(RenderBatch* batches, u32 count)
 {
 	glUseProgram(program);
 	OGL_CHECK_ERROR;
+	bindDataTexture(program, clipRectTexture, "clipRectSampler", 1);
+	bindDataTexture(program, shapeTexture, "shapeSampler", 2);
 
 	// render the batches
 #define OGL_VBUFFER_OFFSET(i) ((void*)(i))
@@ -383,7 +620,8 @@ void OpenGLGraphicsProvider::draw(RenderBatch* batches, u32 count)
 			m[0][3] = 0.0f;
 
 			m[1][0] = 0.0f;
-			m[1][1] = 2.0f / -currentViewport.height;
+			// the render targets are drawn upside down, so their first texel row is the top one, as the UI textures
+			m[1][1] = currentRenderTarget ? 2.0f / currentViewport.height : 2.0f / -currentViewport.height;
 			m[1][2] = 0.0f;
 			m[1][3] = 0.0f;
 
@@ -393,7 +631,7 @@ void OpenGLGraphicsProvider::draw(RenderBatch* batches, u32 count)
 			m[2][3] = 0.0f;
 
 			m[3][0] = -1;
-			m[3][1] = 1;
+			m[3][1] = currentRenderTarget ? -1 : 1;
 			m[3][2] = 0.0f;
 			m[3][3] = 1.0f;
 
@@ -410,7 +648,7 @@ void OpenGLGraphicsProvider::draw(RenderBatch* batches, u32 count)
 		glBindBuffer(GL_ARRAY_BUFFER, (uintptr_t)batch.vertexBuffer->getHandle());
 		OGL_CHECK_ERROR;
 
-		u32 stride = sizeof(Vertex);
+		u32 stride = vertexFormat == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
 		u32 attrLoc = 0;
 		u32 offsetSum = 0;
 
@@ -431,38 +669,65 @@ void OpenGLGraphicsProvider::draw(RenderBatch* batches, u32 count)
 		OGL_CHECK_ERROR;
 		offsetSum += sizeof(f32) * 2;
 
-		attrLoc = glGetAttribLocation(program, "inTEXCOORD0");
-		OGL_CHECK_ERROR;
-		glEnableVertexAttribArray(attrLoc);
-		OGL_CHECK_ERROR;
-		glVertexAttribPointer(attrLoc, 2, GL_FLOAT, GL_FALSE, stride, OGL_VBUFFER_OFFSET(offsetSum));
-		OGL_CHECK_ERROR;
+		if (vertexFormat == VertexFormat::Packed)
+		{
+			attrLoc = glGetAttribLocation(program, "inUVTEXINDEX");
+			OGL_CHECK_ERROR;
+			glEnableVertexAttribArray(attrLoc);
+			OGL_CHECK_ERROR;
+			glVertexAttribIPointer(attrLoc, 1, GL_UNSIGNED_INT, stride, OGL_VBUFFER_OFFSET(offsetSum));
+			OGL_CHECK_ERROR;
 
-		if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
-		OGL_CHECK_ERROR;
-		offsetSum += sizeof(f32) * 2;
+			if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
+			OGL_CHECK_ERROR;
+			offsetSum += sizeof(u32);
 
-		attrLoc = glGetAttribLocation(program, "inCOLOR");
-		OGL_CHECK_ERROR;
-		glEnableVertexAttribArray(attrLoc);
-		OGL_CHECK_ERROR;
-		glVertexAttribIPointer(attrLoc, 1, GL_UNSIGNED_INT, stride, OGL_VBUFFER_OFFSET(offsetSum));
-		OGL_CHECK_ERROR;
+			attrLoc = glGetAttribLocation(program, "inCOLOR");
+			OGL_CHECK_ERROR;
+			glEnableVertexAttribArray(attrLoc);
+			OGL_CHECK_ERROR;
+			glVertexAttribIPointer(attrLoc, 1, GL_UNSIGNED_INT, stride, OGL_VBUFFER_OFFSET(offsetSum));
+			OGL_CHECK_ERROR;
 
-		if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
-		OGL_CHECK_ERROR;
-		offsetSum += sizeof(u32);
+			if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
+			OGL_CHECK_ERROR;
+			offsetSum += sizeof(u32);
+		}
+		else
+		{
+			attrLoc = glGetAttribLocation(program, "inTEXCOORD0");
+			OGL_CHECK_ERROR;
+			glEnableVertexAttribArray(attrLoc);
+			OGL_CHECK_ERROR;
+			glVertexAttribPointer(attrLoc, 2, GL_FLOAT, GL_FALSE, stride, OGL_VBUFFER_OFFSET(offsetSum));
+			OGL_CHECK_ERROR;
 
-		attrLoc = glGetAttribLocation(program, "inTEXINDEX");
-		OGL_CHECK_ERROR;
-		glEnableVertexAttribArray(attrLoc);
-		OGL_CHECK_ERROR;
-		glVertexAttribIPointer(attrLoc, 1, GL_UNSIGNED_INT, stride, OGL_VBUFFER_OFFSET(offsetSum));
-		OGL_CHECK_ERROR;
+			if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
+			OGL_CHECK_ERROR;
+			offsetSum += sizeof(f32) * 2;
 
-		if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
-		OGL_CHECK_ERROR;
-		offsetSum += sizeof(u32);
+			attrLoc = glGetAttribLocation(program, "inCOLOR");
+			OGL_CHECK_ERROR;
+			glEnableVertexAttribArray(attrLoc);
+			OGL_CHECK_ERROR;
+			glVertexAttribIPointer(attrLoc, 1, GL_UNSIGNED_INT, stride, OGL_VBUFFER_OFFSET(offsetSum));
+			OGL_CHECK_ERROR;
+
+			if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
+			OGL_CHECK_ERROR;
+			offsetSum += sizeof(u32);
+
+			attrLoc = glGetAttribLocation(program, "inTEXINDEX");
+			OGL_CHECK_ERROR;
+			glEnableVertexAttribArray(attrLoc);
+			OGL_CHECK_ERROR;
+			glVertexAttribIPointer(attrLoc, 1, GL_UNSIGNED_INT, stride, OGL_VBUFFER_OFFSET(offsetSum));
+			OGL_CHECK_ERROR;
+
+			if (glVertexAttribDivisor) glVertexAttribDivisor(attrLoc, 0);
+			OGL_CHECK_ERROR;
+			offsetSum += sizeof(u32);
+		}
 
 		int primType = GL_TRIANGLES;
 
@@ -475,8 +740,18 @@ void OpenGLGraphicsProvider::draw(RenderBatch* batches, u32 count)
 			primType = GL_TRIANGLE_FAN;
 		}
 
-		glDrawArrays(primType, batch.startVertexIndex, batch.vertexCount);
-		OGL_CHECK_ERROR;
+		if (batch.indexBuffer)
+		{
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (uintptr_t)batch.indexBuffer->getHandle());
+			OGL_CHECK_ERROR;
+			glDrawElements(primType, batch.indexCount, GL_UNSIGNED_INT, OGL_VBUFFER_OFFSET(sizeof(u32) * batch.startIndex));
+			OGL_CHECK_ERROR;
+		}
+		else
+		{
+			glDrawArrays(primType, batch.startVertexIndex, batch.vertexCount);
+			OGL_CHECK_ERROR;
+		}
 	}
 
 	glUseProgram(0);
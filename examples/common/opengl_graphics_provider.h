@@ -2,6 +2,7 @@
 #include "horus.h"
 #include "horus_interfaces.h"
 #include <string>
+#include <vector>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -20,34 +21,57 @@ namespace hui
 
 extern void checkErrorGL(const char* where);
 
+struct OpenGLTextureArray;
+
 struct OpenGLRenderTarget
 {
 	u32 width = 0;
 	u32 height = 0;
 	GLuint frameBuffer = 0;
-	GLuint texture = 0;
+	OpenGLTextureArray* textureArray = nullptr; /// a single texture, so the UI shader can draw it
 };
 
 struct OpenGLGraphicsProvider : GraphicsProvider
 {
-	OpenGLGraphicsProvider();
+	/// \param format the vertex format to use, VertexFormat::Packed uploads 16 byte vertices instead of 24
+	OpenGLGraphicsProvider(VertexFormat format = VertexFormat::Full);
 	~OpenGLGraphicsProvider();
 	bool initialize() override;
 	void shutdown() override;
 	ApiType getApiType() const { return GraphicsProvider::ApiType::OpenGL; }
+	VertexFormat getVertexFormat() const override { return vertexFormat; }
 	TextureArray* createTextureArray() override;
 	VertexBuffer* createVertexBuffer() override;
+	IndexBuffer* createIndexBuffer() override;
 	GraphicsApiRenderTarget createRenderTarget(u32 width, u32 height) override;
 	void destroyRenderTarget(GraphicsApiRenderTarget rt) override;
 	void setRenderTarget(GraphicsApiRenderTarget rt) override;
+	TextureArray* getRenderTargetTextureArray(GraphicsApiRenderTarget rt) override;
 	void commitRenderState();
 	void setViewport(const Point& windowSize, const Rect& viewport) override;
 	void clear(const Color& color) override;
+	bool isBackBufferPreserved() const override { return backBufferPreserved; }
+	void setScissor(const Rect& rect) override;
+	void disableScissor() override;
+	bool supportsShaderClipping() const override { return vertexFormat == VertexFormat::Full; }
+	void setClipRects(const Rect* rects, u32 count) override;
+	bool supportsShaderShapes() const override { return vertexFormat == VertexFormat::Full; }
+	bool supportsDistanceFieldGlyphs() const override { return vertexFormat == VertexFormat::Full; }
+	void setShapes(const ShapeParameters* shapes, u32 count) override;
 	void draw(struct RenderBatch* batches, u32 count) override;
 
 	Rect currentViewport;
+	Point currentWindowSize;
+	bool backBufferPreserved = false; /// set it if the window's swap keeps the back buffer contents (e.g. EGL_BUFFER_PRESERVED), so only the damaged areas are redrawn
+	OpenGLRenderTarget* currentRenderTarget = nullptr; /// null for the window's back buffer
+	VertexFormat vertexFormat = VertexFormat::Full;
 	GLuint vertexShader = 0;
 	GLuint pixelShader = 0;
 	GLuint program = 0;
+	static const u32 dataTextureWidth = 1024; /// the width of the clip rect and shape textures, as used by the vertex shader
+	GLuint clipRectTexture = 0; /// the clip rects fetched by the vertex shader, one RGBA32F texel each
+	std::vector<f32> clipRectTexels;
+	GLuint shapeTexture = 0; /// the shapes fetched by the vertex shader, three RGBA32F texels each
+	std::vector<f32> shapeTexels;
 };
 }
\ No newline at end of file
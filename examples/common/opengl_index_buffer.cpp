@@ -0,0 +1,60 @@
+#include "opengl_index_buffer.h"
+#include "opengl_graphics_provider.h"
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <string.h>
+
+namespace hui
+{
+OpenGLIndexBuffer::OpenGLIndexBuffer()
+{
+	glGenBuffers(1, (GLuint*)&ibHandle);
+	OGL_CHECK_ERROR;
+}
+
+OpenGLIndexBuffer::~OpenGLIndexBuffer()
+{
+	destroy();
+}
+
+void OpenGLIndexBuffer::resize(u32 count)
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)ibHandle);
+	OGL_CHECK_ERROR;
+	glBufferData(
+		GL_ELEMENT_ARRAY_BUFFER,
+		sizeof(u32) * count,
+		nullptr,
+		GL_STATIC_DRAW);
+	OGL_CHECK_ERROR;
+}
+
+void OpenGLIndexBuffer::updateData(u32* indices, u32 startIndex, u32 count)
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibHandle);
+	OGL_CHECK_ERROR;
+	glBufferSubData(
+		GL_ELEMENT_ARRAY_BUFFER,
+		sizeof(u32) * startIndex,
+		sizeof(u32) * count,
+		&indices[startIndex]);
+	OGL_CHECK_ERROR;
+}
+
+void OpenGLIndexBuffer::destroy()
+{
+	glDeleteBuffers(1, &ibHandle);
+	ibHandle = 0;
+}
+
+GraphicsApiIndexBuffer OpenGLIndexBuffer::getHandle() const
+{
+	return (GraphicsApiIndexBuffer)ibHandle;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+#include "horus.h"
+#include "horus_interfaces.h"
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+namespace hui
+{
+struct OpenGLIndexBuffer : IndexBuffer
+{
+	OpenGLIndexBuffer();
+	virtual ~OpenGLIndexBuffer();
+	virtual void resize(u32 count) override;
+	virtual void updateData(u32* indices, u32 startIndex, u32 count) override;
+	virtual void destroy();
+	virtual GraphicsApiIndexBuffer getHandle() const override;
+
+	GLuint ibHandle = 0;
+};
+
+}
\ No newline at end of file
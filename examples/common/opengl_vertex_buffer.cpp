@@ -8,6 +8,7 @@
 #endif
 
 #include <string.h>
+#include <algorithm>
 
 namespace hui
 {
@@ -22,6 +23,12 @@ OpenGLVertexBuffer::OpenGLVertexBuffer(u32 count, Vertex* vertices)
 	updateData(vertices, 0, count);
 }
 
+OpenGLVertexBuffer::OpenGLVertexBuffer(VertexFormat format)
+{
+	vertexSize = format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+	create(1);
+}
+
 OpenGLVertexBuffer::~OpenGLVertexBuffer()
 {
 	destroy();
@@ -31,31 +38,148 @@ void OpenGLVertexBuffer::create(u32 count)
 {
 	glGenBuffers(1, (GLuint*)&vbHandle);
 	OGL_CHECK_ERROR;
+	ringHandles.push_back(vbHandle);
+	ringFences.push_back(nullptr);
 	resize(count);
 }
 
 void OpenGLVertexBuffer::resize(u32 count)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vbHandle);
-	OGL_CHECK_ERROR;
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		sizeof(Vertex) * count,
-		nullptr,
-		GL_DYNAMIC_DRAW);
-	OGL_CHECK_ERROR;
+	vertexCount = count;
+
+	for (auto handle : ringHandles)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, handle);
+		OGL_CHECK_ERROR;
+		glBufferData(
+			GL_ARRAY_BUFFER,
+			vertexSize * count,
+			nullptr,
+			GL_STREAM_DRAW);
+		OGL_CHECK_ERROR;
+	}
+}
+
+void OpenGLVertexBuffer::setStreamingMode(VertexStreamingMode mode, u32 ringSize)
+{
+	u32 bufferCount = mode == VertexStreamingMode::Ring ? std::max(ringSize, 1u) : 1;
+
+	streamingMode = mode;
+
+	deleteRingFences();
+
+	while (ringHandles.size() > bufferCount)
+	{
+		glDeleteBuffers(1, &ringHandles.back());
+		OGL_CHECK_ERROR;
+		ringHandles.pop_back();
+	}
+
+	while (ringHandles.size() < bufferCount)
+	{
+		GLuint handle = 0;
+
+		glGenBuffers(1, &handle);
+		OGL_CHECK_ERROR;
+		glBindBuffer(GL_ARRAY_BUFFER, handle);
+		OGL_CHECK_ERROR;
+		glBufferData(GL_ARRAY_BUFFER, vertexSize * vertexCount, nullptr, GL_STREAM_DRAW);
+		OGL_CHECK_ERROR;
+		ringHandles.push_back(handle);
+	}
+
+	ringFences.resize(ringHandles.size(), nullptr);
+	ringIndex = 0;
+	vbHandle = ringHandles[0];
+}
+
+void OpenGLVertexBuffer::deleteRingFences()
+{
+	for (auto& fence : ringFences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+}
+
+void OpenGLVertexBuffer::beginFrameUpload()
+{
+	switch (streamingMode)
+	{
+	case VertexStreamingMode::Orphan:
+		// same size and no data, the driver gives us new storage while the GPU still reads the old one
+		glBindBuffer(GL_ARRAY_BUFFER, vbHandle);
+		OGL_CHECK_ERROR;
+		glBufferData(GL_ARRAY_BUFFER, vertexSize * vertexCount, nullptr, GL_STREAM_DRAW);
+		OGL_CHECK_ERROR;
+		break;
+	case VertexStreamingMode::Ring:
+	{
+		// the draws using the current buffer were already submitted, signal when the GPU is done with them
+		if (ringFences[ringIndex])
+			glDeleteSync(ringFences[ringIndex]);
+
+		ringFences[ringIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		OGL_CHECK_ERROR;
+		ringIndex = (ringIndex + 1) % ringHandles.size();
+		vbHandle = ringHandles[ringIndex];
+
+		// the buffer is written unsynchronized, so wait if the GPU still reads it,
+		// this happens when the ring is smaller than the uploads in flight, like when drawing more windows than the ring size
+		auto& fence = ringFences[ringIndex];
+
+		if (fence)
+		{
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+			OGL_CHECK_ERROR;
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		break;
+	}
+	default:
+		break;
+	}
 }
 
 void OpenGLVertexBuffer::updateData(Vertex* vertices, u32 startVertexIndex, u32 count)
+{
+	updateRawData((const u8*)&vertices[startVertexIndex], startVertexIndex, count);
+}
+
+bool OpenGLVertexBuffer::updateDataRange(Vertex* vertices, u32 startVertexIndex, u32 count)
+{
+	updateRawData((const u8*)vertices, startVertexIndex, count);
+	return true;
+}
+
+void OpenGLVertexBuffer::updatePackedData(PackedVertex* vertices, u32 startVertexIndex, u32 count)
+{
+	updateRawData((const u8*)&vertices[startVertexIndex], startVertexIndex, count);
+}
+
+void OpenGLVertexBuffer::updateRawData(const u8* vertices, u32 startVertexIndex, u32 count)
 {
 	glBindBuffer(GL_ARRAY_BUFFER, vbHandle);
 	OGL_CHECK_ERROR;
 
+	GLbitfield access = GL_MAP_WRITE_BIT;
+
+	// the orphaned storage is not used by the GPU and the ring buffer was fenced in beginFrameUpload, so there is no need to sync
+	if (streamingMode != VertexStreamingMode::Direct)
+	{
+		access |= GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	}
+
 	u8* data = (u8*)glMapBufferRange(
 		GL_ARRAY_BUFFER,
-		sizeof(Vertex) * startVertexIndex,
-		sizeof(Vertex) * count,
-		GL_MAP_WRITE_BIT);
+		vertexSize * startVertexIndex,
+		vertexSize * count,
+		access);
 	OGL_CHECK_ERROR;
 
 	if (!data)
@@ -63,10 +187,7 @@ void OpenGLVertexBuffer::updateData(Vertex* vertices, u32 startVertexIndex, u32
 		return;
 	}
 
-	memcpy(
-		data,
-		&vertices[startVertexIndex],
-		count * sizeof(Vertex));
+	memcpy(data, vertices, count * vertexSize);
 
 	glUnmapBuffer(GL_ARRAY_BUFFER);
 	OGL_CHECK_ERROR;
@@ -74,7 +195,15 @@ void OpenGLVertexBuffer::updateData(Vertex* vertices, u32 startVertexIndex, u32
 
 void OpenGLVertexBuffer::destroy()
 {
-	glDeleteBuffers(1, &vbHandle);
+	deleteRingFences();
+	ringFences.clear();
+
+	for (auto handle : ringHandles)
+	{
+		glDeleteBuffers(1, &handle);
+	}
+
+	ringHandles.clear();
 	vbHandle = 0;
 }
 
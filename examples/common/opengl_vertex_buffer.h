@@ -3,6 +3,7 @@
 #include "horus_interfaces.h"
 #define GLEW_STATIC
 #include <GL/glew.h>
+#include <vector>
 
 namespace hui
 {
@@ -10,14 +11,27 @@ struct OpenGLVertexBuffer : VertexBuffer
 {
 	OpenGLVertexBuffer();
 	OpenGLVertexBuffer(u32 count, Vertex* vertices);
+	OpenGLVertexBuffer(VertexFormat format);
 	virtual ~OpenGLVertexBuffer();
 	virtual void resize(u32 count) override;
+	virtual void setStreamingMode(VertexStreamingMode mode, u32 ringSize) override;
+	virtual void beginFrameUpload() override;
 	virtual void updateData(Vertex* vertices, u32 startVertexIndex, u32 count) override;
+	virtual bool updateDataRange(Vertex* vertices, u32 startVertexIndex, u32 count) override;
+	virtual void updatePackedData(PackedVertex* vertices, u32 startVertexIndex, u32 count) override;
+	void updateRawData(const u8* vertices, u32 startVertexIndex, u32 count);
 	virtual void destroy();
 	virtual GraphicsApiVertexBuffer getHandle() const override;
 	void create(u32 count);
+	void deleteRingFences();
 
-	GLuint vbHandle = 0;
+	GLuint vbHandle = 0; /// the buffer used for the current frame
+	std::vector<GLuint> ringHandles;
+	std::vector<GLsync> ringFences; /// signaled when the GPU finished the draws using the ring buffer at the same index
+	u32 ringIndex = 0;
+	u32 vertexCount = 0;
+	u32 vertexSize = sizeof(Vertex);
+	VertexStreamingMode streamingMode = VertexStreamingMode::Direct;
 };
 
 }
\ No newline at end of file
@@ -129,7 +129,9 @@ typedef void* GraphicsApiContext;
 typedef void* GraphicsApiTexture;
 typedef void* GraphicsApiRenderTarget;
 typedef void* GraphicsApiVertexBuffer;
+typedef void* GraphicsApiIndexBuffer;
 typedef void* Context;
+typedef void* DrawCommandCapture;
 typedef u32 Rgba32;
 typedef u32 TabIndex;
 typedef u32 ViewId;
@@ -547,6 +549,13 @@ enum class TextCachePruneMode
 	Frames /// delete unused text after N frames
 };
 
+/// An inclusive range of unicode code points
+struct GlyphCodeRange
+{
+	u32 first;
+	u32 last;
+};
+
 /// Slider drag direction modes
 enum class SliderDragDirection
 {
@@ -555,6 +564,88 @@ enum class SliderDragDirection
 	VerticalOnly
 };
 
+/// How the vertex data is streamed to the GPU every frame
+enum class VertexStreamingMode
+{
+	Direct, /// write the vertex buffer in place, the CPU may wait for the GPU to finish reading the previous frame's vertices
+	Orphan, /// give the vertex buffer new storage before writing, the GPU keeps reading the old storage
+	Ring /// cycle through a ring of vertex buffers, one for each upload in flight (each window uploads once per frame), the CPU waits for the GPU only when reusing a buffer it still reads
+};
+
+/// The draw command types recorded by the renderer
+enum class DrawCommandType : u16
+{
+	None,
+	DrawRect,
+	DrawQuad,
+	DrawImageBordered,
+	DrawLine,
+	DrawPolyLine,
+	DrawText,
+	DrawInterpolatedColors,
+	DrawSpectrumColors,
+	DrawSolidTriangle,
+	ClipRect,
+	SetViewportOffset,
+	SetAtlas,
+	SetColor,
+	SetFont,
+	SetTextStyle,
+	SetLineStyle,
+	SetFillStyle,
+	Callback,
+	BeginCachedLayer,
+	EndCachedLayer,
+	DrawShape,
+
+	Count
+};
+
+/// The timed phases of a rendered frame
+enum class FramePhase
+{
+	WidgetBuild, /// recording the draw commands, from the window's begin to its end
+	Damage, /// computing the areas changed since the window's previous frame, when ContextSettings::partialRedraw is enabled
+	Tessellate, /// generating the vertices from the draw commands, including splitting them in chunks for the worker threads, when used
+	Merge, /// merging the render batches with the same state
+	Upload, /// uploading the vertices to the GPU
+	Submit, /// sending the batches to the graphics provider
+
+	Count
+};
+
+/// The counters and timings of a rendered frame
+struct FrameStats
+{
+	u32 drawCommandCount = 0;
+	u32 drawCommandCountByType[(u32)DrawCommandType::Count] = {};
+	u32 generatedBatchCount = 0; /// the render batch count before merging
+	u32 drawnBatchCount = 0; /// the render batch count after merging, these are the draw calls sent to the graphics provider
+	u32 vertexCount = 0;
+	u64 uploadedByteCount = 0; /// the vertex and index bytes sent to the GPU
+	u32 rasterizedGlyphCount = 0;
+	u32 atlasPackCount = 0;
+	u32 textCacheHitCount = 0;
+	u32 textCacheMissCount = 0;
+	u32 textCacheBypassCount = 0; /// the texts changing every frame, converted without being cached
+	u32 glyphRunCacheHitCount = 0; /// the texts drawn from their cached glyph runs
+	u32 glyphRunCacheMissCount = 0; /// the texts laid out into new glyph runs, or whose runs were stale after the atlas was repacked
+	u32 cachedLayerCount = 0; /// the cached layers drawn from their render targets
+	u32 redrawnCachedLayerCount = 0; /// the cached layers whose render targets were redrawn, because their contents changed or were invalidated
+	u32 culledDrawCommandCount = 0; /// the draw commands not recorded, because they were outside the clip rect
+	u32 damageRectCount = 0; /// the window areas changed since the window's previous frame, computed when ContextSettings::partialRedraw is enabled
+	f32 damagedArea = 0; /// the pixel area of the damaged rectangles
+	f64 phaseTime[(u32)FramePhase::Count] = {}; /// in milliseconds
+};
+
+/// The timing of a frame phase over the last frames, in milliseconds
+struct FramePhaseTiming
+{
+	f64 min = 0;
+	f64 average = 0;
+	f64 p99 = 0;
+};
+
 enum class AntiAliasing
 {
 	None,
@@ -1466,6 +1557,27 @@ struct FillStyle
 	Point scale;
 };
 
+/// The shapes drawn by evaluating their signed distance per pixel, in a single quad
+enum class ShapeType : u8
+{
+	RoundedRectangle, /// the rectangle with rounded corners and an optional border
+	Circle, /// the biggest circle fitting in the rectangle, with an optional border
+	Ring, /// the circle's outline, borderWidth thick, filled with the fill color
+	Arc /// a part of the ring, from the start to the end angle, with round ends
+};
+
+/// A shape drawn with hui::drawShape, or used by a theme element instead of an image.
+/// It's filled with the current color and stays sharp at any scale, without any atlas image
+struct Shape
+{
+	ShapeType type = ShapeType::RoundedRectangle;
+	f32 cornerRadius = 0; /// the rounded rectangle's corner radius
+	f32 borderWidth = 0; /// the border width, for the ring and arc their thickness
+	Color borderColor = Color::white;
+	f32 startAngle = 0; /// the arc's start angle in radians, clockwise from the right
+	f32 endAngle = 0; /// the arc's end angle in radians, bigger than the start angle
+};
+
 /// Raw image data info
 struct RawImage
 {
@@ -1501,6 +1613,8 @@ struct ContextSettings
 	f32 textCachePruneMaxTimeSec = 5; /// after this time, if an Unicode text is not accessed, it's discarded from cache, textCachePruneMode must be Time
 	f32 textCachePruneMaxFrames = 500; /// after this frame count, if an Unicode text is not accessed, it's discarded from cache, textCachePruneMode must be Frames
 	f32 textCachePruneIntervalSec = 5; /// after each interval has passed, the pruning of unused texts is executed, will delete the texts that were not used for the last textCachePruneMaxTimeMs or textCachePruneMaxFrames, depending on the prune mode
+	u32 textCacheMaxByteSize = 4 * 1024 * 1024; /// when the unicode text cache is bigger, the least recently used texts are evicted, except the ones used in the current frame
+	u32 textCacheVolatileFrameCount = 3; /// when a text buffer had a different text for this many frames in a row, its new texts are not cached, 0 caches all texts
 	u32 defaultAtlasSize = 4096; /// default atlas textures size in pixels
 	SliderDragDirection sliderDragDirection = SliderDragDirection::Any; /// allows to change slider value from any direction drag, vertical or horizontal
 	bool sliderInvertVerticalDragAmount = false; /// if true and vertical sliding allowed, it will invert the drag amount
@@ -1511,6 +1625,24 @@ struct ContextSettings
 	bool allowUndockingToNewWindow = true; /// allow pane tabs to be undocked as native windows, outside of main window
 	u32 widgetLoopStartId = 1000000000; /// when pushing loops into loop stack, the widget ids will start from here. Basically this avoids the user to specify IDs when creating widgets in a loop, taking into account the fact there will not be so many widgets created anyway.
 	u32 widgetLoopMaxCount = 500000; /// current increment after each loop push to stack
+	VertexStreamingMode vertexStreamingMode = VertexStreamingMode::Orphan; /// how the vertices are uploaded to the GPU each frame
+	u32 vertexStreamingRingSize = 3; /// the number of vertex buffers in the ring, used when vertexStreamingMode is Ring
+	u32 batchMergeLookback = 8; /// how many previous render batches are searched when merging a batch with one it doesn't overlap, 0 will only merge adjacent batches
+	u32 vertexGenerationThreadCount = 1; /// the threads generating the vertices from the draw commands, 1 generates them on the calling thread, 0 uses all the hardware threads
+	u32 parallelVertexGenerationMinCommandCount = 4096; /// below this draw command count, the vertices are generated on the calling thread
+	u32 frameStatsHistorySize = 120; /// how many frames are kept for the rolling phase timings
+	u32 cachedLayerMaxUnusedFrames = 60; /// the cached layers not used for this many frames have their render targets destroyed
+	bool partialRedraw = false; /// compute the window areas changed since the window's previous frame, if the graphics provider preserves the back buffer only those are redrawn, and they are passed to the input provider when presenting
+	u32 maxDamageRectCount = 8; /// the damaged rectangles are merged until there are at most this many
+	bool shaderClipping = false; /// if the graphics provider supports it, the vertices carry their clip rect and the pixels are clipped in the shader, instead of clipping the geometry on the CPU
+	bool shaderShapes = true; /// if the graphics provider supports it, the shapes are drawn as single quads evaluated in the shader, otherwise they're tessellated on the CPU
+	bool glyphRunCache = true; /// the texts are laid out once per font and their glyph quads are cached, otherwise each glyph and kerning pair is looked up every time the text is drawn
+	bool distanceFieldGlyphs = false; /// if the graphics provider supports it, the fonts loaded after setting it rasterize their glyphs once as signed distance fields, scaled to any face size, so the global scale changes don't rasterize the glyphs again or repack the atlas, and the fonts of the same face share their glyphs
+	u32 distanceFieldGlyphFaceSize = 48; /// the face size in pixels the distance field glyphs are rasterized at
+	u32 distanceFieldGlyphSpread = 6; /// the distance in pixels, at distanceFieldGlyphFaceSize, stored around the glyph outlines
+	u32 glyphRunCachePruneMaxFrames = 500; /// after this frame count, if a glyph run is not drawn, it's discarded from cache, the pruning is done with the unicode text cache's pruning
+	static const u32 maxDenseKerningRangeCount = 4;
+	GlyphCodeRange denseKerningRanges[maxDenseKerningRangeCount] = { { 0x20, 0xFF }, { 0x400, 0x45F } }; /// the code point ranges whose kerning pairs are computed in a table on the first kerning lookup of a font file, and shared by its fonts of all sizes, the pairs outside them are looked up and cached on use. By default Latin-1 and basic Cyrillic, a range with a zero last code is unused
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -1583,6 +1715,36 @@ HORUS_API void forceRepaint();
 /// If called, rendering and input will be ignored until the endFrame and the loop will redraw again, used mostly internally when layout is computed
 HORUS_API void skipThisFrame();
 
+/// \return the counters and phase timings of the last rendered window
+HORUS_API const FrameStats& getFrameStats();
+
+/// Get the timing of a frame phase, over the last rendered windows
+/// \param phase the frame phase
+/// \return the min, average and 99th percentile of the phase time, in milliseconds
+HORUS_API FramePhaseTiming getFramePhaseTiming(FramePhase phase);
+
+/// Save the draw commands of the next rendered window to a file, in execution order, with the images, fonts and atlases they reference, to be replayed offline
+/// \param filename the capture filename
+HORUS_API void captureNextFrameDrawCommands(const char* filename);
+
+/// Load a draw command capture, the captured fonts are loaded again from their font files and the atlases are created without the captured images' pixels
+/// \param filename the capture filename
+/// \param fontFolder if not null, the fonts are loaded from this folder instead of their captured paths
+/// \return the capture, null if it cannot be loaded
+HORUS_API DrawCommandCapture loadDrawCommandCapture(const char* filename, const char* fontFolder = nullptr);
+
+/// Replace the draw commands of the current window with the captured commands, call it between beginWindow and endWindow, the capture is tessellated and submitted on endWindow
+/// \param capture the capture to replay
+HORUS_API void replayDrawCommandCapture(DrawCommandCapture capture);
+
+/// \param capture the capture
+/// \return the size of the window the capture was recorded in
+HORUS_API Point getDrawCommandCaptureWindowSize(DrawCommandCapture capture);
+
+/// Delete a loaded draw command capture
+/// \param capture the capture to delete
+HORUS_API void deleteDrawCommandCapture(DrawCommandCapture capture);
+
 /// Copy UTF8 text to the clipboard
 /// \param text the null ended UTF8 text
 /// \return true if text was copied to clipboard
@@ -1613,6 +1775,13 @@ HORUS_API u32 getInputEventCount();
 /// \param index the event index (maximum is getInputEventCount())
 HORUS_API InputEvent getInputEventAt(u32 index);
 
+/// \return the damaged rectangle count of the current window's last rendered frame, computed when ContextSettings::partialRedraw is enabled, zero if nothing changed
+HORUS_API u32 getDamageRectCount();
+
+/// \return the damaged rectangle at the index, in window coordinates, a zero rectangle if the index is out of range
+/// \param index the rectangle index (maximum is getDamageRectCount())
+HORUS_API Rect getDamageRectAt(u32 index);
+
 /// Set the current input event, usually called by input providers
 /// \param event the event to be set
 HORUS_API void setInputEvent(const InputEvent& event);
@@ -1844,6 +2013,14 @@ HORUS_API Theme createTheme(u32 atlasTextureSize);
 /// \return the newly created image handle
 HORUS_API Image addThemeImage(Theme theme, const RawImage& img);
 
+/// Add a shape image to a theme, drawn as the shape wherever the image is used, it doesn't take any atlas space
+/// \param theme the theme
+/// \param shape the shape, its sizes are scaled by the global scale when drawn
+/// \param width the image width, used by the widgets sizing their elements by image
+/// \param height the image height
+/// \return the newly created image handle
+HORUS_API Image addThemeShapeImage(Theme theme, const Shape& shape, u32 width, u32 height);
+
 HORUS_API void setWidgetStyle(WidgetType widgetType, const char* styleName);
 
 HORUS_API void setWidgetDefaultStyle(WidgetType widgetType);
@@ -1926,6 +2103,27 @@ HORUS_API void beginContainer(const Rect& rect);
 /// End the current widget container
 HORUS_API void endContainer();
 
+/// Begin a region rendered into its own render target, drawn as a single textured quad while its contents don't change.
+/// The widgets inside are still called every frame and their draw commands are compared with the cached ones,
+/// the render target is redrawn only when they differ, when a mouse event happens inside the rect or when the layer is invalidated.
+/// Useful for heavy panels which rarely change, like inspectors. Nested cached layers are drawn as part of the outer one
+/// \param key the layer key, unique across all windows
+/// \param rect the layer rectangle in window coordinates, its contents are clipped to it
+HORUS_API void beginCachedLayer(u64 key, const Rect& rect);
+
+/// End the current cached layer
+HORUS_API void endCachedLayer();
+
+/// Redraw a cached layer's render target the next time it's used, for changes not visible in its draw commands, like a modified image
+/// \param key the layer key
+HORUS_API void invalidateCachedLayer(u64 key);
+
+/// Check if a rectangle can be seen inside the current clip rect, so widgets can skip building content scrolled out of view.
+/// The draw commands outside the clip rect are not recorded anyway
+/// \param rect the rectangle in window coordinates
+/// \return true if the rectangle is at least partially inside the clip rect
+HORUS_API bool isRectVisible(const Rect& rect);
+
 /// Push a widget loop, used when you create widgets inside a loop.
 /// For each pushed loop, the widget IDs will be created incrementally in the upper range of uint32
 /// \param loopMaxCount optional, this should be a constant for this specific loop, the max number of widgets that might be in this loop. If -1, use the current loop size set with getSettings().widgetLoopMaxCount
@@ -2579,6 +2777,11 @@ HORUS_API void drawArrow(const Point& startPoint, const Point& endPoint, f32 tip
 
 HORUS_API void drawSolidTriangle(const Point& p1, const Point& p2, const Point& p3);
 
+/// Draw a shape filled with the current color, see hui::setColor
+/// \param shape the shape
+/// \param rect the shape's rectangle, the circles, rings and arcs are centered in it
+HORUS_API void drawShape(const Shape& shape, const Rect& rect);
+
 //////////////////////////////////////////////////////////////////////////
 // Pane container functions
 //////////////////////////////////////////////////////////////////////////
@@ -8,7 +8,50 @@ struct Vertex
 	Point position;
 	Point uv;
 	u32 color;
-	u32 textureIndex = 0; /// what atlas texture array index this vertex is using
+	u16 textureIndex = 0; /// what atlas texture array index this vertex is using
+	u16 clipRectIndex = 0; /// when the graphics provider clips in the shader, the index of the clip rect the pixels are clipped to, zero if not clipped, see GraphicsProvider::setClipRects
+};
+
+/// The vertex layouts the library can upload to the vertex buffers
+enum class VertexFormat
+{
+	Full, /// the Vertex struct, 24 bytes
+	Packed /// the PackedVertex struct, 16 bytes
+};
+
+/// A compact vertex struct for rendering UI, used when the graphics provider's vertex format is VertexFormat::Packed.
+/// The UVs are 14 bit unorms and the texture array index is kept in the top 4 bits, so atlases can have at most 16 textures,
+/// UiAtlas::pack stops adding textures past that and reports the images it could not pack
+struct PackedVertex
+{
+	Point position;
+	u32 uvAndTextureIndex = 0; /// u in bits 0-13, v in bits 14-27, texture index in bits 28-31
+	u32 color = 0;
+};
+
+const u32 packedVertexUvBits = 14;
+const u32 packedVertexUvMask = (1 << packedVertexUvBits) - 1;
+const u32 packedVertexMaxTextureIndex = 15;
+
+/// Set in Vertex::textureIndex for the vertices of the shapes evaluated in the shader, the other bits are the shape's index, see GraphicsProvider::setShapes.
+/// The shape vertices' uv are their offsets from the shape's center, in pixels
+const u32 shapeTextureIndexFlag = 0x8000;
+const u32 maxShapeCount = shapeTextureIndexFlag;
+
+/// Set in Vertex::textureIndex, without shapeTextureIndexFlag, for the vertices of the distance field glyphs, the other bits are the atlas texture index.
+/// The texel alpha is the signed distance to the glyph outline, 0.5 on the outline, see GraphicsProvider::supportsDistanceFieldGlyphs
+const u32 distanceFieldTextureIndexFlag = 0x4000;
+
+/// A shape evaluated per pixel by the graphics provider, in the table set with GraphicsProvider::setShapes
+struct ShapeParameters
+{
+	Point halfSize; /// half the rectangle size, for the circle it's the radius on both axes
+	f32 cornerRadius = 0; /// for the circle, ring and arc, their radius
+	f32 borderWidth = 0; /// for the ring and arc, their thickness
+	u32 borderColor = 0; /// packed RGBA, as used by the vertices
+	u32 type = 0; /// a ShapeType
+	f32 startAngle = 0;
+	f32 endAngle = 0;
 };
 
 /// The input provider class is used for input and windowing services
@@ -81,6 +124,12 @@ struct InputProvider
 	/// \param window the window to present
 	virtual void presentWindow(Window window) = 0;
 
+	/// Present only the changed areas of the window's backbuffer, called instead of presentWindow when ContextSettings::partialRedraw is enabled
+	/// \param window the window to present
+	/// \param damageRects the rectangles changed since the last present, in window coordinates
+	/// \param damageRectCount the rectangle count, zero if nothing changed
+	virtual void presentWindowRects(Window window, const Rect* damageRects, u32 damageRectCount) { presentWindow(window); }
+
 	/// Destroy a native window
 	/// \param window the window
 	virtual void destroyWindow(Window window) = 0;
@@ -206,16 +255,59 @@ struct VertexBuffer
 	/// Resize the vertex buffer, it will not keep the old contents
 	virtual void resize(u32 count) = 0;
 
+	/// Set how the vertex data is streamed to the GPU every frame
+	/// \param mode the streaming mode
+	/// \param ringSize the number of buffers in the ring, used when mode is VertexStreamingMode::Ring
+	/// The default implementation does nothing, which is fine for VertexStreamingMode::Direct
+	virtual void setStreamingMode(VertexStreamingMode mode, u32 ringSize) {}
+
+	/// Called before the frame's vertex data is updated, the buffer orphans its storage or moves to the next buffer in the ring, depending on the streaming mode.
+	/// The default implementation does nothing, which is fine for VertexStreamingMode::Direct
+	virtual void beginFrameUpload() {}
+
 	/// Update the vertex data on a specified range
-	/// \param vertices the new vertex data slice
+	/// \param vertices the whole vertex array, the data is read starting at vertices[startVertexIndex]
 	/// \param startVertexIndex the start vertex index offset
 	/// \param count the vertex count to update
 	virtual void updateData(Vertex* vertices, u32 startVertexIndex, u32 count) = 0;
 
+	/// Update the vertex data on a specified range from a slice of vertices, used to upload the renderer's vertex pages without gathering them first
+	/// \param vertices the vertex data slice, its first vertex is written at startVertexIndex
+	/// \param startVertexIndex the start vertex index offset
+	/// \param count the vertex count to update
+	/// \return false if not supported, the default, then the library gathers the vertices and calls updateData
+	virtual bool updateDataRange(Vertex* vertices, u32 startVertexIndex, u32 count) { return false; }
+
+	/// Update the vertex data on a specified range, used instead of updateData when the graphics provider's vertex format is VertexFormat::Packed
+	/// \param vertices the whole packed vertex array, the data is read starting at vertices[startVertexIndex]
+	/// \param startVertexIndex the start vertex index offset
+	/// \param count the vertex count to update
+	virtual void updatePackedData(PackedVertex* vertices, u32 startVertexIndex, u32 count) {}
+
 	/// \return the graphics API handle for this vertex buffer, you may cast it to the proper handle your graphics API uses
 	virtual GraphicsApiVertexBuffer getHandle() const = 0;
 };
 
+/// An index buffer used to render UI quads from 4 vertices each, instead of 6.
+/// The library fills it with a static quad index pattern and only updates it when it needs to grow
+struct IndexBuffer
+{
+	IndexBuffer() {}
+	virtual ~IndexBuffer() {}
+
+	/// Resize the index buffer, it will not keep the old contents
+	virtual void resize(u32 count) = 0;
+
+	/// Update the index data on a specified range, same as VertexBuffer::updateData
+	/// \param indices the whole index array, the data is read starting at indices[startIndex]
+	/// \param startIndex the start index offset
+	/// \param count the index count to update
+	virtual void updateData(u32* indices, u32 startIndex, u32 count) = 0;
+
+	/// \return the graphics API handle for this index buffer, you may cast it to the proper handle your graphics API uses
+	virtual GraphicsApiIndexBuffer getHandle() const = 0;
+};
+
 /// A render batch is a single drawcall, which renders the whole UI or part of it.
 /// More render batches are generated when the various parts of the UI cannot be rendered together,
 /// for example when a different texture atlas is used or different render states
@@ -230,10 +322,13 @@ struct RenderBatch
 
 	PrimitiveType primitiveType = PrimitiveType::TriangleList;
 	VertexBuffer* vertexBuffer = nullptr; /// which vertex buffer to use for rendering
+	IndexBuffer* indexBuffer = nullptr; /// if not null, the batch is rendered indexed, using startIndex and indexCount
 	TextureArray* textureArray = nullptr; /// which texture array to use for rendering
 	Atlas atlas = nullptr; /// handle to the corresponding image atlas
 	u32 startVertexIndex = 0; /// where to start rendering
 	u32 vertexCount = 0; /// how many vertices to use for rendering the primitives
+	u32 startIndex = 0; /// where to start rendering, in the index buffer
+	u32 indexCount = 0; /// how many indices to use for rendering the primitives
 	/// The draw command callback is used when the user wants to render this batch
 	typedef void(*DrawCommandCallback)(void* userdata, RenderBatch& batch);
 	/// User defined command callback
@@ -268,6 +363,9 @@ struct GraphicsProvider
 	/// \return the graphics API type
 	virtual ApiType getApiType() const = 0;
 
+	/// \return the vertex format the vertex buffers of this provider expect, override to use the packed vertex format
+	virtual VertexFormat getVertexFormat() const { return VertexFormat::Full; }
+
 	/// Create a new texture array object used for UI image atlas
 	virtual TextureArray* createTextureArray() = 0;
 
@@ -275,6 +373,10 @@ struct GraphicsProvider
 	/// \return new vertex buffer
 	virtual VertexBuffer* createVertexBuffer() = 0;
 
+	/// Create a new index buffer, used to draw the quads indexed from a static quad index pattern
+	/// \return new index buffer, null if not supported, then the quads are uploaded as two triangles of 3 vertices and drawn without indices
+	virtual IndexBuffer* createIndexBuffer() { return nullptr; }
+
 	/// Create a new render target texture
 	/// \param width the texture width
 	/// \param height the texture height
@@ -284,16 +386,58 @@ struct GraphicsProvider
 	virtual void destroyRenderTarget(GraphicsApiRenderTarget rt) = 0;
 
 	/// Set the current render target
+	/// \param rt the render target, null for the window's back buffer
 	virtual void setRenderTarget(GraphicsApiRenderTarget rt) = 0;
 
+	/// Used to draw a render target's contents together with the UI, like the cached layers.
+	/// The render target's contents must be sampled with the top-left corner at UV (0, 0), and the render target must keep
+	/// the alpha of what's drawn into it, blending the destination alpha with one minus the source alpha
+	/// \param rt the render target
+	/// \return the render target's texture, as a texture array with a single texture owned by the render target, null if not supported
+	virtual TextureArray* getRenderTargetTextureArray(GraphicsApiRenderTarget rt) { return nullptr; }
+
 	/// Set the current viewport and scissor box
 	/// \param windowSize the native window's current size
 	/// \param viewport the viewport with top-left corner as (0,0)
 	virtual void setViewport(const Point& windowSize, const Rect& viewport) = 0;
 
-	/// Clear the current backbuffer with a specified color
+	/// Clear the current backbuffer with a specified color, only inside the scissor rectangle if one is set
 	virtual void clear(const Color& color) = 0;
 
+	/// \return true if the window's back buffer keeps its contents after being presented, so only the damaged areas need to be redrawn
+	virtual bool isBackBufferPreserved() const { return false; }
+
+	/// Restrict the clears and draws to a rectangle, until disableScissor is called
+	/// \param rect the rectangle, in window coordinates with top-left corner as (0,0)
+	virtual void setScissor(const Rect& rect) {}
+
+	/// Remove the scissor rectangle
+	virtual void disableScissor() {}
+
+	/// \return true if the provider can clip the pixels to the vertices' clip rects in the shader, see setClipRects, it needs the VertexFormat::Full vertices
+	virtual bool supportsShaderClipping() const { return false; }
+
+	/// Set the clip rects the vertices point to, for the next draws, when ContextSettings::shaderClipping is enabled.
+	/// The pixels of the vertices with a non zero Vertex::clipRectIndex are discarded outside rects[clipRectIndex], the ones with a zero index are not clipped
+	/// \param rects the clip rects, in window coordinates, the first one is not used
+	/// \param count the rect count
+	virtual void setClipRects(const Rect* rects, u32 count) {}
+
+	/// \return true if the provider can draw the shapes in the shader, see setShapes, it needs the VertexFormat::Full vertices
+	virtual bool supportsShaderShapes() const { return false; }
+
+	/// Set the shapes the vertices point to, for the next draws, when ContextSettings::shaderShapes is enabled.
+	/// The vertices with shapeTextureIndexFlag set in Vertex::textureIndex don't sample the texture, their pixels get the vertex color
+	/// with the coverage and border of shapes[textureIndex & ~shapeTextureIndexFlag], computed from its signed distance at the vertex uv
+	/// \param shapes the shapes
+	/// \param count the shape count
+	virtual void setShapes(const ShapeParameters* shapes, u32 count) {}
+
+	/// \return true if the provider can draw the distance field glyphs, it needs the VertexFormat::Full vertices.
+	/// The vertices with distanceFieldTextureIndexFlag set in Vertex::textureIndex sample their texture linearly
+	/// and their pixels get the vertex color with the coverage computed from the texel alpha and its screen space derivatives
+	virtual bool supportsDistanceFieldGlyphs() const { return false; }
+
 	/// Draw the given render batch array
 	virtual void draw(struct RenderBatch* batches, u32 count) = 0;
 };
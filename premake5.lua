@@ -123,3 +123,6 @@ group "horus"
 
 group "examples"
   includeall "examples"
+
+group "tools"
+  include "tools"
@@ -48,7 +48,7 @@ Rect getWidgetRect()
 
 void pushDrawCommandIndex()
 {
-	ctx->drawCmdIndexStack.push_back(ctx->renderer->getDrawCommandCount());
+	ctx->drawCmdIndexStack.push_back(ctx->renderer->addDrawCmdInsertionPoint());
 }
 
 u32 popDrawCommandIndex()
@@ -158,16 +158,14 @@ void drawLine(const Point& a, const Point& b)
 
 void drawPolyLine(const Point* points, u32 pointCount, bool closed)
 {
-	std::vector<Point> pts;
-	
-	pts.resize(pointCount);
+	auto pts = ctx->renderer->getFrameArena().allocate<Point>(pointCount);
 
 	for (u32 i = 0; i < pointCount; i++)
 	{
 		pts[i] = points[i] + ctx->renderer->viewportOffset;
 	}
 
-	ctx->renderer->cmdDrawPolyLine(pts.data(), pointCount, closed);
+	ctx->renderer->cmdDrawPolyLine(pts, pointCount, closed);
 }
 
 void drawCircle(const Point& center, f32 radius, u32 segments)
@@ -177,22 +175,21 @@ void drawCircle(const Point& center, f32 radius, u32 segments)
 
 void drawEllipse(const Point& center, f32 radiusX, f32 radiusY, u32 segments)
 {
-	std::vector<Point> pts;
+	auto pts = ctx->renderer->getFrameArena().allocate<Point>(segments);
 	Point pt;
 	f32 crtAngle = 0, step;
 
-	pts.reserve(segments);
 	step = 2 * M_PI / (f32)segments;
 
 	for (u32 i = 0; i < segments; i++)
 	{
 		pt.x = center.x + radiusX * sinf(crtAngle);
 		pt.y = center.y + radiusY * cosf(crtAngle);
-		pts.push_back(pt + ctx->renderer->viewportOffset);
+		pts[i] = pt + ctx->renderer->viewportOffset;
 		crtAngle += step;
 	}
 
-	ctx->renderer->cmdDrawPolyLine(pts.data(), pts.size(), true);
+	ctx->renderer->cmdDrawPolyLine(pts, segments, true);
 }
 
 void drawRectangle(const Rect& rc)
@@ -218,6 +215,11 @@ void drawSolidRectangle(const Rect& rc)
 		});
 }
 
+void drawShape(const Shape& shape, const Rect& rect)
+{
+	ctx->renderer->cmdDrawShape(shape, rect + ctx->renderer->viewportOffset, ctx->globalScale);
+}
+
 #define HORUS_HERMITE_TANGENT(a, b, c, tt, cc, bb, adj)\
 		(((b - a) * (1.0f + bb) * (1.0f - cc) + (c - b)\
 		* (1.0f - bb) * (1.0f + cc)) * (1.0f - tt) * adj)
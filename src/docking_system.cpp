@@ -199,7 +199,19 @@ void dockingSystemLoop()
 		t2 = high_resolution_clock::now();
 		total = t2 - t1;
 
-		printf("%fms\n", total.count());
+		auto& stats = getFrameStats();
+
+		printf("%fms (last window: build %fms, damage %fms, tessellate %fms, merge %fms, upload %fms, submit %fms, %u commands, %u/%u batches)\n",
+			total.count(),
+			stats.phaseTime[(u32)FramePhase::WidgetBuild],
+			stats.phaseTime[(u32)FramePhase::Damage],
+			stats.phaseTime[(u32)FramePhase::Tessellate],
+			stats.phaseTime[(u32)FramePhase::Merge],
+			stats.phaseTime[(u32)FramePhase::Upload],
+			stats.phaseTime[(u32)FramePhase::Submit],
+			stats.drawCommandCount,
+			stats.drawnBatchCount,
+			stats.generatedBatchCount);
 #endif
 	}
 }
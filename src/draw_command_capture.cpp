@@ -0,0 +1,666 @@
+#include "draw_command_capture.h"
+#include "ui_atlas.h"
+#include "ui_font.h"
+#include "ui_context.h"
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace hui
+{
+static const u32 captureFileMagic = 0x43434448; // "HDCC"
+static const u32 captureFileVersion = 4;
+static const u32 invalidCaptureIndex = ~0;
+
+struct CaptureFileHeader
+{
+	u32 magic = captureFileMagic;
+	u32 version = captureFileVersion;
+	Point windowSize;
+	u32 commandCount = 0;
+	u32 commandDataSize = 0;
+	u32 payloadDataSize = 0;
+	u32 textCount = 0;
+	u32 atlasCount = 0;
+	u32 imageCount = 0;
+	u32 fontCount = 0;
+	u32 textStyleCount = 0;
+	u32 lineStyleCount = 0;
+	u32 fillStyleCount = 0;
+	u32 color = 0;
+	u32 fontIndex = invalidCaptureIndex;
+	Rect clipRect;
+	TextStyle textStyle;
+	LineStyle lineStyle;
+	FillStyle fillStyle;
+};
+
+struct CaptureFileAtlas
+{
+	u32 width = 0;
+	u32 height = 0;
+	u32 textureCount = 0;
+};
+
+struct CaptureFileImage
+{
+	u32 id = 0;
+	u32 atlasIndex = 0;
+	u32 textureIndex = 0;
+	u32 rotated = 0;
+	Rect uvRect;
+	Rect rect;
+};
+
+struct CaptureFileFont
+{
+	u32 atlasIndex = 0;
+	u32 faceSize = 0;
+	u32 filenameSize = 0;
+};
+
+// the pointers in the captured commands are replaced with indices in the file's tables and payload data
+template<typename T>
+static void setCaptureIndex(T*& ptr, u32 index)
+{
+	ptr = (T*)(uintptr_t)index;
+}
+
+template<typename T>
+static u32 getCaptureIndex(T* ptr)
+{
+	return (u32)(uintptr_t)ptr;
+}
+
+// \return the smallest size a command of the given type can have, so a corrupt file cannot make the payload reads go past the command data
+static u32 getCaptureCommandSize(DrawCommand::Type type)
+{
+	switch (type)
+	{
+	case DrawCommand::Type::DrawRect: return DrawCommand::getSize<DrawCommand::CmdDrawRect>();
+	case DrawCommand::Type::DrawQuad: return DrawCommand::getSize<DrawCommand::CmdDrawQuad>();
+	case DrawCommand::Type::DrawImageBordered: return DrawCommand::getSize<DrawCommand::CmdDrawImageBordered>();
+	case DrawCommand::Type::DrawLine: return DrawCommand::getSize<DrawCommand::CmdDrawLine>();
+	case DrawCommand::Type::DrawPolyLine: return DrawCommand::getSize<DrawCommand::CmdDrawPolyLine>();
+	case DrawCommand::Type::DrawText: return DrawCommand::getSize<DrawCommand::CmdDrawText>();
+	case DrawCommand::Type::DrawInterpolatedColors: return DrawCommand::getSize<DrawCommand::CmdDrawInterpolatedColors>();
+	case DrawCommand::Type::DrawSpectrumColors: return DrawCommand::getSize<DrawCommand::CmdDrawSpectrumColors>();
+	case DrawCommand::Type::DrawSolidTriangle: return DrawCommand::getSize<DrawCommand::CmdDrawTriangle>();
+	case DrawCommand::Type::ClipRect: return DrawCommand::getSize<DrawCommand::CmdClipRect>();
+	case DrawCommand::Type::SetViewportOffset: return DrawCommand::getSize<DrawCommand::CmdSetViewportOffset>();
+	case DrawCommand::Type::SetAtlas: return DrawCommand::getSize<DrawCommand::CmdSetAtlas>();
+	case DrawCommand::Type::SetColor: return DrawCommand::getSize<DrawCommand::CmdSetColor>();
+	case DrawCommand::Type::SetFont: return DrawCommand::getSize<DrawCommand::CmdSetFont>();
+	case DrawCommand::Type::SetTextStyle:
+	case DrawCommand::Type::SetLineStyle:
+	case DrawCommand::Type::SetFillStyle: return DrawCommand::getSize<DrawCommand::CmdSetStyle>();
+	case DrawCommand::Type::BeginCachedLayer:
+	case DrawCommand::Type::EndCachedLayer: return DrawCommand::getSize<DrawCommand::CmdCachedLayer>();
+	case DrawCommand::Type::DrawShape: return DrawCommand::getSize<DrawCommand::CmdDrawShape>();
+	default: return sizeof(DrawCommand::Header);
+	}
+}
+
+static u32 appendPayload(std::vector<u8>& payloadData, const void* data, size_t size)
+{
+	u32 offset = (payloadData.size() + 7) & ~7;
+
+	payloadData.resize(offset + size);
+	memcpy(payloadData.data() + offset, data, size);
+
+	return offset;
+}
+
+bool writeDrawCommandCaptureFile(
+	const char* filename,
+	DrawCommandBuffer& commands,
+	const std::vector<u32>& commandOrder,
+	const DrawCommandCaptureState& state,
+	const Point& windowSize)
+{
+	std::unordered_map<UiAtlas*, u32> atlasIndices;
+	std::unordered_map<UiImage*, u32> imageIndices;
+	std::unordered_map<UiFont*, u32> fontIndices;
+	std::vector<UiAtlas*> atlases;
+	std::vector<UiImage*> images;
+	std::vector<UiFont*> fonts;
+	std::vector<u8> commandData;
+	std::vector<u8> payloadData;
+	CaptureFileHeader header;
+
+	auto getAtlasIndex = [&](UiAtlas* atlas)
+	{
+		if (!atlas)
+			return invalidCaptureIndex;
+
+		auto iter = atlasIndices.find(atlas);
+
+		if (iter != atlasIndices.end())
+			return iter->second;
+
+		atlases.push_back(atlas);
+		atlasIndices[atlas] = atlases.size() - 1;
+
+		return (u32)atlases.size() - 1;
+	};
+
+	auto getImageIndex = [&](UiImage* image)
+	{
+		if (!image)
+			return invalidCaptureIndex;
+
+		auto iter = imageIndices.find(image);
+
+		if (iter != imageIndices.end())
+			return iter->second;
+
+		getAtlasIndex(image->atlas);
+		images.push_back(image);
+		imageIndices[image] = images.size() - 1;
+
+		return (u32)images.size() - 1;
+	};
+
+	auto getFontIndex = [&](UiFont* font)
+	{
+		if (!font)
+			return invalidCaptureIndex;
+
+		auto iter = fontIndices.find(font);
+
+		if (iter != fontIndices.end())
+			return iter->second;
+
+		getAtlasIndex(font->atlas);
+		fonts.push_back(font);
+		fontIndices[font] = fonts.size() - 1;
+
+		return (u32)fonts.size() - 1;
+	};
+
+	for (auto offset : commandOrder)
+	{
+		auto srcHeader = commands.getHeader(offset);
+		u32 newOffset = commandData.size();
+
+		commandData.resize(newOffset + srcHeader->size);
+		memcpy(commandData.data() + newOffset, srcHeader, srcHeader->size);
+
+		auto cmdHeader = (DrawCommand::Header*)(commandData.data() + newOffset);
+
+		switch (cmdHeader->type)
+		{
+		case DrawCommand::Type::DrawQuad:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawQuad>(cmdHeader);
+			setCaptureIndex(cmd.image, getImageIndex(cmd.image));
+			break;
+		}
+		case DrawCommand::Type::DrawSolidTriangle:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawTriangle>(cmdHeader);
+			setCaptureIndex(cmd.image, getImageIndex(cmd.image));
+			break;
+		}
+		case DrawCommand::Type::DrawImageBordered:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawImageBordered>(cmdHeader);
+			setCaptureIndex(cmd.image, getImageIndex(cmd.image));
+			break;
+		}
+		case DrawCommand::Type::SetAtlas:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdSetAtlas>(cmdHeader);
+			setCaptureIndex(cmd.atlas, getAtlasIndex(cmd.atlas));
+			break;
+		}
+		case DrawCommand::Type::SetFont:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdSetFont>(cmdHeader);
+			setCaptureIndex(cmd.font, getFontIndex(cmd.font));
+			break;
+		}
+		case DrawCommand::Type::DrawPolyLine:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawPolyLine>(cmdHeader);
+			setCaptureIndex(cmd.points, appendPayload(payloadData, cmd.points, cmd.count * sizeof(Point)));
+			break;
+		}
+		case DrawCommand::Type::DrawText:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawText>(cmdHeader);
+
+			setCaptureIndex(cmd.text, appendPayload(payloadData, cmd.text, strlen(cmd.text) + 1));
+
+			if (cmd.unicodeText)
+			{
+				// the glyph count, followed by the glyph codes
+				u32 glyphCount = cmd.unicodeText->size();
+				u32 textOffset = appendPayload(payloadData, &glyphCount, sizeof(glyphCount));
+				auto glyphs = (const u8*)cmd.unicodeText->data();
+
+				payloadData.insert(payloadData.end(), glyphs, glyphs + glyphCount * sizeof(GlyphCode));
+				setCaptureIndex(cmd.unicodeText, textOffset);
+				header.textCount++;
+			}
+			else
+			{
+				setCaptureIndex(cmd.unicodeText, invalidCaptureIndex);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	header.windowSize = windowSize;
+	header.commandCount = commandOrder.size();
+	header.commandDataSize = commandData.size();
+	header.payloadDataSize = payloadData.size();
+	header.textStyleCount = commands.textStyles.size();
+	header.lineStyleCount = commands.lineStyles.size();
+	header.fillStyleCount = commands.fillStyles.size();
+	header.color = state.color;
+	header.fontIndex = getFontIndex(state.font);
+	header.clipRect = state.clipRect;
+	header.textStyle = state.textStyle;
+	header.lineStyle = state.lineStyle;
+	header.fillStyle = state.fillStyle;
+	header.atlasCount = atlases.size();
+	header.imageCount = images.size();
+	header.fontCount = fonts.size();
+
+	FILE* file = fopen(filename, "wb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	fwrite(&header, sizeof(header), 1, file);
+
+	for (auto atlas : atlases)
+	{
+		CaptureFileAtlas fileAtlas;
+
+		fileAtlas.width = atlas->textureArray->getWidth();
+		fileAtlas.height = atlas->textureArray->getHeight();
+		fileAtlas.textureCount = atlas->textureArray->getCount();
+		fwrite(&fileAtlas, sizeof(fileAtlas), 1, file);
+	}
+
+	for (auto image : images)
+	{
+		CaptureFileImage fileImage;
+
+		fileImage.id = image->id;
+		fileImage.atlasIndex = atlasIndices[image->atlas];
+		fileImage.textureIndex = image->atlasTexture ? image->atlasTexture->textureIndex : 0;
+		fileImage.rotated = image->rotated;
+		fileImage.uvRect = image->uvRect;
+		fileImage.rect = image->rect;
+		fwrite(&fileImage, sizeof(fileImage), 1, file);
+	}
+
+	for (auto font : fonts)
+	{
+		CaptureFileFont fileFont;
+
+		fileFont.atlasIndex = atlasIndices[font->atlas];
+		fileFont.faceSize = font->getFaceSize();
+		fileFont.filenameSize = font->getFilename().size();
+		fwrite(&fileFont, sizeof(fileFont), 1, file);
+		fwrite(font->getFilename().data(), fileFont.filenameSize, 1, file);
+	}
+
+	fwrite(commands.textStyles.data(), sizeof(TextStyle), commands.textStyles.size(), file);
+	fwrite(commands.lineStyles.data(), sizeof(LineStyle), commands.lineStyles.size(), file);
+	fwrite(commands.fillStyles.data(), sizeof(FillStyle), commands.fillStyles.size(), file);
+	fwrite(commandData.data(), 1, commandData.size(), file);
+	fwrite(payloadData.data(), 1, payloadData.size(), file);
+
+	bool ok = !ferror(file);
+
+	fclose(file);
+
+	return ok;
+}
+
+DrawCommandCaptureData::~DrawCommandCaptureData()
+{
+	for (auto font : fonts)
+	{
+		delete font;
+	}
+
+	for (auto image : images)
+	{
+		delete image;
+	}
+
+	for (auto atlasTexture : atlasTextures)
+	{
+		delete atlasTexture;
+	}
+
+	for (auto atlas : atlases)
+	{
+		delete atlas;
+	}
+}
+
+template<typename T>
+static bool readCaptureData(FILE* file, T* data, size_t count)
+{
+	return !count || fread(data, sizeof(T), count, file) == count;
+}
+
+DrawCommandCaptureData* readDrawCommandCaptureFile(const char* filename, const char* fontFolder)
+{
+	FILE* file = fopen(filename, "rb");
+
+	if (!file)
+	{
+		return nullptr;
+	}
+
+	CaptureFileHeader header;
+	std::vector<CaptureFileAtlas> fileAtlases;
+	std::vector<CaptureFileImage> fileImages;
+	auto capture = new DrawCommandCaptureData();
+
+	auto fail = [&]()
+	{
+		fclose(file);
+		delete capture;
+
+		return nullptr;
+	};
+
+	if (!readCaptureData(file, &header, 1)
+		|| header.magic != captureFileMagic
+		|| header.version != captureFileVersion)
+	{
+		return fail();
+	}
+
+	fileAtlases.resize(header.atlasCount);
+	fileImages.resize(header.imageCount);
+
+	if (!readCaptureData(file, fileAtlases.data(), fileAtlases.size())
+		|| !readCaptureData(file, fileImages.data(), fileImages.size()))
+	{
+		return fail();
+	}
+
+	// the atlases only get a white image, the captured images keep their rects but not their pixels
+	for (auto& fileAtlas : fileAtlases)
+	{
+		auto atlas = new UiAtlas(fileAtlas.width, fileAtlas.height);
+
+		atlas->addWhiteImage();
+		atlas->pack();
+		capture->atlases.push_back(atlas);
+	}
+
+	std::unordered_map<u64, AtlasTexture*> atlasTextures;
+
+	for (auto& fileImage : fileImages)
+	{
+		if (fileImage.atlasIndex >= capture->atlases.size())
+		{
+			return fail();
+		}
+
+		auto image = new UiImage();
+		auto atlas = capture->atlases[fileImage.atlasIndex];
+		u64 atlasTextureKey = ((u64)fileImage.atlasIndex << 32) | fileImage.textureIndex;
+		auto& atlasTexture = atlasTextures[atlasTextureKey];
+
+		if (!atlasTexture)
+		{
+			atlasTexture = new AtlasTexture();
+			atlasTexture->textureArray = atlas->textureArray;
+			atlasTexture->textureIndex = fileImage.textureIndex;
+			capture->atlasTextures.push_back(atlasTexture);
+		}
+
+		image->id = fileImage.id;
+		image->atlas = atlas;
+		image->atlasTexture = atlasTexture;
+		image->rotated = fileImage.rotated;
+		image->uvRect = fileImage.uvRect;
+		image->rect = fileImage.rect;
+		image->width = fileImage.rect.width;
+		image->height = fileImage.rect.height;
+		capture->images.push_back(image);
+	}
+
+	for (u32 i = 0; i < header.fontCount; i++)
+	{
+		CaptureFileFont fileFont;
+		std::string fontFilename;
+
+		if (!readCaptureData(file, &fileFont, 1)
+			|| fileFont.atlasIndex >= capture->atlases.size())
+		{
+			return fail();
+		}
+
+		fontFilename.resize(fileFont.filenameSize);
+
+		if (!readCaptureData(file, &fontFilename[0], fontFilename.size()))
+		{
+			return fail();
+		}
+
+		if (fontFolder)
+		{
+			auto pos = fontFilename.find_last_of("/\\");
+
+			fontFilename = std::string(fontFolder) + "/" + (pos == std::string::npos ? fontFilename : fontFilename.substr(pos + 1));
+		}
+
+		capture->fonts.push_back(new UiFont(fontFilename, fileFont.faceSize, capture->atlases[fileFont.atlasIndex]));
+	}
+
+	auto& commands = capture->commands;
+
+	commands.textStyles.resize(header.textStyleCount);
+	commands.lineStyles.resize(header.lineStyleCount);
+	commands.fillStyles.resize(header.fillStyleCount);
+	commands.data.resize(header.commandDataSize);
+	capture->payloadData.resize(header.payloadDataSize);
+
+	if (!readCaptureData(file, commands.textStyles.data(), commands.textStyles.size())
+		|| !readCaptureData(file, commands.lineStyles.data(), commands.lineStyles.size())
+		|| !readCaptureData(file, commands.fillStyles.data(), commands.fillStyles.size())
+		|| !readCaptureData(file, commands.data.data(), commands.data.size())
+		|| !readCaptureData(file, capture->payloadData.data(), capture->payloadData.size()))
+	{
+		return fail();
+	}
+
+	fclose(file);
+
+	// the fill style textures are graphics API handles of the recording process
+	for (auto& style : commands.fillStyles)
+	{
+		style.texture = nullptr;
+	}
+
+	auto getImage = [&](UiImage* index)
+	{
+		u32 i = getCaptureIndex(index);
+		return i < capture->images.size() ? capture->images[i] : nullptr;
+	};
+
+	auto getPayload = [&](u32 offset, size_t size) -> u8*
+	{
+		return (u64)offset + size <= capture->payloadData.size() ? capture->payloadData.data() + offset : nullptr;
+	};
+
+	// the text must end inside the payload data, it's used as a C string
+	auto getPayloadText = [&](u32 offset) -> char*
+	{
+		if (offset >= capture->payloadData.size())
+			return nullptr;
+
+		char* text = (char*)capture->payloadData.data() + offset;
+
+		return memchr(text, 0, capture->payloadData.size() - offset) ? text : nullptr;
+	};
+
+	commands.layers.resize(1);
+	capture->texts.reserve(header.textCount);
+
+	auto& layer = commands.layers[0];
+	u32 offset = 0;
+
+	layer.entries.reserve(header.commandCount);
+
+	while (offset + sizeof(DrawCommand::Header) <= commands.data.size())
+	{
+		auto cmdHeader = commands.getHeader(offset);
+
+		if (cmdHeader->type >= DrawCommand::Type::Count
+			|| cmdHeader->size < getCaptureCommandSize(cmdHeader->type)
+			|| cmdHeader->size % DrawCommand::alignment
+			|| offset + cmdHeader->size > commands.data.size())
+		{
+			delete capture;
+			return nullptr;
+		}
+
+		switch (cmdHeader->type)
+		{
+		case DrawCommand::Type::DrawQuad:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawQuad>(cmdHeader);
+			cmd.image = getImage(cmd.image);
+
+			if (!cmd.image)
+				cmdHeader->type = DrawCommand::Type::None;
+			break;
+		}
+		case DrawCommand::Type::DrawSolidTriangle:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawTriangle>(cmdHeader);
+			cmd.image = getImage(cmd.image);
+
+			if (!cmd.image)
+				cmdHeader->type = DrawCommand::Type::None;
+			break;
+		}
+		case DrawCommand::Type::DrawImageBordered:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawImageBordered>(cmdHeader);
+			cmd.image = getImage(cmd.image);
+
+			if (!cmd.image)
+				cmdHeader->type = DrawCommand::Type::None;
+			break;
+		}
+		case DrawCommand::Type::SetAtlas:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdSetAtlas>(cmdHeader);
+			u32 i = getCaptureIndex(cmd.atlas);
+			cmd.atlas = i < capture->atlases.size() ? capture->atlases[i] : nullptr;
+			break;
+		}
+		case DrawCommand::Type::SetFont:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdSetFont>(cmdHeader);
+			u32 i = getCaptureIndex(cmd.font);
+			cmd.font = i < capture->fonts.size() ? capture->fonts[i] : nullptr;
+			break;
+		}
+		case DrawCommand::Type::SetTextStyle:
+		case DrawCommand::Type::SetLineStyle:
+		case DrawCommand::Type::SetFillStyle:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdSetStyle>(cmdHeader);
+			size_t styleCount =
+				cmdHeader->type == DrawCommand::Type::SetTextStyle ? commands.textStyles.size()
+				: cmdHeader->type == DrawCommand::Type::SetLineStyle ? commands.lineStyles.size()
+				: commands.fillStyles.size();
+
+			if (cmd.styleIndex >= styleCount)
+				cmdHeader->type = DrawCommand::Type::None;
+			break;
+		}
+		case DrawCommand::Type::ClipRect:
+		{
+			// the clip rect table is rebuilt, in the captured execution order
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdClipRect>(cmdHeader);
+			cmd.index = commands.addClipRect(cmd.rect);
+			break;
+		}
+		case DrawCommand::Type::DrawShape:
+		{
+			// the shape table is rebuilt too
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawShape>(cmdHeader);
+			cmd.index = commands.addShape(cmd.shape);
+			break;
+		}
+		case DrawCommand::Type::DrawPolyLine:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawPolyLine>(cmdHeader);
+			cmd.points = (Point*)getPayload(getCaptureIndex(cmd.points), cmd.count * sizeof(Point));
+
+			if (!cmd.points)
+				cmd.count = 0;
+			break;
+		}
+		case DrawCommand::Type::DrawText:
+		{
+			auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawText>(cmdHeader);
+			u32 textOffset = getCaptureIndex(cmd.unicodeText);
+			u8* glyphCountData = getPayload(textOffset, sizeof(u32));
+
+			cmd.text = getPayloadText(getCaptureIndex(cmd.text));
+			cmd.unicodeText = nullptr;
+
+			if (!cmd.text)
+			{
+				cmdHeader->type = DrawCommand::Type::None;
+				break;
+			}
+
+			// the texts were reserved, so the pointers to them stay valid
+			if (glyphCountData && capture->texts.size() < header.textCount)
+			{
+				u32 glyphCount = *(u32*)glyphCountData;
+				auto glyphs = (GlyphCode*)getPayload(textOffset + sizeof(u32), glyphCount * sizeof(GlyphCode));
+
+				if (glyphs)
+				{
+					capture->texts.emplace_back(glyphs, glyphs + glyphCount);
+					cmd.unicodeText = &capture->texts.back();
+				}
+			}
+			break;
+		}
+		default:
+			break;
+		}
+
+		layer.entries.push_back(offset);
+		offset += cmdHeader->size;
+	}
+
+	commands.commandCount = layer.entries.size();
+	capture->windowSize = header.windowSize;
+	capture->state.color = header.color;
+	capture->state.font = header.fontIndex < capture->fonts.size() ? capture->fonts[header.fontIndex] : nullptr;
+	capture->state.clipRect = header.clipRect;
+	capture->state.textStyle = header.textStyle;
+	capture->state.lineStyle = header.lineStyle;
+	capture->state.fillStyle = header.fillStyle;
+	capture->state.fillStyle.texture = nullptr;
+
+	return capture;
+}
+
+}
\ No newline at end of file
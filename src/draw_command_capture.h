@@ -0,0 +1,59 @@
+#pragma once
+#include "types.h"
+#include "renderer.h"
+
+namespace hui
+{
+class UiFont;
+class UiAtlas;
+struct UiImage;
+struct AtlasTexture;
+
+/// The renderer state the captured commands start executing with, left by the recording
+struct DrawCommandCaptureState
+{
+	u32 color = 0;
+	UiFont* font = nullptr;
+	Rect clipRect;
+	TextStyle textStyle;
+	LineStyle lineStyle;
+	FillStyle fillStyle;
+};
+
+/// A loaded draw command capture, its commands point to the atlases, images and fonts recreated from the file
+struct DrawCommandCaptureData
+{
+	~DrawCommandCaptureData();
+
+	Point windowSize;
+	DrawCommandCaptureState state;
+	DrawCommandBuffer commands; /// a single layer, with the commands in the captured execution order
+	std::vector<u8> payloadData; /// the texts and points the commands point to
+	std::vector<UnicodeString> texts;
+	std::vector<UiAtlas*> atlases;
+	std::vector<AtlasTexture*> atlasTextures;
+	std::vector<UiImage*> images;
+	std::vector<UiFont*> fonts;
+};
+
+/// Write the commands to a capture file, with the atlases, images, fonts, texts and points they reference
+/// \param filename the capture filename
+/// \param commands the recorded commands
+/// \param commandOrder the command offsets, in execution order
+/// \param state the renderer state the commands start executing with
+/// \param windowSize the size of the window the commands were recorded in
+/// \return true if the file was written
+bool writeDrawCommandCaptureFile(
+	const char* filename,
+	DrawCommandBuffer& commands,
+	const std::vector<u32>& commandOrder,
+	const DrawCommandCaptureState& state,
+	const Point& windowSize);
+
+/// Read a capture file, recreating the atlases, images and fonts its commands use
+/// \param filename the capture filename
+/// \param fontFolder if not null, the fonts are loaded from this folder instead of their captured paths
+/// \return the capture, null if the file cannot be read or is invalid
+DrawCommandCaptureData* readDrawCommandCaptureFile(const char* filename, const char* fontFolder);
+
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "font_cache.h"
 #include "ui_atlas.h"
+#include "ui_context.h"
 
 namespace hui
 {
@@ -28,9 +29,33 @@ UiFont* FontCache::createFont(const std::string& name, const std::string& filena
 
 
 	CachedFontInfo* newFont = new CachedFontInfo();
+	CachedFontInfo* glyphSource = nullptr;
 
-	newFont->font.load(filename, size, atlas);
-	newFont->font.precacheLatinAlphabetGlyphs();
+	// the distance field fonts of the same face share their glyphs, they're only scaled differently
+	if (ctx && ctx->settings.distanceFieldGlyphs)
+	{
+		for (auto fnt : cachedFonts)
+		{
+			if (fnt.second->filename == filename
+				&& fnt.first->isDistanceField()
+				&& !fnt.first->getGlyphSource())
+			{
+				glyphSource = fnt.second;
+				break;
+			}
+		}
+	}
+
+	if (glyphSource)
+	{
+		glyphSource->usageCount++;
+		newFont->font.load(&glyphSource->font, size);
+	}
+	else
+	{
+		newFont->font.load(filename, size, atlas);
+		newFont->font.precacheLatinAlphabetGlyphs();
+	}
 	newFont->size = size;
 	newFont->usageCount = 1;
 	newFont->filename = filename;
@@ -56,8 +81,16 @@ void FontCache::releaseFont(UiFont* font)
 
 	if (!iter->second->usageCount)
 	{
+		UiFont* glyphSource = font->getGlyphSource();
+
 		delete iter->second;
 		cachedFonts.erase(iter);
+
+		// the font was holding a usage of the font it shared the glyphs from
+		if (glyphSource)
+		{
+			releaseFont(glyphSource);
+		}
 	}
 }
 
@@ -71,11 +104,24 @@ void FontCache::deleteFonts()
 	cachedFonts.clear();
 }
 
-void FontCache::rescaleFonts(f32 scale)
+bool FontCache::rescaleFonts(f32 scale)
 {
+	bool glyphsChanged = false;
+
 	for (auto& font : cachedFonts)
 	{
 		font.second->font.resetFaceSize(font.second->size * scale);
+		glyphsChanged |= !font.second->font.isDistanceField();
+	}
+
+	return glyphsChanged;
+}
+
+void FontCache::pruneUnusedGlyphRuns(u32 maxUnusedFrames)
+{
+	for (auto& font : cachedFonts)
+	{
+		font.second->font.pruneUnusedGlyphRuns(maxUnusedFrames);
 	}
 }
 
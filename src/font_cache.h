@@ -12,7 +12,11 @@ public:
 	UiFont* createFont(const std::string& name, const std::string& filename, u32 size, bool packAtlasNow);
 	void releaseFont(UiFont* font);
 	void deleteFonts();
-	void rescaleFonts(f32 scale);
+	/// Change the fonts' face sizes
+	/// \param scale the scale of the sizes they were created with
+	/// \return true if bitmap glyphs were rasterized again, so the atlas must be repacked
+	bool rescaleFonts(f32 scale);
+	void pruneUnusedGlyphRuns(u32 maxUnusedFrames);
 
 protected:
 	struct CachedFontInfo
@@ -12,6 +12,7 @@
 #include "renderer.h"
 #include "unicode_text_cache.h"
 #include "font_cache.h"
+#include "draw_command_capture.h"
 #include "libs/jsoncpp/include/json/json.h"
 #include "libs/jsoncpp/include/json/reader.h"
 #include <algorithm>
@@ -298,6 +299,11 @@ void beginFrame()
 	{
 		ctx->textCache->pruneUnusedTexts();
 		ctx->pruneUnusedTextTime = 0;
+
+		if (ctx->theme)
+		{
+			ctx->theme->fontCache->pruneUnusedGlyphRuns(ctx->settings.glyphRunCachePruneMaxFrames);
+		}
 	}
 }
 
@@ -396,6 +402,41 @@ void skipThisFrame()
 	ctx->setSkipRenderAndInput(true);
 }
 
+const FrameStats& getFrameStats()
+{
+	return ctx->renderer->getLastFrameStats();
+}
+
+FramePhaseTiming getFramePhaseTiming(FramePhase phase)
+{
+	return ctx->renderer->getFramePhaseTiming(phase);
+}
+
+void captureNextFrameDrawCommands(const char* filename)
+{
+	ctx->renderer->captureNextFrame(filename);
+}
+
+DrawCommandCapture loadDrawCommandCapture(const char* filename, const char* fontFolder)
+{
+	return readDrawCommandCaptureFile(filename, fontFolder);
+}
+
+void replayDrawCommandCapture(DrawCommandCapture capture)
+{
+	ctx->renderer->replayCapture((DrawCommandCaptureData*)capture);
+}
+
+Point getDrawCommandCaptureWindowSize(DrawCommandCapture capture)
+{
+	return ((DrawCommandCaptureData*)capture)->windowSize;
+}
+
+void deleteDrawCommandCapture(DrawCommandCapture capture)
+{
+	delete (DrawCommandCaptureData*)capture;
+}
+
 bool copyToClipboard(const char* text)
 {
 	return ctx->inputProvider->copyToClipboard(text);
@@ -515,11 +556,21 @@ Rect getWindowClientRect(Window window)
 
 void presentWindow(Window window)
 {
+	auto rects = ctx->settings.partialRedraw ? ctx->renderer->findDamageRects(window) : nullptr;
+
+	// a window not rendered yet has no damage computed, so it's presented whole
+	if (rects)
+	{
+		ctx->inputProvider->presentWindowRects(window, rects->data(), rects->size());
+		return;
+	}
+
 	ctx->inputProvider->presentWindow(window);
 }
 
 void destroyWindow(Window window)
 {
+	ctx->renderer->removeWindowDamage(window);
 	ctx->inputProvider->destroyWindow(window);
 }
 
@@ -594,6 +645,25 @@ InputEvent getInputEventAt(u32 index)
 	return ctx->events[index];
 }
 
+u32 getDamageRectCount()
+{
+	auto rects = ctx->renderer->findDamageRects(getWindow());
+
+	return rects ? rects->size() : 0;
+}
+
+Rect getDamageRectAt(u32 index)
+{
+	auto rects = ctx->renderer->findDamageRects(getWindow());
+
+	if (!rects || index >= rects->size())
+	{
+		return Rect();
+	}
+
+	return (*rects)[index];
+}
+
 void setInputEvent(const InputEvent& event)
 {
 	ctx->event = event;
@@ -772,6 +842,13 @@ Image addThemeImage(Theme theme, const RawImage& img)
 	return themePtr->addImage((const Rgba32*)img.pixels, img.width, img.height);
 }
 
+Image addThemeShapeImage(Theme theme, const Shape& shape, u32 width, u32 height)
+{
+	UiTheme* themePtr = (UiTheme*)theme;
+
+	return themePtr->addShapeImage(shape, width, height);
+}
+
 void setWidgetStyle(WidgetType widgetType, const char* styleName)
 {
 	//TODO: more automatic correlation between widget type and its element types, to avoid manual switch
@@ -1230,6 +1307,37 @@ bool getColorFromText(const char* colorText, Color& color)
 	return getColorFromText(std::string(colorText), color);
 }
 
+/// Add a shape image to the theme, from a theme element state's shape, used instead of an image file
+Image addThemeShape(UiTheme* theme, const Json::Value& shapeJson, i32 width, i32 height)
+{
+	const f32 degreesToRadians = 3.14159265f / 180.0f;
+	auto type = shapeJson.get("type", "roundedRectangle").asString();
+	auto borderColor = shapeJson.get("borderColor", "white").asString();
+	Shape shape;
+
+	if (type == "circle")
+		shape.type = ShapeType::Circle;
+	else if (type == "ring")
+		shape.type = ShapeType::Ring;
+	else if (type == "arc")
+		shape.type = ShapeType::Arc;
+
+	shape.cornerRadius = shapeJson.get("cornerRadius", 0).asFloat();
+	shape.borderWidth = shapeJson.get("borderWidth", 0).asFloat();
+	shape.startAngle = shapeJson.get("startAngle", 0).asFloat() * degreesToRadians;
+	shape.endAngle = shapeJson.get("endAngle", 360).asFloat() * degreesToRadians;
+
+	if (!getColorFromText(borderColor, shape.borderColor))
+	{
+		u32 r = 0, g = 0, b = 0, a = 255;
+
+		sscanf(borderColor.c_str(), "%d,%d,%d,%d", &r, &g, &b, &a);
+		shape.borderColor = Color((f32)r / 255.0f, (f32)g / 255.0f, (f32)b / 255.0f, (f32)a / 255.0f);
+	}
+
+	return theme->addShapeImage(shape, std::max(width, 0), std::max(height, 0));
+}
+
 void setThemeElement(
 	UiTheme* theme,
 	const std::string& themePath,
@@ -1251,7 +1359,11 @@ void setThemeElement(
 	width = state.get("width", width).asInt();
 	height = state.get("height", height).asInt();
 
-	if (iter == theme->images.end())
+	if (state.isMember("shape"))
+	{
+		image = addThemeShape(theme, state["shape"], width, height);
+	}
+	else if (iter == theme->images.end())
 	{
 		auto rawImage = loadRawImage(imageFilename.c_str());
 		image = addThemeImage(theme, rawImage);
@@ -1318,7 +1430,11 @@ void setUserElement(
 	width = state.get("width", width).asInt();
 	height = state.get("height", height).asInt();
 
-	if (iter == theme->images.end())
+	if (state.isMember("shape"))
+	{
+		image = addThemeShape(theme, state["shape"], width, height);
+	}
+	else if (iter == theme->images.end())
 	{
 		auto rawImage = loadRawImage(imageFilename.c_str());
 		image = addThemeImage(theme, rawImage);
@@ -1601,6 +1717,39 @@ void endContainer()
 	ctx->scrollViewDepth = 0;
 }
 
+void beginCachedLayer(u64 key, const Rect& rect)
+{
+	auto type = ctx->event.type;
+	bool mouseEvent =
+		type == InputEvent::Type::MouseMove
+		|| type == InputEvent::Type::MouseDown
+		|| type == InputEvent::Type::MouseUp
+		|| type == InputEvent::Type::MouseWheel;
+
+	// the widgets inside may react to the mouse with changes not visible in their draw commands
+	if (mouseEvent && rect.contains(ctx->event.mouse.point))
+	{
+		ctx->renderer->invalidateCachedLayer(key);
+	}
+
+	ctx->renderer->beginCachedLayer(key, rect);
+}
+
+void endCachedLayer()
+{
+	ctx->renderer->endCachedLayer();
+}
+
+void invalidateCachedLayer(u64 key)
+{
+	ctx->renderer->invalidateCachedLayer(key);
+}
+
+bool isRectVisible(const Rect& rect)
+{
+	return ctx->renderer->isRectVisible(rect);
+}
+
 void pushWidgetLoop(u32 loopMaxCount)
 {
 	UiContext::WidgetLoopInfo li;
@@ -1977,8 +2126,11 @@ void setGlobalScale(f32 scale)
 
 	if (ctx->theme)
 	{
-		ctx->theme->fontCache->rescaleFonts(scale);
-		ctx->theme->atlas->repackImages();
+		// the distance field glyphs are only scaled, so the atlas is repacked only for the bitmap glyphs
+		if (ctx->theme->fontCache->rescaleFonts(scale))
+		{
+			ctx->theme->atlas->repackImages();
+		}
 	}
 }
 
@@ -0,0 +1,356 @@
+#include "quad_clipper.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+	#define HORUS_QUAD_CLIPPER_AVX2
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define HORUS_QUAD_CLIPPER_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace hui
+{
+// the SIMD path stores position and uv with a single 16 bytes store
+static_assert(sizeof(Vertex) == 24, "Vertex layout changed, update the quad clipper");
+static_assert(sizeof(Rect) == 16, "Rect layout changed, update the quad clipper");
+
+static inline void emitQuad(
+	f32 left, f32 top, f32 right, f32 bottom,
+	f32 u0, f32 v0, f32 u1, f32 v1,
+	u32 color, u32 textureIndex, u16 clipRectIndex, Vertex* v)
+{
+	v[0].position = { left, top };
+	v[0].uv = { u0, v0 };
+	v[1].position = { right, top };
+	v[1].uv = { u1, v0 };
+	v[2].position = { left, bottom };
+	v[2].uv = { u0, v1 };
+	v[3].position = { right, bottom };
+	v[3].uv = { u1, v1 };
+
+	for (u32 i = 0; i < 4; i++)
+	{
+		v[i].color = color;
+		v[i].textureIndex = textureIndex;
+		v[i].clipRectIndex = clipRectIndex;
+	}
+}
+
+// the math is kept the same as in the SIMD paths, so all paths output the same vertices
+static inline bool clipAndEmitQuad(
+	const Rect& rect, const Rect& uvRect, u32 textureIndex,
+	const Rect& clipRect, u32 color, Vertex* outVertices)
+{
+	f32 right = rect.x + rect.width;
+	f32 bottom = rect.y + rect.height;
+
+	if (rect.x > clipRect.right() || right < clipRect.x
+		|| rect.y > clipRect.bottom() || bottom < clipRect.y)
+	{
+		return false;
+	}
+
+	f32 newLeft = std::max(rect.x, clipRect.x);
+	f32 newTop = std::max(rect.y, clipRect.y);
+	f32 newRight = std::min(right, clipRect.right());
+	f32 newBottom = std::min(bottom, clipRect.bottom());
+
+	f32 invWidth = 1.0f / rect.width;
+	f32 invHeight = 1.0f / rect.height;
+	f32 tx = (newLeft - rect.x) * invWidth;
+	f32 ty = (newTop - rect.y) * invHeight;
+	f32 tx2 = (right - newRight) * invWidth;
+	f32 ty2 = (bottom - newBottom) * invHeight;
+
+	f32 u0 = uvRect.x + uvRect.width * tx;
+	f32 v0 = uvRect.y + uvRect.height * ty;
+	f32 u1 = u0 + (uvRect.width - uvRect.width * tx - uvRect.width * tx2);
+	f32 v1 = v0 + (uvRect.height - uvRect.height * ty - uvRect.height * ty2);
+
+	emitQuad(newLeft, newTop, newRight, newBottom, u0, v0, u1, v1, color, textureIndex, 0, outVertices);
+
+	return true;
+}
+
+u32 clipAndEmitQuadsScalar(
+	const Rect* rects, const Rect* uvRects, const u32* textureIndices, u32 count,
+	const Rect& clipRect, u32 color, Vertex* outVertices)
+{
+	u32 quadCount = 0;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		if (clipAndEmitQuad(rects[i], uvRects[i], textureIndices[i], clipRect, color, outVertices + quadCount * 4))
+		{
+			quadCount++;
+		}
+	}
+
+	return quadCount;
+}
+
+u32 emitQuads(
+	const Rect* rects, const Rect* uvRects, const u32* textureIndices, u32 count,
+	u16 clipRectIndex, u32 color, Vertex* outVertices)
+{
+	for (u32 i = 0; i < count; i++)
+	{
+		const Rect& rect = rects[i];
+		const Rect& uvRect = uvRects[i];
+
+		emitQuad(
+			rect.x, rect.y, rect.x + rect.width, rect.y + rect.height,
+			uvRect.x, uvRect.y, uvRect.x + uvRect.width, uvRect.y + uvRect.height,
+			color, textureIndices[i], clipRectIndex, outVertices + i * 4);
+	}
+
+	return count;
+}
+
+#if defined(HORUS_QUAD_CLIPPER_SSE2) || defined(HORUS_QUAD_CLIPPER_AVX2)
+
+/// Four clipped quads, one per lane
+struct ClippedQuads4
+{
+	__m128 left, top, right, bottom;
+	__m128 u0, v0, u1, v1;
+	int visibleMask;
+};
+
+static inline void loadQuads4(const Rect* rects, __m128& x, __m128& y, __m128& width, __m128& height)
+{
+	x = _mm_loadu_ps(&rects[0].x);
+	y = _mm_loadu_ps(&rects[1].x);
+	width = _mm_loadu_ps(&rects[2].x);
+	height = _mm_loadu_ps(&rects[3].x);
+	_MM_TRANSPOSE4_PS(x, y, width, height);
+}
+
+static inline u32 emitQuads4(
+	const ClippedQuads4& quads, const u32* textureIndices, u32 color, Vertex* outVertices)
+{
+	// transpose back to one position+uv vector per vertex
+	__m128 tl0 = quads.left, tl1 = quads.top, tl2 = quads.u0, tl3 = quads.v0;
+	__m128 tr0 = quads.right, tr1 = quads.top, tr2 = quads.u1, tr3 = quads.v0;
+	__m128 bl0 = quads.left, bl1 = quads.bottom, bl2 = quads.u0, bl3 = quads.v1;
+	__m128 br0 = quads.right, br1 = quads.bottom, br2 = quads.u1, br3 = quads.v1;
+
+	_MM_TRANSPOSE4_PS(tl0, tl1, tl2, tl3);
+	_MM_TRANSPOSE4_PS(tr0, tr1, tr2, tr3);
+	_MM_TRANSPOSE4_PS(bl0, bl1, bl2, bl3);
+	_MM_TRANSPOSE4_PS(br0, br1, br2, br3);
+
+	// the texture index and the zero clip rect index are stored together with the color,
+	// every lane is written at the current output slot, which only advances for the visible ones,
+	// so the hidden quads are overwritten without branching, the slot is never past the lane index
+	u32 quadCount = 0;
+
+#define HORUS_EMIT_QUAD_LANE(lane)\
+	{\
+		Vertex* v = outVertices + quadCount * 4;\
+		__m128i colorAndTexture = _mm_set_epi32(0, 0, textureIndices[lane] & 0xFFFF, color);\
+		_mm_storeu_ps(&v[0].position.x, tl##lane);\
+		_mm_storel_epi64((__m128i*)&v[0].color, colorAndTexture);\
+		_mm_storeu_ps(&v[1].position.x, tr##lane);\
+		_mm_storel_epi64((__m128i*)&v[1].color, colorAndTexture);\
+		_mm_storeu_ps(&v[2].position.x, bl##lane);\
+		_mm_storel_epi64((__m128i*)&v[2].color, colorAndTexture);\
+		_mm_storeu_ps(&v[3].position.x, br##lane);\
+		_mm_storel_epi64((__m128i*)&v[3].color, colorAndTexture);\
+		quadCount += (quads.visibleMask >> lane) & 1;\
+	}
+
+	HORUS_EMIT_QUAD_LANE(0)
+	HORUS_EMIT_QUAD_LANE(1)
+	HORUS_EMIT_QUAD_LANE(2)
+	HORUS_EMIT_QUAD_LANE(3)
+
+#undef HORUS_EMIT_QUAD_LANE
+
+	return quadCount;
+}
+
+static inline void clipQuads4(
+	const Rect* rects, const Rect* uvRects,
+	__m128 clipLeft, __m128 clipTop, __m128 clipRight, __m128 clipBottom,
+	ClippedQuads4& out)
+{
+	__m128 x, y, width, height;
+	__m128 u, v, uvWidth, uvHeight;
+
+	loadQuads4(rects, x, y, width, height);
+	loadQuads4(uvRects, u, v, uvWidth, uvHeight);
+
+	__m128 right = _mm_add_ps(x, width);
+	__m128 bottom = _mm_add_ps(y, height);
+	__m128 outside = _mm_or_ps(
+		_mm_or_ps(_mm_cmpgt_ps(x, clipRight), _mm_cmplt_ps(right, clipLeft)),
+		_mm_or_ps(_mm_cmpgt_ps(y, clipBottom), _mm_cmplt_ps(bottom, clipTop)));
+
+	out.visibleMask = ~_mm_movemask_ps(outside) & 0xF;
+
+	if (!out.visibleMask)
+	{
+		return;
+	}
+
+	out.left = _mm_max_ps(x, clipLeft);
+	out.top = _mm_max_ps(y, clipTop);
+	out.right = _mm_min_ps(right, clipRight);
+	out.bottom = _mm_min_ps(bottom, clipBottom);
+
+	__m128 invWidth = _mm_div_ps(_mm_set1_ps(1.0f), width);
+	__m128 invHeight = _mm_div_ps(_mm_set1_ps(1.0f), height);
+	__m128 tx = _mm_mul_ps(_mm_sub_ps(out.left, x), invWidth);
+	__m128 ty = _mm_mul_ps(_mm_sub_ps(out.top, y), invHeight);
+	__m128 tx2 = _mm_mul_ps(_mm_sub_ps(right, out.right), invWidth);
+	__m128 ty2 = _mm_mul_ps(_mm_sub_ps(bottom, out.bottom), invHeight);
+
+	out.u0 = _mm_add_ps(u, _mm_mul_ps(uvWidth, tx));
+	out.v0 = _mm_add_ps(v, _mm_mul_ps(uvHeight, ty));
+	out.u1 = _mm_add_ps(out.u0, _mm_sub_ps(_mm_sub_ps(uvWidth, _mm_mul_ps(uvWidth, tx)), _mm_mul_ps(uvWidth, tx2)));
+	out.v1 = _mm_add_ps(out.v0, _mm_sub_ps(_mm_sub_ps(uvHeight, _mm_mul_ps(uvHeight, ty)), _mm_mul_ps(uvHeight, ty2)));
+}
+
+#endif
+
+#if defined(HORUS_QUAD_CLIPPER_AVX2)
+
+static inline __m256 combine(__m128 low, __m128 high)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+}
+
+static inline void clipQuads8(
+	const Rect* rects, const Rect* uvRects,
+	__m256 clipLeft, __m256 clipTop, __m256 clipRight, __m256 clipBottom,
+	ClippedQuads4& outLow, ClippedQuads4& outHigh)
+{
+	__m128 x0, y0, w0, h0, x1, y1, w1, h1;
+	__m128 u0, v0, uw0, uh0, u1, v1, uw1, uh1;
+
+	loadQuads4(rects, x0, y0, w0, h0);
+	loadQuads4(rects + 4, x1, y1, w1, h1);
+	loadQuads4(uvRects, u0, v0, uw0, uh0);
+	loadQuads4(uvRects + 4, u1, v1, uw1, uh1);
+
+	__m256 x = combine(x0, x1), y = combine(y0, y1), width = combine(w0, w1), height = combine(h0, h1);
+	__m256 u = combine(u0, u1), v = combine(v0, v1), uvWidth = combine(uw0, uw1), uvHeight = combine(uh0, uh1);
+
+	__m256 right = _mm256_add_ps(x, width);
+	__m256 bottom = _mm256_add_ps(y, height);
+	__m256 outside = _mm256_or_ps(
+		_mm256_or_ps(_mm256_cmp_ps(x, clipRight, _CMP_GT_OQ), _mm256_cmp_ps(right, clipLeft, _CMP_LT_OQ)),
+		_mm256_or_ps(_mm256_cmp_ps(y, clipBottom, _CMP_GT_OQ), _mm256_cmp_ps(bottom, clipTop, _CMP_LT_OQ)));
+	int visibleMask = ~_mm256_movemask_ps(outside) & 0xFF;
+
+	outLow.visibleMask = visibleMask & 0xF;
+	outHigh.visibleMask = visibleMask >> 4;
+
+	if (!visibleMask)
+	{
+		return;
+	}
+
+	__m256 left = _mm256_max_ps(x, clipLeft);
+	__m256 top = _mm256_max_ps(y, clipTop);
+	__m256 newRight = _mm256_min_ps(right, clipRight);
+	__m256 newBottom = _mm256_min_ps(bottom, clipBottom);
+
+	__m256 invWidth = _mm256_div_ps(_mm256_set1_ps(1.0f), width);
+	__m256 invHeight = _mm256_div_ps(_mm256_set1_ps(1.0f), height);
+	__m256 tx = _mm256_mul_ps(_mm256_sub_ps(left, x), invWidth);
+	__m256 ty = _mm256_mul_ps(_mm256_sub_ps(top, y), invHeight);
+	__m256 tx2 = _mm256_mul_ps(_mm256_sub_ps(right, newRight), invWidth);
+	__m256 ty2 = _mm256_mul_ps(_mm256_sub_ps(bottom, newBottom), invHeight);
+
+	__m256 newU0 = _mm256_add_ps(u, _mm256_mul_ps(uvWidth, tx));
+	__m256 newV0 = _mm256_add_ps(v, _mm256_mul_ps(uvHeight, ty));
+	__m256 newU1 = _mm256_add_ps(newU0, _mm256_sub_ps(_mm256_sub_ps(uvWidth, _mm256_mul_ps(uvWidth, tx)), _mm256_mul_ps(uvWidth, tx2)));
+	__m256 newV1 = _mm256_add_ps(newV0, _mm256_sub_ps(_mm256_sub_ps(uvHeight, _mm256_mul_ps(uvHeight, ty)), _mm256_mul_ps(uvHeight, ty2)));
+
+	outLow.left = _mm256_castps256_ps128(left);
+	outLow.top = _mm256_castps256_ps128(top);
+	outLow.right = _mm256_castps256_ps128(newRight);
+	outLow.bottom = _mm256_castps256_ps128(newBottom);
+	outLow.u0 = _mm256_castps256_ps128(newU0);
+	outLow.v0 = _mm256_castps256_ps128(newV0);
+	outLow.u1 = _mm256_castps256_ps128(newU1);
+	outLow.v1 = _mm256_castps256_ps128(newV1);
+
+	outHigh.left = _mm256_extractf128_ps(left, 1);
+	outHigh.top = _mm256_extractf128_ps(top, 1);
+	outHigh.right = _mm256_extractf128_ps(newRight, 1);
+	outHigh.bottom = _mm256_extractf128_ps(newBottom, 1);
+	outHigh.u0 = _mm256_extractf128_ps(newU0, 1);
+	outHigh.v0 = _mm256_extractf128_ps(newV0, 1);
+	outHigh.u1 = _mm256_extractf128_ps(newU1, 1);
+	outHigh.v1 = _mm256_extractf128_ps(newV1, 1);
+}
+
+#endif
+
+u32 clipAndEmitQuads(
+	const Rect* rects, const Rect* uvRects, const u32* textureIndices, u32 count,
+	const Rect& clipRect, u32 color, Vertex* outVertices)
+{
+	u32 quadCount = 0;
+	u32 i = 0;
+
+#if defined(HORUS_QUAD_CLIPPER_AVX2)
+	__m256 clipLeft8 = _mm256_set1_ps(clipRect.x);
+	__m256 clipTop8 = _mm256_set1_ps(clipRect.y);
+	__m256 clipRight8 = _mm256_set1_ps(clipRect.right());
+	__m256 clipBottom8 = _mm256_set1_ps(clipRect.bottom());
+
+	for (; i + 8 <= count; i += 8)
+	{
+		ClippedQuads4 low, high;
+
+		clipQuads8(rects + i, uvRects + i, clipLeft8, clipTop8, clipRight8, clipBottom8, low, high);
+
+		if (!(low.visibleMask | high.visibleMask))
+			continue;
+
+		quadCount += emitQuads4(low, textureIndices + i, color, outVertices + quadCount * 4);
+		quadCount += emitQuads4(high, textureIndices + i + 4, color, outVertices + quadCount * 4);
+	}
+#endif
+
+#if defined(HORUS_QUAD_CLIPPER_SSE2) || defined(HORUS_QUAD_CLIPPER_AVX2)
+	__m128 clipLeft = _mm_set1_ps(clipRect.x);
+	__m128 clipTop = _mm_set1_ps(clipRect.y);
+	__m128 clipRight = _mm_set1_ps(clipRect.right());
+	__m128 clipBottom = _mm_set1_ps(clipRect.bottom());
+
+	for (; i + 4 <= count; i += 4)
+	{
+		ClippedQuads4 quads;
+
+		clipQuads4(rects + i, uvRects + i, clipLeft, clipTop, clipRight, clipBottom, quads);
+
+		if (quads.visibleMask)
+			quadCount += emitQuads4(quads, textureIndices + i, color, outVertices + quadCount * 4);
+	}
+#endif
+
+	quadCount += clipAndEmitQuadsScalar(
+		rects + i, uvRects + i, textureIndices + i, count - i,
+		clipRect, color, outVertices + quadCount * 4);
+
+	return quadCount;
+}
+
+const char* getQuadClipperInstructionSet()
+{
+#if defined(HORUS_QUAD_CLIPPER_AVX2)
+	return "AVX2";
+#elif defined(HORUS_QUAD_CLIPPER_SSE2)
+	return "SSE2";
+#else
+	return "Scalar";
+#endif
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include "horus.h"
+#include "horus_interfaces.h"
+
+namespace hui
+{
+/// Clip axis aligned, non rotated quads against a clip rectangle and write the visible ones as 4 vertices each,
+/// in top-left, top-right, bottom-left, bottom-right order, matching the quad index pattern.
+/// Uses SSE2 or AVX2 when available, 4 or 8 quads at a time, and the scalar path for the rest
+/// \param rects the quads rectangles
+/// \param uvRects the quads UV rectangles
+/// \param textureIndices the atlas texture index of each quad
+/// \param count the quad count
+/// \param clipRect the clip rectangle
+/// \param color the color for all the vertices
+/// \param outVertices where to write the vertices, must have room for count * 4 vertices
+/// \return the visible quad count, the vertices written are 4 times that
+u32 clipAndEmitQuads(
+	const Rect* rects, const Rect* uvRects, const u32* textureIndices, u32 count,
+	const Rect& clipRect, u32 color, Vertex* outVertices);
+
+/// Same as clipAndEmitQuads, but without SIMD, one quad at a time
+u32 clipAndEmitQuadsScalar(
+	const Rect* rects, const Rect* uvRects, const u32* textureIndices, u32 count,
+	const Rect& clipRect, u32 color, Vertex* outVertices);
+
+/// Write the quads as 4 vertices each, without clipping them, for the graphics providers clipping the pixels in the shader
+/// \param rects the quads rectangles
+/// \param uvRects the quads UV rectangles
+/// \param textureIndices the atlas texture index of each quad
+/// \param count the quad count
+/// \param clipRectIndex the clip rect index for all the vertices
+/// \param color the color for all the vertices
+/// \param outVertices where to write the vertices, must have room for count * 4 vertices
+/// \return the quad count
+u32 emitQuads(
+	const Rect* rects, const Rect* uvRects, const u32* textureIndices, u32 count,
+	u16 clipRectIndex, u32 color, Vertex* outVertices);
+
+/// \return the name of the SIMD instruction set used by clipAndEmitQuads
+const char* getQuadClipperInstructionSet();
+
+}
\ No newline at end of file
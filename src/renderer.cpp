@@ -3,6 +3,8 @@
 #endif
 
 #include <string.h>
+#include <float.h>
+#include <math.h>
 #include <algorithm>
 #include "renderer.h"
 #include "ui_atlas.h"
@@ -11,13 +13,11 @@
 #include "ui_context.h"
 #include "util.h"
 #include "unicode_text_cache.h"
+#include "quad_clipper.h"
+#include "draw_command_capture.h"
 
 namespace hui
 {
-//TODO: make them grow dynamically like the vertex buffer
-const u32 textBufferMaxSize = 1024 * 1024 * 5;/// 5MB of text on screen at once its more than enough for now
-const u32 pointBufferMaxSize = 500000; /// more than enough for a full screen of lines, around 5MB
-
 enum LineClipBit
 {
 	Inside = 0,
@@ -402,6 +402,15 @@ void clipBottom(const Rect& rect, Point* inPoints, Point* inUvPoints, u32 inCoun
 	}
 }
 
+static inline void setVertex(Vertex& vertex, const Point& position, const Point& uv, u32 color, u32 textureIndex, u16 clipRectIndex)
+{
+	vertex.position = position;
+	vertex.uv = uv;
+	vertex.color = color;
+	vertex.textureIndex = textureIndex;
+	vertex.clipRectIndex = clipRectIndex;
+}
+
 bool clipTriangleToRect(
 	const Point& p1, const Point& p2, const Point& p3,
 	const Point& uv1, const Point& uv2, const Point& uv3,
@@ -451,21 +460,255 @@ bool clipTriangleToRect(
 	return true;
 }
 
+static bool isSameStyle(const TextStyle& a, const TextStyle& b)
+{
+	return a.style == b.style
+		&& a.underline == b.underline
+		&& a.backFill == b.backFill
+		&& a.backFillColor.getRgba() == b.backFillColor.getRgba();
+}
+
+static bool isSameStyle(const LineStyle& a, const LineStyle& b)
+{
+	if (a.color.getRgba() != b.color.getRgba()
+		|| a.width != b.width
+		|| a.useStipple != b.useStipple)
+	{
+		return false;
+	}
+
+	if (!a.useStipple)
+	{
+		return true;
+	}
+
+	return a.stipplePatternCount == b.stipplePatternCount
+		&& a.stipplePhase == b.stipplePhase
+		&& !memcmp(a.stipplePattern, b.stipplePattern, sizeof(f32) * a.stipplePatternCount);
+}
+
+static bool isSameStyle(const FillStyle& a, const FillStyle& b)
+{
+	return a.color.getRgba() == b.color.getRgba()
+		&& a.texture == b.texture
+		&& !(a.scale != b.scale);
+}
+
+u32 DrawCommandBuffer::addTextStyle(const TextStyle& style)
+{
+	if (textStyles.empty() || !isSameStyle(textStyles.back(), style))
+	{
+		textStyles.push_back(style);
+	}
+
+	return textStyles.size() - 1;
+}
+
+u32 DrawCommandBuffer::addLineStyle(const LineStyle& style)
+{
+	if (lineStyles.empty() || !isSameStyle(lineStyles.back(), style))
+	{
+		lineStyles.push_back(style);
+	}
+
+	return lineStyles.size() - 1;
+}
+
+u32 DrawCommandBuffer::addFillStyle(const FillStyle& style)
+{
+	if (fillStyles.empty() || !isSameStyle(fillStyles.back(), style))
+	{
+		fillStyles.push_back(style);
+	}
+
+	return fillStyles.size() - 1;
+}
+
+u32 DrawCommandBuffer::getLayerIndex(i32 zOrder)
+{
+	auto iter = std::lower_bound(
+		layers.begin(), layers.end(), zOrder,
+		[](const Layer& layer, i32 z) { return layer.zOrder < z; });
+
+	if (iter == layers.end() || iter->zOrder != zOrder)
+	{
+		iter = layers.insert(iter, Layer());
+		iter->zOrder = zOrder;
+	}
+
+	return iter - layers.begin();
+}
+
+void DrawCommandBuffer::clear()
+{
+	// drop the layers not used in the last frame, keep the others to reuse their memory
+	layers.erase(
+		std::remove_if(layers.begin(), layers.end(), [](const Layer& layer) { return layer.entries.empty(); }),
+		layers.end());
+
+	for (auto& layer : layers)
+	{
+		layer.entries.clear();
+		layer.splicedEntries.clear();
+		layer.splices.clear();
+	}
+
+	insertionPoints.clear();
+	data.clear();
+	commandCount = 0;
+	textStyles.clear();
+	lineStyles.clear();
+	fillStyles.clear();
+	clipRects.clear();
+	shapes.clear();
+}
+
+u32 DrawCommandBuffer::addClipRect(const Rect& rect)
+{
+	// the vertices only have 16 bits for the index, the rest are clipped on the CPU
+	if (clipRects.size() > 0xFFFF)
+		return 0;
+
+	if (clipRects.empty())
+		clipRects.push_back(Rect());
+
+	clipRects.push_back(rect);
+
+	return clipRects.size() - 1;
+}
+
+u32 DrawCommandBuffer::addShape(const ShapeParameters& shape)
+{
+	// the vertices only have 15 bits for the index, the rest are tessellated
+	if (shapes.size() >= maxShapeCount)
+		return maxShapeCount;
+
+	shapes.push_back(shape);
+
+	return shapes.size() - 1;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	while (currentBlock < blocks.size())
+	{
+		auto& block = blocks[currentBlock];
+		uintptr_t start = (uintptr_t)block.data();
+		size_t offset = ((start + currentBlockUsed + alignment - 1) & ~(uintptr_t)(alignment - 1)) - start;
+
+		if (offset + size <= block.size())
+		{
+			currentBlockUsed = offset + size;
+			usedByteSize += size;
+
+			return block.data() + offset;
+		}
+
+		// chain the next block, the rest of this one is wasted until the next frame
+		currentBlock++;
+		currentBlockUsed = 0;
+	}
+
+	blocks.emplace_back();
+	blocks.back().resize(std::max(defaultBlockSize, size + alignment));
+
+	return allocate(size, alignment);
+}
+
+void FrameArena::reset()
+{
+	// when the last frame needed more than one block, merge them into one big enough block,
+	// so the following frames don't need to chain
+	if (blocks.size() > 1)
+	{
+		size_t totalSize = 0;
+
+		for (auto& block : blocks)
+		{
+			totalSize += block.size();
+		}
+
+		blocks.clear();
+		blocks.emplace_back();
+		blocks.back().resize(totalSize);
+	}
+
+	currentBlock = 0;
+	currentBlockUsed = 0;
+	usedByteSize = 0;
+}
+
+size_t DrawCommandBuffer::getByteSize() const
+{
+	return data.size()
+		+ commandCount * sizeof(u32)
+		+ textStyles.size() * sizeof(TextStyle)
+		+ lineStyles.size() * sizeof(LineStyle)
+		+ fillStyles.size() * sizeof(FillStyle)
+		+ clipRects.size() * sizeof(Rect)
+		+ shapes.size() * sizeof(ShapeParameters);
+}
+
+u32 DrawCommandBuffer::allocate(DrawCommand::Type type, u32 size)
+{
+	u32 offset = data.size();
+
+	data.resize(offset + size);
+
+	auto header = getHeader(offset);
+
+	header->type = type;
+	header->size = size;
+
+	return offset;
+}
+
 Renderer::Renderer()
 {
-	textBuffer.resize(textBufferMaxSize);
-	pointBuffer.resize(pointBufferMaxSize);
 	vertexBuffer = ctx->gfx->createVertexBuffer();
+	indexBuffer = ctx->gfx->createIndexBuffer();
+	vertexFormat = ctx->gfx->getVertexFormat();
+}
+
+Renderer::Renderer(Renderer* mainRenderer)
+	: mainRenderer(mainRenderer)
+{
+	// the chunk renderers only generate vertices, the main renderer uploads them
+	executedCommands = &mainRenderer->drawCommands;
+	vertexFormat = mainRenderer->vertexFormat;
 }
 
 Renderer::~Renderer()
 {
+	for (auto renderer : chunkRenderers)
+	{
+		delete renderer;
+	}
+
+	for (auto& iter : cachedLayers)
+	{
+		destroyCachedLayer(iter.second);
+	}
+
 	delete vertexBuffer;
+	delete indexBuffer;
 }
 
 void Renderer::clear(const Color& color)
 {
-	ctx->gfx->clear(color);
+	frameCleared = true;
+	frameClearColor = color;
+
+	// the clear is scissored to the damaged area too, when the frame is drawn
+	if (!isPartialRedraw())
+	{
+		ctx->gfx->clear(color);
+	}
+}
+
+bool Renderer::isPartialRedraw() const
+{
+	return ctx->settings.partialRedraw && ctx->gfx->isBackBufferPreserved();
 }
 
 Rect Renderer::pushClipRect(const Rect& rect, bool clipToParent)
@@ -475,12 +718,10 @@ Rect Renderer::pushClipRect(const Rect& rect, bool clipToParent)
 	auto newRect = clipToParent ? rect.clipInside(oldRect) : rect;
 	currentClipRect = newRect;
 
-	DrawCommand cmd(DrawCommand::Type::ClipRect);
+	auto& cmd = addDrawCommand<DrawCommand::CmdClipRect>(DrawCommand::Type::ClipRect);
 
-	cmd.zOrder = zOrder;
-	cmd.clipRect = currentClipRect;
-	cmd.clipToParent = clipToParent;
-	addDrawCommand(cmd);
+	cmd.rect = currentClipRect;
+	cmd.index = drawCommands.addClipRect(currentClipRect);
 
 	return newRect;
 }
@@ -495,12 +736,10 @@ void Renderer::popClipRect()
 	currentClipRect = clipRectStack.back();
 	clipRectStack.pop_back();
 
-	DrawCommand cmd(DrawCommand::Type::ClipRect);
+	auto& cmd = addDrawCommand<DrawCommand::CmdClipRect>(DrawCommand::Type::ClipRect);
 
-	cmd.clipRect = currentClipRect;
-	cmd.zOrder = zOrder;
-	cmd.popClipRect = true;
-	addDrawCommand(cmd);
+	cmd.rect = currentClipRect;
+	cmd.index = drawCommands.addClipRect(currentClipRect);
 }
 
 void Renderer::setWindowSize(const Point& size)
@@ -512,250 +751,1568 @@ void Renderer::setWindowSize(const Point& size)
 
 void Renderer::beginFrame()
 {
+	frameStats = FrameStats();
+	phaseStartTime = std::chrono::high_resolution_clock::now();
 	zOrder = 0;
 	skipRender = false;
 	disableRendering = false;
 	drawCommands.clear();
 	batches.clear();
 	vertexBufferData.drawVertexCount = 0;
-	textBufferPosition = 0;
-	pointBufferPosition = 0;
+	quadQueue.count = 0;
+	frameArena.reset();
 	currentAtlas = nullptr;
 	currentBatch = nullptr;
+	replayedCapture = nullptr;
+	frameCachedLayers.clear();
+	cachedLayerDepth = 0;
+
+	// free the render targets of the layers not used lately
+	for (auto iter = cachedLayers.begin(); iter != cachedLayers.end();)
+	{
+		if (ctx->frameCount - iter->second.lastUsedFrame > ctx->settings.cachedLayerMaxUnusedFrames)
+		{
+			destroyCachedLayer(iter->second);
+			iter = cachedLayers.erase(iter);
+			continue;
+		}
+
+		++iter;
+	}
+
 	cmdSetAtlas(ctx->theme->atlas);
 }
 
 void Renderer::endFrame()
 {
 	if (disableRendering || skipRender)
+	{
+		frameCleared = false;
 		return;
+	}
 
-	auto sortDrawCommands = [](const DrawCommand& a, const DrawCommand& b) -> bool
-	{
-		if (a.zOrder < b.zOrder)
-			return true;
+	endPhase(FramePhase::WidgetBuild);
 
-		return false;
-	};
+	if (replayedCapture)
+	{
+		// the captured commands take the place of the recorded ones until the frame ends,
+		// they start with the state the captured recording left
+		std::swap(drawCommands, replayedCapture->commands);
+		frameCachedLayers.clear();
+		currentColor = replayedCapture->state.color;
+		currentFont = replayedCapture->state.font;
+		currentClipRect = replayedCapture->state.clipRect;
+		currentTextStyle = replayedCapture->state.textStyle;
+		currentLineStyle = replayedCapture->state.lineStyle;
+		currentFillStyle = replayedCapture->state.fillStyle;
+	}
+	else if (!captureFilename.empty())
+	{
+		saveCapture();
+		// the capture is not part of any phase
+		phaseStartTime = std::chrono::high_resolution_clock::now();
+	}
 
-	std::stable_sort(drawCommands.begin(), drawCommands.end(), sortDrawCommands);
 	currentAtlas = nullptr;
 	currentBatch = nullptr;
+	skipCachedLayerCommands = false;
 
-	// generate the batches
-	for (auto& cmd : drawCommands)
+	bool partialRedraw = isPartialRedraw();
+	Rect damageBounds;
+
+	if (ctx->settings.partialRedraw)
 	{
-		switch (cmd.type)
+		auto& damage = computeDamage();
+
+		for (auto& rect : damage.rects)
 		{
-		case DrawCommand::Type::DrawImageBordered:
-			drawImageBordered(cmd.drawImageBordered.image, cmd.drawImageBordered.border, cmd.drawImageBordered.rect, cmd.drawImageBordered.scale);
-			break;
-		case DrawCommand::Type::DrawQuad:
-			drawQuad(cmd.drawQuad.image, cmd.drawQuad.corners[0], cmd.drawQuad.corners[1], cmd.drawQuad.corners[2], cmd.drawQuad.corners[3]);
-			break;
-		case DrawCommand::Type::DrawRect:
+			if (damageBounds.isZero())
+			{
+				damageBounds = rect;
+			}
+			else
+			{
+				f32 right = std::max(damageBounds.right(), rect.right());
+				f32 bottom = std::max(damageBounds.bottom(), rect.bottom());
+
+				damageBounds.x = std::min(damageBounds.x, rect.x);
+				damageBounds.y = std::min(damageBounds.y, rect.y);
+				damageBounds.width = right - damageBounds.x;
+				damageBounds.height = bottom - damageBounds.y;
+			}
+
+			frameStats.damagedArea += rect.width * rect.height;
+		}
+
+		frameStats.damageRectCount = damage.rects.size();
+		endPhase(FramePhase::Damage);
+	}
+
+	// when the back buffer has the previous frame and nothing changed, there is nothing to draw
+	if (!partialRedraw || !damageBounds.isZero())
+	{
+		// the shape vertices only have offsets from the shape's center, so the cached layers can use the shader shapes too
+		shaderShapes = ctx->settings.shaderShapes
+			&& vertexFormat == VertexFormat::Full
+			&& ctx->gfx->supportsShaderShapes();
+		glyphRunCache = ctx->settings.glyphRunCache;
+
+		if (shaderShapes && !drawCommands.shapes.empty())
+		{
+			ctx->gfx->setShapes(drawCommands.shapes.data(), drawCommands.shapes.size());
+		}
+
+		// the cached layers are drawn translated in their render targets, they're clipped on the CPU
+		shaderClipping = false;
+		currentClipRectIndex = 0;
+
+		if (!frameCachedLayers.empty())
 		{
-			atlasTextureIndex = cmd.drawRect.textureIndex;
+			renderCachedLayers();
+		}
+
+		// the clip rects are evaluated per pixel, starting with the ones set by the commands
+		shaderClipping = ctx->settings.shaderClipping
+			&& vertexFormat == VertexFormat::Full
+			&& ctx->gfx->supportsShaderClipping();
 
-			if (clipRect(cmd.drawRect.rotated, cmd.drawRect.rect, cmd.drawRect.uvRect))
+		u32 threadCount = ctx->settings.vertexGenerationThreadCount;
+
+		if (threadCount != 1 && drawCommands.commandCount >= ctx->settings.parallelVertexGenerationMinCommandCount)
+		{
+			generateVerticesParallel(threadCount);
+		}
+		else
+		{
+			// generate the batches, walking the layers in z-order
+			for (auto& layer : drawCommands.layers)
 			{
-				if (cmd.drawRect.rotated)
-				{
-					drawQuadRot90(cmd.drawRect.rect, cmd.drawRect.uvRect);
-				}
-				else
-				{
-					drawQuad(cmd.drawRect.rect, cmd.drawRect.uvRect);
-				}
+				executeLayer(layer);
 			}
-			break;
+
+			flushQuadQueue();
 		}
-		case DrawCommand::Type::DrawText:
-			drawTextInternal(cmd.drawText.text, cmd.drawText.position);
-			break;
-		case DrawCommand::Type::SetColor:
-			currentColor = cmd.setColor.getRgba();
-			break;
-		case DrawCommand::Type::SetFont:
-			currentFont = cmd.setFont;
-			break;
-		case DrawCommand::Type::ClipRect:
-			currentClipRect = cmd.clipRect;
-			break;
-		case DrawCommand::Type::SetTextStyle:
-			currentTextStyle = cmd.setTextStyle;
-			break;
-		case DrawCommand::Type::SetLineStyle:
-			currentLineStyle = cmd.setLineStyle;
-			break;
-		case DrawCommand::Type::SetFillStyle:
-			currentFillStyle = cmd.setFillStyle;
-			break;
-		case DrawCommand::Type::DrawLine:
-			currentColor = currentLineStyle.color.getRgba();
-			drawLine(cmd.drawLine.a, cmd.drawLine.b);
-			break;
-		case DrawCommand::Type::DrawPolyLine:
-			currentColor = currentLineStyle.color.getRgba();
-			drawPolyLine(cmd.drawPolyLine.points, cmd.drawPolyLine.count, cmd.drawPolyLine.closed);
-			break;
-		case DrawCommand::Type::DrawSolidTriangle:
-			currentColor = currentFillStyle.color.getRgba();
-			drawTriangle(
-				cmd.drawTriangle.p1,
-				cmd.drawTriangle.p2,
-				cmd.drawTriangle.p3,
-				cmd.drawTriangle.uv1,
-				cmd.drawTriangle.uv2,
-				cmd.drawTriangle.uv3,
-				cmd.drawTriangle.image);
-			break;
-		case DrawCommand::Type::SetAtlas:
-			if (currentAtlas != cmd.setAtlas)
+
+		endPhase(FramePhase::Tessellate);
+		mergeBatches();
+		endPhase(FramePhase::Merge);
+		uploadVertices();
+		endPhase(FramePhase::Upload);
+
+		if (partialRedraw)
+		{
+			// only the damaged area is redrawn, the rest of the back buffer already has it
+			ctx->gfx->setScissor(damageBounds);
+
+			if (frameCleared)
 			{
-				currentAtlas = cmd.setAtlas;
-				addBatch();
+				ctx->gfx->clear(frameClearColor);
 			}
-			break;
 		}
+
+		if (shaderClipping && !drawCommands.clipRects.empty())
+		{
+			ctx->gfx->setClipRects(drawCommands.clipRects.data(), drawCommands.clipRects.size());
+		}
+
+		// render the batches
+		ctx->gfx->draw(drawBatches.data(), drawBatches.size());
+		shaderClipping = false;
+		shaderShapes = false;
+		currentClipRectIndex = 0;
+
+		if (partialRedraw)
+		{
+			ctx->gfx->disableScissor();
+		}
+
+		endPhase(FramePhase::Submit);
+		frameStats.drawnBatchCount += drawBatches.size();
+		frameStats.vertexCount += vertexBufferData.drawVertexCount;
 	}
 
-	vertexBuffer->updateData(vertexBufferData.vertices.data(), 0, vertexBufferData.drawVertexCount);
-	// render the batches
-	ctx->gfx->draw(batches.data(), batches.size());
-}
+	// the counters include the cached layers redrawn in this frame
+	frameStats.drawCommandCount = drawCommands.commandCount;
+	lastFrameStats = frameStats;
+	addPhaseTimesToHistory();
+	frameCleared = false;
 
-void Renderer::cmdSetColor(const Color& newColor)
-{
-	DrawCommand cmd(DrawCommand::Type::SetColor);
-	cmd.zOrder = zOrder;
-	cmd.setColor = newColor;
-	addDrawCommand(cmd);
+	if (replayedCapture)
+	{
+		// give the commands back, so the capture can be replayed again
+		std::swap(drawCommands, replayedCapture->commands);
+		replayedCapture = nullptr;
+	}
 }
 
-void Renderer::cmdSetAtlas(UiAtlas* newAtlas)
+void Renderer::saveCapture()
 {
-	DrawCommand cmd(DrawCommand::Type::SetAtlas);
-	cmd.zOrder = zOrder;
-	cmd.setAtlas = newAtlas;
-	currentAtlas = newAtlas;
-	addDrawCommand(cmd);
-}
+	DrawCommandCaptureState state;
 
-void Renderer::cmdSetFont(UiFont* font)
-{
-	DrawCommand cmd(DrawCommand::Type::SetFont);
-	cmd.zOrder = zOrder;
-	cmd.setFont = font;
-	currentFont = font;
-	addDrawCommand(cmd);
-}
+	commandOrder.clear();
 
-void Renderer::cmdSetTextUnderline(bool underline)
-{
-	DrawCommand cmd(DrawCommand::Type::SetTextStyle);
-	currentTextStyle.underline = underline;
-	cmd.zOrder = zOrder;
-	cmd.setTextStyle = currentTextStyle;
-	addDrawCommand(cmd);
-}
+	for (auto& layer : drawCommands.layers)
+	{
+		forEachLayerCommand(layer, [this](u32 offset) { commandOrder.push_back(offset); });
+	}
 
-void Renderer::cmdSetTextBackfill(bool backfill)
-{
-	DrawCommand cmd(DrawCommand::Type::SetTextStyle);
-	currentTextStyle.backFill = backfill;
-	cmd.zOrder = zOrder;
-	cmd.setTextStyle = currentTextStyle;
-	addDrawCommand(cmd);
+	state.color = currentColor;
+	state.font = currentFont;
+	state.clipRect = currentClipRect;
+	state.textStyle = currentTextStyle;
+	state.lineStyle = currentLineStyle;
+	state.fillStyle = currentFillStyle;
+	writeDrawCommandCaptureFile(captureFilename.c_str(), drawCommands, commandOrder, state, windowSize);
+	captureFilename.clear();
 }
 
-void Renderer::cmdSetTextBackfillColor(const Color& color)
+static inline u64 hashBytes(u64 hash, const void* data, size_t size)
 {
-	DrawCommand cmd(DrawCommand::Type::SetTextStyle);
-	currentTextStyle.backFillColor = color;
-	cmd.zOrder = zOrder;
-	cmd.setTextStyle = currentTextStyle;
-	addDrawCommand(cmd);
-}
+	auto bytes = (const u8*)data;
 
-void Renderer::cmdSetLineStyle(const LineStyle& style)
-{
-	DrawCommand cmd(DrawCommand::Type::SetLineStyle);
-	cmd.zOrder = zOrder;
-	currentLineStyle = cmd.setLineStyle = style;
-	addDrawCommand(cmd);
+	// FNV-1a
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
 }
 
-void Renderer::cmdSetFillStyle(const FillStyle& style)
+template<typename T>
+static inline u64 hashValue(u64 hash, const T& value)
 {
-	DrawCommand cmd(DrawCommand::Type::SetFillStyle);
-	cmd.zOrder = zOrder;
-	currentFillStyle = cmd.setFillStyle = style;
-	addDrawCommand(cmd);
+	return hashBytes(hash, &value, sizeof(T));
 }
 
-void Renderer::cmdDrawImage(UiImage* image, const Point& position, f32 scale)
+static u64 hashStyle(u64 hash, const TextStyle& style)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawRect);
-	cmd.zOrder = zOrder;
-	cmd.drawRect.rect = Rect(position.x, position.y, image->rect.width * scale, image->rect.height * scale);
-	cmd.drawRect.uvRect = image->uvRect;
-	cmd.drawRect.rotated = image->rotated;
-	cmd.drawRect.textureIndex = image->atlasTexture->textureIndex;
-	addDrawCommand(cmd);
+	hash = hashValue(hash, style.style);
+	hash = hashValue(hash, style.backFillColor);
+	hash = hashValue(hash, style.underline);
+
+	return hashValue(hash, style.backFill);
 }
 
-void Renderer::cmdDrawImage(UiImage* image, const Rect& rect)
+static u64 hashStyle(u64 hash, const LineStyle& style)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawRect);
-	cmd.zOrder = zOrder;
-	cmd.drawRect.rect = rect;
-	cmd.drawRect.uvRect = image->uvRect;
-	cmd.drawRect.rotated = image->rotated;
-	cmd.drawRect.textureIndex = image->atlasTexture->textureIndex;
-	addDrawCommand(cmd);
+	u32 patternCount = std::min(style.stipplePatternCount, LineStyle::stipplePatternMaxCount);
+
+	hash = hashValue(hash, style.color);
+	hash = hashValue(hash, style.width);
+	hash = hashValue(hash, style.useStipple);
+	hash = hashBytes(hash, style.stipplePattern, patternCount * sizeof(f32));
+	hash = hashValue(hash, style.stipplePatternCount);
+
+	return hashValue(hash, style.stipplePhase);
 }
 
-void Renderer::cmdDrawImage(UiImage* image, const Rect& rect, const Rect& uvRect)
+static u64 hashStyle(u64 hash, const FillStyle& style)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawRect);
-	cmd.zOrder = zOrder;
-	cmd.drawRect.rect = rect;
-	cmd.drawRect.uvRect = uvRect;
-	cmd.drawRect.rotated = image->rotated;
-	cmd.drawRect.textureIndex = image->atlasTexture->textureIndex;
-	addDrawCommand(cmd);
+	hash = hashValue(hash, style.color);
+	hash = hashValue(hash, style.texture);
+
+	return hashValue(hash, style.scale);
 }
 
-void Renderer::cmdDrawQuad(UiImage* image, const Point& p1, const Point& p2, const Point& p3, const Point& p4)
+u64 Renderer::hashDrawCommand(u64 hash, DrawCommand::Header* header)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawQuad);
-	cmd.zOrder = zOrder;
-	cmd.drawQuad.corners[0] = p1;
-	cmd.drawQuad.corners[1] = p2;
-	cmd.drawQuad.corners[2] = p3;
-	cmd.drawQuad.corners[3] = p4;
-	cmd.drawQuad.image = image;
+	hash = hashValue(hash, header->type);
+
+	switch (header->type)
+	{
+	// the texts and points are copied in the frame arena, hash them instead of their addresses
+	case DrawCommand::Type::DrawText:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawText>(header);
+
+		hash = hashValue(hash, cmd.position);
+
+		if (cmd.text)
+			hash = hashBytes(hash, cmd.text, strlen(cmd.text));
+
+		return hash;
+	}
+	// the table index depends on the clip rects recorded before
+	case DrawCommand::Type::ClipRect:
+		return hashValue(hash, DrawCommand::getPayload<DrawCommand::CmdClipRect>(header).rect);
+	// the table index depends on the shapes recorded before
+	case DrawCommand::Type::DrawShape:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawShape>(header);
+
+		hash = hashValue(hash, cmd.rect);
+
+		return hashValue(hash, cmd.shape);
+	}
+	case DrawCommand::Type::DrawPolyLine:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawPolyLine>(header);
 
-	addDrawCommand(cmd);
+		hash = hashValue(hash, cmd.closed);
+
+		return hashBytes(hash, cmd.points, cmd.count * sizeof(Point));
+	}
+	// the style indices depend on the styles used before, in the whole frame
+	case DrawCommand::Type::SetTextStyle:
+		return hashStyle(hash, drawCommands.textStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex]);
+	case DrawCommand::Type::SetLineStyle:
+		return hashStyle(hash, drawCommands.lineStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex]);
+	case DrawCommand::Type::SetFillStyle:
+		return hashStyle(hash, drawCommands.fillStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex]);
+	default:
+		// the stream is zero filled when allocated, so the padding bytes are always the same
+		return hashBytes(hash, header + 1, header->size - sizeof(DrawCommand::Header));
+	}
 }
 
-void Renderer::cmdDrawImageBordered(UiImage* image, u32 border, const Rect& rect, f32 scale)
+u64 Renderer::hashChunkState(u64 hash, const ChunkState& state)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawImageBordered);
-	cmd.zOrder = zOrder;
-	cmd.drawImageBordered.rect = rect;
-	cmd.drawImageBordered.image = image;
-	cmd.drawImageBordered.border = border;
-	cmd.drawImageBordered.scale = scale;
-	addDrawCommand(cmd);
+	hash = hashValue(hash, state.color);
+	hash = hashValue(hash, state.font);
+	hash = hashValue(hash, state.clipRect);
+	hash = hashValue(hash, state.atlas);
+	hash = hashStyle(hash, state.textStyle);
+	hash = hashStyle(hash, state.lineStyle);
+
+	return hashStyle(hash, state.fillStyle);
 }
 
-void Renderer::cmdDrawImageScaledAligned(UiImage* image, const Rect& rect, HAlignType halign, VAlignType valign, f32 scale)
+/// Add a rectangle to the damaged ones, merging it with the ones it touches, and with the closest one when there are too many
+static void addDamageRect(std::vector<Rect>& rects, Rect rect, u32 maxCount)
 {
-	f32 newWidth = image->rect.width * scale;
-	f32 newHeight = image->rect.height * scale;
-	Rect newRect = { rect.x, rect.y, newWidth, newHeight };
+	auto unite = [](const Rect& a, const Rect& b)
+	{
+		f32 left = std::min(a.x, b.x);
+		f32 top = std::min(a.y, b.y);
+
+		return Rect(left, top, std::max(a.right(), b.right()) - left, std::max(a.bottom(), b.bottom()) - top);
+	};
+
+	for (size_t i = 0; i < rects.size();)
+	{
+		if (rect.outside(rects[i]))
+		{
+			i++;
+			continue;
+		}
+
+		// the merged rectangle can touch the ones already checked
+		rect = unite(rect, rects[i]);
+		rects[i] = rects.back();
+		rects.pop_back();
+		i = 0;
+	}
+
+	if (rects.size() < std::max(maxCount, 1u))
+	{
+		rects.push_back(rect);
+		return;
+	}
+
+	// merge with the rectangle adding the least area
+	size_t bestIndex = 0;
+	f32 bestArea = FLT_MAX;
+
+	for (size_t i = 0; i < rects.size(); i++)
+	{
+		Rect merged = unite(rect, rects[i]);
+		f32 addedArea = merged.width * merged.height - rects[i].width * rects[i].height;
+
+		if (addedArea < bestArea)
+		{
+			bestArea = addedArea;
+			bestIndex = i;
+		}
+	}
+
+	rect = unite(rect, rects[bestIndex]);
+	rects[bestIndex] = rects.back();
+	rects.pop_back();
+	addDamageRect(rects, rect, maxCount);
+}
+
+Renderer::WindowDamage& Renderer::computeDamage()
+{
+	auto& damage = windowDamages[ctx->inputProvider->getCurrentWindow()];
+	const Rect windowRect = getWindowRect();
+	ChunkState state;
+
+	commandOrder.clear();
+
+	for (auto& layer : drawCommands.layers)
+	{
+		forEachLayerCommand(layer, [this](u32 offset) { commandOrder.push_back(offset); });
+	}
+
+	// the state left by the recording, the same the serial path starts with
+	state.color = currentColor;
+	state.font = currentFont;
+	state.clipRect = currentClipRect;
+	state.atlas = currentAtlas;
+	state.textStyle = currentTextStyle;
+	state.lineStyle = currentLineStyle;
+	state.fillStyle = currentFillStyle;
+	damageItems.clear();
+
+	u64 stateHash = hashChunkState(14695981039346656037ull, state);
+
+	for (auto offset : commandOrder)
+	{
+		auto header = drawCommands.getHeader(offset);
+		Rect bounds;
+		bool drawn = getDrawCommandBounds(header, state, bounds);
+
+		if (drawn)
+		{
+			bounds = bounds.clipInside(state.clipRect);
+
+			if (bounds.width > 0 && bounds.height > 0)
+			{
+				DamageItem item;
+
+				item.key = hashDrawCommand(stateHash, header);
+				item.bounds = bounds;
+				damageItems.push_back(item);
+			}
+		}
+
+		u32 color = state.color;
+
+		updateChunkState(state, header);
+
+		// the draw commands only change the current color, for the lines and triangles
+		if (!drawn || state.color != color)
+		{
+			stateHash = hashChunkState(14695981039346656037ull, state);
+		}
+	}
+
+	std::sort(damageItems.begin(), damageItems.end(), [](const DamageItem& a, const DamageItem& b) { return a.key < b.key; });
+	damage.rects.clear();
+
+	auto addDamage = [&](const Rect& rect)
+	{
+		// whole pixels, the antialiased edges and the rounded text positions touch the neighbour pixels
+		f32 left = floorf(rect.x) - 1;
+		f32 top = floorf(rect.y) - 1;
+		Rect pixelRect(left, top, ceilf(rect.right()) + 1 - left, ceilf(rect.bottom()) + 1 - top);
+
+		pixelRect = pixelRect.clipInside(windowRect);
+
+		if (pixelRect.width > 0 && pixelRect.height > 0)
+		{
+			addDamageRect(damage.rects, pixelRect, ctx->settings.maxDamageRectCount);
+		}
+	};
+
+	u32 clearColor = frameClearColor.getRgba();
+
+	if (damage.windowSize != windowSize
+		|| damage.cleared != frameCleared
+		|| (frameCleared && damage.clearColor != clearColor))
+	{
+		addDamage(windowRect);
+	}
+	else
+	{
+		// the commands found in only one of the frames were added, removed or changed
+		auto& lastItems = damage.items;
+		size_t i = 0, j = 0;
+
+		while (i < damageItems.size() && j < lastItems.size())
+		{
+			if (damageItems[i].key < lastItems[j].key)
+			{
+				addDamage(damageItems[i++].bounds);
+			}
+			else if (lastItems[j].key < damageItems[i].key)
+			{
+				addDamage(lastItems[j++].bounds);
+			}
+			else
+			{
+				i++;
+				j++;
+			}
+		}
+
+		for (; i < damageItems.size(); i++)
+		{
+			addDamage(damageItems[i].bounds);
+		}
+
+		for (; j < lastItems.size(); j++)
+		{
+			addDamage(lastItems[j].bounds);
+		}
+	}
+
+	damage.items.swap(damageItems);
+	damage.windowSize = windowSize;
+	damage.cleared = frameCleared;
+	damage.clearColor = clearColor;
+
+	return damage;
+}
+
+/// \return the bounding rectangle of the points, grown by the border on each side
+static Rect getPointsBounds(const Point* points, u32 count, f32 border)
+{
+	Point minPoint = points[0];
+	Point maxPoint = points[0];
+
+	for (u32 i = 1; i < count; i++)
+	{
+		minPoint.x = std::min(minPoint.x, points[i].x);
+		minPoint.y = std::min(minPoint.y, points[i].y);
+		maxPoint.x = std::max(maxPoint.x, points[i].x);
+		maxPoint.y = std::max(maxPoint.y, points[i].y);
+	}
+
+	return {
+		minPoint.x - border,
+		minPoint.y - border,
+		maxPoint.x - minPoint.x + border * 2,
+		maxPoint.y - minPoint.y + border * 2 };
+}
+
+bool Renderer::getDrawCommandBounds(DrawCommand::Header* header, const ChunkState& state, Rect& bounds)
+{
+	switch (header->type)
+	{
+	case DrawCommand::Type::DrawRect:
+		bounds = DrawCommand::getPayload<DrawCommand::CmdDrawRect>(header).rect;
+		return true;
+	case DrawCommand::Type::DrawQuad:
+		bounds = getPointsBounds(DrawCommand::getPayload<DrawCommand::CmdDrawQuad>(header).corners, 4, 0);
+		return true;
+	case DrawCommand::Type::DrawImageBordered:
+		bounds = DrawCommand::getPayload<DrawCommand::CmdDrawImageBordered>(header).rect;
+		return true;
+	case DrawCommand::Type::DrawLine:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawLine>(header);
+		Point points[2] = { cmd.a, cmd.b };
+
+		bounds = getPointsBounds(points, 2, state.lineStyle.width);
+		return true;
+	}
+	case DrawCommand::Type::DrawPolyLine:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawPolyLine>(header);
+
+		if (!cmd.count)
+			return false;
+
+		bounds = getPointsBounds(cmd.points, cmd.count, state.lineStyle.width);
+		return true;
+	}
+	case DrawCommand::Type::DrawText:
+		bounds = DrawCommand::getPayload<DrawCommand::CmdDrawText>(header).bounds;
+		return true;
+	case DrawCommand::Type::DrawInterpolatedColors:
+		bounds = DrawCommand::getPayload<DrawCommand::CmdDrawInterpolatedColors>(header).rect;
+		return true;
+	case DrawCommand::Type::DrawSpectrumColors:
+		bounds = DrawCommand::getPayload<DrawCommand::CmdDrawSpectrumColors>(header).rect;
+		return true;
+	case DrawCommand::Type::DrawShape:
+		bounds = DrawCommand::getPayload<DrawCommand::CmdDrawShape>(header).rect;
+		return true;
+	case DrawCommand::Type::DrawSolidTriangle:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawTriangle>(header);
+		Point points[3] = { cmd.p1, cmd.p2, cmd.p3 };
+
+		bounds = getPointsBounds(points, 3, 0);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+const std::vector<Rect>* Renderer::findDamageRects(Window window) const
+{
+	auto iter = windowDamages.find(window);
+
+	if (iter == windowDamages.end())
+	{
+		return nullptr;
+	}
+
+	return &iter->second.rects;
+}
+
+void Renderer::renderCachedLayers()
+{
+	commandOrder.clear();
+
+	for (auto& layer : drawCommands.layers)
+	{
+		forEachLayerCommand(layer, [this](u32 offset) { commandOrder.push_back(offset); });
+	}
+
+	const u32 commandCount = commandOrder.size();
+	ChunkState state;
+
+	// the state left by the recording, the same the serial path starts with
+	state.color = currentColor;
+	state.font = currentFont;
+	state.clipRect = currentClipRect;
+	state.atlas = currentAtlas;
+	state.textStyle = currentTextStyle;
+	state.lineStyle = currentLineStyle;
+	state.fillStyle = currentFillStyle;
+
+	const ChunkState startState = state;
+
+	for (u32 i = 0; i < commandCount; i++)
+	{
+		auto header = drawCommands.getHeader(commandOrder[i]);
+
+		if (header->type == DrawCommand::Type::BeginCachedLayer)
+		{
+			auto& frameLayer = frameCachedLayers[DrawCommand::getPayload<DrawCommand::CmdCachedLayer>(header).index];
+			auto& layer = *frameLayer.layer;
+			u64 hash = 14695981039346656037ull;
+			u32 end = i + 1;
+
+			// the contents depend on the state they start with too
+			hash = hashValue(hash, frameLayer.rect);
+			hash = hashChunkState(hash, state);
+
+			for (; end < commandCount; end++)
+			{
+				auto contentHeader = drawCommands.getHeader(commandOrder[end]);
+
+				if (contentHeader->type == DrawCommand::Type::EndCachedLayer)
+					break;
+
+				hash = hashDrawCommand(hash, contentHeader);
+			}
+
+			frameLayer.composite = prepareCachedLayerRenderTarget(layer, frameLayer.rect);
+
+			if (frameLayer.composite)
+			{
+				if (!layer.valid || layer.contentHash != hash)
+				{
+					renderCachedLayer(frameLayer, state, i + 1, end - i - 1);
+					layer.contentHash = hash;
+					layer.valid = true;
+					frameStats.redrawnCachedLayerCount++;
+				}
+
+				frameStats.cachedLayerCount++;
+			}
+		}
+
+		updateChunkState(state, header);
+	}
+
+	// the frame's commands are executed from the start
+	currentColor = startState.color;
+	currentFont = startState.font;
+	currentClipRect = startState.clipRect;
+	currentAtlas = startState.atlas;
+	currentTextStyle = startState.textStyle;
+	currentLineStyle = startState.lineStyle;
+	currentFillStyle = startState.fillStyle;
+	skipCachedLayerCommands = false;
+	currentBatch = nullptr;
+	batches.clear();
+	vertexBufferData.drawVertexCount = 0;
+	quadQueue.count = 0;
+}
+
+void Renderer::renderCachedLayer(const FrameCachedLayer& frameLayer, const ChunkState& state, u32 firstCommand, u32 commandCount)
+{
+	auto& layer = *frameLayer.layer;
+
+	currentColor = state.color;
+	currentFont = state.font;
+	currentClipRect = state.clipRect;
+	currentAtlas = state.atlas;
+	currentTextStyle = state.textStyle;
+	currentLineStyle = state.lineStyle;
+	currentFillStyle = state.fillStyle;
+	skipCachedLayerCommands = false;
+	currentBatch = nullptr;
+	batches.clear();
+	vertexBufferData.drawVertexCount = 0;
+	quadQueue.count = 0;
+
+	if (currentAtlas)
+	{
+		addBatch();
+	}
+
+	for (u32 i = 0; i < commandCount; i++)
+	{
+		executeDrawCommand(drawCommands.getHeader(commandOrder[firstCommand + i]));
+	}
+
+	flushQuadQueue();
+
+	// the render target's top-left corner is the layer's top-left corner
+	for (u32 i = 0; i < vertexBufferData.drawVertexCount; i++)
+	{
+		auto& position = vertexBufferData[i].position;
+
+		position.x -= frameLayer.rect.x;
+		position.y -= frameLayer.rect.y;
+	}
+
+	endPhase(FramePhase::Tessellate);
+	mergeBatches();
+	endPhase(FramePhase::Merge);
+	uploadVertices();
+	endPhase(FramePhase::Upload);
+
+	Point size(layer.width, layer.height);
+
+	ctx->gfx->setRenderTarget(layer.renderTarget);
+	ctx->gfx->setViewport(size, { 0, 0, size.x, size.y });
+	ctx->gfx->clear(Color(0, 0, 0, 0));
+	ctx->gfx->draw(drawBatches.data(), drawBatches.size());
+	ctx->gfx->setRenderTarget(nullptr);
+	ctx->gfx->setViewport(windowSize, getWindowRect());
+	endPhase(FramePhase::Submit);
+	frameStats.drawnBatchCount += drawBatches.size();
+	frameStats.vertexCount += vertexBufferData.drawVertexCount;
+}
+
+bool Renderer::prepareCachedLayerRenderTarget(CachedLayer& layer, const Rect& rect)
+{
+	u32 width = rect.width;
+	u32 height = rect.height;
+
+	if (!width || !height)
+	{
+		return false;
+	}
+
+	if (layer.width == width && layer.height == height)
+	{
+		return layer.textureArray != nullptr;
+	}
+
+	destroyCachedLayer(layer);
+	layer.renderTarget = ctx->gfx->createRenderTarget(width, height);
+	layer.textureArray = layer.renderTarget ? ctx->gfx->getRenderTargetTextureArray(layer.renderTarget) : nullptr;
+	layer.width = width;
+	layer.height = height;
+
+	return layer.textureArray != nullptr;
+}
+
+void Renderer::destroyCachedLayer(CachedLayer& layer)
+{
+	if (layer.renderTarget)
+	{
+		ctx->gfx->destroyRenderTarget(layer.renderTarget);
+	}
+
+	layer.renderTarget = nullptr;
+	layer.textureArray = nullptr;
+	layer.valid = false;
+}
+
+void Renderer::drawCachedLayer(const FrameCachedLayer& frameLayer)
+{
+	Rect rect = frameLayer.rect;
+	Rect uvRect(0, 0, 1, 1);
+
+	if (!currentAtlas || !clipRectNoRot(rect, uvRect))
+	{
+		return;
+	}
+
+	u32 color = currentColor;
+	u32 textureIndex = atlasTextureIndex;
+
+	// a batch with the render target's texture, then continue with the current atlas
+	flushQuadQueue();
+	addBatch();
+	currentBatch->atlas = nullptr;
+	currentBatch->textureArray = frameLayer.layer->textureArray;
+	currentColor = Color::white.getRgba();
+	atlasTextureIndex = 0;
+	drawQuad(rect, uvRect);
+	currentColor = color;
+	atlasTextureIndex = textureIndex;
+	addBatch();
+}
+
+void Renderer::endPhase(FramePhase phase)
+{
+	auto now = std::chrono::high_resolution_clock::now();
+
+	frameStats.phaseTime[(u32)phase] += std::chrono::duration<f64, std::milli>(now - phaseStartTime).count();
+	phaseStartTime = now;
+}
+
+void Renderer::addPhaseTimesToHistory()
+{
+	const u32 phaseCount = (u32)FramePhase::Count;
+	const u32 historySize = std::max(1u, ctx->settings.frameStatsHistorySize);
+
+	if (phaseTimeHistory.size() != historySize * phaseCount)
+	{
+		phaseTimeHistory.clear();
+		phaseTimeHistory.resize(historySize * phaseCount);
+		phaseTimeHistoryIndex = 0;
+		phaseTimeHistoryCount = 0;
+	}
+
+	memcpy(&phaseTimeHistory[phaseTimeHistoryIndex * phaseCount], frameStats.phaseTime, sizeof(frameStats.phaseTime));
+	phaseTimeHistoryIndex = (phaseTimeHistoryIndex + 1) % historySize;
+	phaseTimeHistoryCount = std::min(phaseTimeHistoryCount + 1, historySize);
+}
+
+FramePhaseTiming Renderer::getFramePhaseTiming(FramePhase phase) const
+{
+	FramePhaseTiming timing;
+
+	if (!phaseTimeHistoryCount)
+	{
+		return timing;
+	}
+
+	const u32 phaseCount = (u32)FramePhase::Count;
+	std::vector<f64> times(phaseTimeHistoryCount);
+	f64 total = 0;
+
+	for (u32 i = 0; i < phaseTimeHistoryCount; i++)
+	{
+		times[i] = phaseTimeHistory[i * phaseCount + (u32)phase];
+		total += times[i];
+	}
+
+	u32 p99Index = (phaseTimeHistoryCount * 99 + 99) / 100 - 1;
+
+	std::nth_element(times.begin(), times.begin() + p99Index, times.end());
+	timing.p99 = times[p99Index];
+	timing.min = *std::min_element(times.begin(), times.end());
+	timing.average = total / phaseTimeHistoryCount;
+
+	return timing;
+}
+
+u32 Renderer::addDrawCmdInsertionPoint()
+{
+	DrawCommandBuffer::InsertionPoint point;
+
+	point.zOrder = zOrder;
+	point.position = getCurrentLayer().entries.size();
+	drawCommands.insertionPoints.push_back(point);
+
+	return drawCommands.insertionPoints.size() - 1;
+}
+
+void Renderer::beginDrawCmdInsertion(u32 insertionPoint)
+{
+	if (insertionPoint >= drawCommands.insertionPoints.size())
+	{
+		return;
+	}
+
+	auto& point = drawCommands.insertionPoints[insertionPoint];
+	DrawCommandBuffer::Splice splice;
+
+	spliceLayerIndex = drawCommands.getLayerIndex(point.zOrder);
+
+	auto& layer = drawCommands.layers[spliceLayerIndex];
+
+	splice.position = point.position;
+	splice.insertionPoint = insertionPoint;
+	splice.start = layer.splicedEntries.size();
+	layer.splices.push_back(splice);
+	currentSpliceIndex = layer.splices.size() - 1;
+}
+
+void Renderer::beginCachedLayer(u64 key, const Rect& rect)
+{
+	// the nested layers are drawn as part of the outer layer
+	if (cachedLayerDepth++)
+	{
+		pushClipRect(rect);
+		return;
+	}
+
+	FrameCachedLayer frameLayer;
+	auto& layer = cachedLayers[key];
+	f32 x = floorf(rect.x);
+	f32 y = floorf(rect.y);
+
+	layer.lastUsedFrame = ctx->frameCount;
+	frameLayer.layer = &layer;
+	// aligned to pixels, so the render target's texels map to the window's pixels
+	frameLayer.rect = { x, y, ceilf(rect.right()) - x, ceilf(rect.bottom()) - y };
+	frameCachedLayers.push_back(frameLayer);
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdCachedLayer>(DrawCommand::Type::BeginCachedLayer);
+
+	cmd.index = frameCachedLayers.size() - 1;
+	pushClipRect(frameLayer.rect);
+}
+
+void Renderer::endCachedLayer()
+{
+	if (!cachedLayerDepth)
+	{
+		return;
+	}
+
+	popClipRect();
+
+	if (--cachedLayerDepth)
+	{
+		return;
+	}
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdCachedLayer>(DrawCommand::Type::EndCachedLayer);
+
+	cmd.index = frameCachedLayers.size() - 1;
+}
+
+void Renderer::invalidateCachedLayer(u64 key)
+{
+	auto iter = cachedLayers.find(key);
+
+	if (iter != cachedLayers.end())
+	{
+		iter->second.valid = false;
+	}
+}
+
+void Renderer::executeLayer(DrawCommandBuffer::Layer& layer)
+{
+	forEachLayerCommand(layer, [this](u32 offset) { executeDrawCommand(drawCommands.getHeader(offset)); });
+}
+
+template<typename F>
+void Renderer::forEachLayerCommand(DrawCommandBuffer::Layer& layer, F func)
+{
+	if (layer.splices.empty())
+	{
+		for (auto offset : layer.entries)
+		{
+			func(offset);
+		}
+
+		return;
+	}
+
+	// nested boxes add their splices inner first, so order them by position and then by insertion point,
+	// there is one splice per box, much less than the command count
+	std::sort(
+		layer.splices.begin(), layer.splices.end(),
+		[](const DrawCommandBuffer::Splice& a, const DrawCommandBuffer::Splice& b)
+		{
+			if (a.position != b.position)
+				return a.position < b.position;
+
+			return a.insertionPoint < b.insertionPoint;
+		});
+
+	u32 spliceIndex = 0;
+	u32 entryCount = layer.entries.size();
+
+	for (u32 i = 0; i <= entryCount; i++)
+	{
+		while (spliceIndex < layer.splices.size() && layer.splices[spliceIndex].position == i)
+		{
+			auto& splice = layer.splices[spliceIndex];
+
+			for (u32 j = 0; j < splice.count; j++)
+			{
+				func(layer.splicedEntries[splice.start + j]);
+			}
+
+			spliceIndex++;
+		}
+
+		if (i < entryCount)
+		{
+			func(layer.entries[i]);
+		}
+	}
+}
+
+void Renderer::generateVerticesParallel(u32 threadCount)
+{
+	workerPool.setThreadCount(threadCount);
+	commandOrder.clear();
+
+	for (auto& layer : drawCommands.layers)
+	{
+		forEachLayerCommand(layer, [this](u32 offset) { commandOrder.push_back(offset); });
+	}
+
+	const u32 chunkCount = workerPool.getThreadCount();
+	const u32 commandCount = commandOrder.size();
+	ChunkState state;
+
+	// the state left by the recording, the same the serial path starts with
+	state.color = currentColor;
+	state.font = currentFont;
+	state.clipRect = currentClipRect;
+	state.atlas = currentAtlas;
+	state.textStyle = currentTextStyle;
+	state.lineStyle = currentLineStyle;
+	state.fillStyle = currentFillStyle;
+	chunkStates.resize(chunkCount);
+
+	// walk the state commands to snapshot the state at each chunk start, mirroring executeDrawCommand,
+	// the text glyphs are cached here too, since a new glyph changes the font and its atlas
+	for (u32 chunkIndex = 0, i = 0; chunkIndex < chunkCount; chunkIndex++)
+	{
+		u32 chunkEnd = (u64)commandCount * (chunkIndex + 1) / chunkCount;
+
+		state.firstCommand = i;
+		state.commandCount = chunkEnd - i;
+		chunkStates[chunkIndex] = state;
+
+		for (; i < chunkEnd; i++)
+		{
+			auto header = drawCommands.getHeader(commandOrder[i]);
+
+			updateChunkState(state, header);
+
+			if (header->type == DrawCommand::Type::DrawText)
+			{
+				auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawText>(header);
+
+				if (cmd.unicodeText)
+					cacheTextGlyphs(state.font, *cmd.unicodeText, state.textStyle.underline);
+			}
+		}
+	}
+
+	while (chunkRenderers.size() < chunkCount)
+	{
+		chunkRenderers.push_back(new Renderer(this));
+	}
+
+	workerPool.run(chunkCount, [this](u32 chunkIndex)
+	{
+		chunkRenderers[chunkIndex]->executeChunk(chunkStates[chunkIndex]);
+	});
+
+	// stitch the chunks' vertices and batches in order
+	const u32 pageSize = VertexBufferData::pageVertexCount;
+
+	for (u32 chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+	{
+		auto chunk = chunkRenderers[chunkIndex];
+		auto& chunkVertices = chunk->vertexBufferData;
+		const u32 baseVertexIndex = vertexBufferData.drawVertexCount;
+		const u32 vertexCount = chunkVertices.drawVertexCount;
+
+		needToAddVertexCount(vertexCount);
+
+		for (u32 i = 0; i < vertexCount;)
+		{
+			u32 count = std::min(
+				std::min(pageSize - (baseVertexIndex + i) % pageSize, pageSize - i % pageSize),
+				vertexCount - i);
+
+			std::copy(&chunkVertices[i], &chunkVertices[i] + count, &vertexBufferData[baseVertexIndex + i]);
+			i += count;
+		}
+
+		vertexBufferData.drawVertexCount += vertexCount;
+
+		for (u32 i = 0; i < chunk->batches.size(); i++)
+		{
+			auto batch = chunk->batches[i];
+
+			// the first batch continues the previous chunk's last batch, as it would serially
+			if (i == 0 && !batches.empty()
+				&& batches.back().atlas == batch.atlas
+				&& batches.back().textureArray == batch.textureArray)
+			{
+				batches.back().vertexCount += batch.vertexCount;
+				batches.back().indexCount += batch.indexCount;
+				continue;
+			}
+
+			batch.startVertexIndex += baseVertexIndex;
+			batch.startIndex = batch.startVertexIndex / 4 * 6;
+			batch.vertexBuffer = vertexBuffer;
+			batch.indexBuffer = indexBuffer;
+			batches.push_back(batch);
+		}
+	}
+
+	// leave the state as the serial path would
+	currentColor = state.color;
+	currentFont = state.font;
+	currentClipRect = state.clipRect;
+	currentAtlas = state.atlas;
+	currentTextStyle = state.textStyle;
+	currentLineStyle = state.lineStyle;
+	currentFillStyle = state.fillStyle;
+	currentBatch = batches.empty() ? nullptr : &batches.back();
+}
+
+void Renderer::executeChunk(const ChunkState& state)
+{
+	currentColor = state.color;
+	currentFont = state.font;
+	currentClipRect = state.clipRect;
+	currentAtlas = state.atlas;
+	currentTextStyle = state.textStyle;
+	currentLineStyle = state.lineStyle;
+	currentFillStyle = state.fillStyle;
+	skipCachedLayerCommands = state.skipCachedLayerCommands;
+	shaderClipping = mainRenderer->shaderClipping;
+	shaderShapes = mainRenderer->shaderShapes;
+	glyphRunCache = mainRenderer->glyphRunCache;
+	currentClipRectIndex = shaderClipping ? state.clipRectIndex : 0;
+	currentBatch = nullptr;
+	batches.clear();
+	vertexBufferData.drawVertexCount = 0;
+	quadQueue.count = 0;
+	frameArena.reset();
+
+	if (currentAtlas)
+	{
+		addBatch();
+	}
+
+	for (u32 i = 0; i < state.commandCount; i++)
+	{
+		executeDrawCommand(executedCommands->getHeader(mainRenderer->commandOrder[state.firstCommand + i]));
+	}
+
+	flushQuadQueue();
+}
+
+void Renderer::updateChunkState(ChunkState& state, DrawCommand::Header* header)
+{
+	switch (header->type)
+	{
+	case DrawCommand::Type::SetColor:
+		state.color = DrawCommand::getPayload<DrawCommand::CmdSetColor>(header).color;
+		break;
+	case DrawCommand::Type::SetFont:
+		state.font = DrawCommand::getPayload<DrawCommand::CmdSetFont>(header).font;
+		break;
+	case DrawCommand::Type::ClipRect:
+		state.clipRect = DrawCommand::getPayload<DrawCommand::CmdClipRect>(header).rect;
+		state.clipRectIndex = DrawCommand::getPayload<DrawCommand::CmdClipRect>(header).index;
+		break;
+	case DrawCommand::Type::SetTextStyle:
+		state.textStyle = drawCommands.textStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex];
+		break;
+	case DrawCommand::Type::SetLineStyle:
+		state.lineStyle = drawCommands.lineStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex];
+		break;
+	case DrawCommand::Type::SetFillStyle:
+		state.fillStyle = drawCommands.fillStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex];
+		break;
+	case DrawCommand::Type::SetAtlas:
+		state.atlas = DrawCommand::getPayload<DrawCommand::CmdSetAtlas>(header).atlas;
+		break;
+	case DrawCommand::Type::DrawLine:
+	case DrawCommand::Type::DrawPolyLine:
+		state.color = state.lineStyle.color.getRgba();
+		break;
+	case DrawCommand::Type::DrawSolidTriangle:
+		state.color = state.fillStyle.color.getRgba();
+		break;
+	case DrawCommand::Type::BeginCachedLayer:
+	{
+		u32 index = DrawCommand::getPayload<DrawCommand::CmdCachedLayer>(header).index;
+
+		state.skipCachedLayerCommands = index < frameCachedLayers.size() && frameCachedLayers[index].composite;
+		break;
+	}
+	case DrawCommand::Type::EndCachedLayer:
+		state.skipCachedLayerCommands = false;
+		break;
+	default:
+		break;
+	}
+}
+
+void Renderer::cacheTextGlyphs(UiFont* font, const UnicodeString& text, bool underline)
+{
+	// the run is laid out and marked as used here, the chunk renderers only find it
+	if (glyphRunCache)
+	{
+		font->getGlyphRun(text);
+		return;
+	}
+
+	GlyphCode lastChr = 0;
+
+	// the same lookups as drawTextInternal
+	for (auto chr : text)
+	{
+		if (chr == '\n')
+		{
+			continue;
+		}
+
+		auto glyph = font->getGlyph(chr);
+		auto img = font->getGlyphImage(chr);
+
+		if (!glyph || !img)
+		{
+			continue;
+		}
+
+		font->getKerning(lastChr, chr);
+		lastChr = chr;
+	}
+
+	if (underline)
+	{
+		font->computeTextSize(text);
+	}
+}
+
+void Renderer::executeDrawCommand(DrawCommand::Header* header)
+{
+	// the layer is drawn from its render target, only keep the state its commands change
+	if (skipCachedLayerCommands)
+	{
+		switch (header->type)
+		{
+		case DrawCommand::Type::DrawLine:
+		case DrawCommand::Type::DrawPolyLine:
+			currentColor = currentLineStyle.color.getRgba();
+			return;
+		case DrawCommand::Type::DrawSolidTriangle:
+			currentColor = currentFillStyle.color.getRgba();
+			return;
+		case DrawCommand::Type::DrawRect:
+		case DrawCommand::Type::DrawQuad:
+		case DrawCommand::Type::DrawImageBordered:
+		case DrawCommand::Type::DrawText:
+		case DrawCommand::Type::DrawInterpolatedColors:
+		case DrawCommand::Type::DrawSpectrumColors:
+		case DrawCommand::Type::DrawShape:
+			return;
+		default:
+			break;
+		}
+	}
+
+	switch (header->type)
+	{
+	case DrawCommand::Type::DrawImageBordered:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawImageBordered>(header);
+		drawImageBordered(cmd.image, cmd.border, cmd.rect, cmd.scale);
+		break;
+	}
+	case DrawCommand::Type::DrawQuad:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawQuad>(header);
+		drawQuad(cmd.image, cmd.corners[0], cmd.corners[1], cmd.corners[2], cmd.corners[3]);
+		break;
+	}
+	case DrawCommand::Type::DrawRect:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawRect>(header);
+		Rect rect = cmd.rect;
+		Rect uvRect = cmd.uvRect;
+
+		atlasTextureIndex = cmd.textureIndex;
+
+		if (!cmd.rotated)
+		{
+			queueQuad(rect, uvRect);
+		}
+		else if (clipRectRot(rect, uvRect))
+		{
+			drawQuadRot90(rect, uvRect);
+		}
+		break;
+	}
+	case DrawCommand::Type::DrawInterpolatedColors:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawInterpolatedColors>(header);
+		drawInterpolatedColors(cmd.rect, cmd.topLeft, cmd.bottomLeft, cmd.topRight, cmd.bottomRight);
+		break;
+	}
+	case DrawCommand::Type::DrawSpectrumColors:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawSpectrumColors>(header);
+		drawSpectrumColors(
+			cmd.rect,
+			cmd.brightness ? DrawSpectrumBrightness::On : DrawSpectrumBrightness::Off,
+			cmd.vertical ? DrawSpectrumDirection::Vertical : DrawSpectrumDirection::Horizontal);
+		break;
+	}
+	case DrawCommand::Type::DrawText:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawText>(header);
+		if (cmd.unicodeText)
+			drawTextInternal(*cmd.unicodeText, cmd.position);
+		break;
+	}
+	case DrawCommand::Type::DrawShape:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawShape>(header);
+		drawShape(cmd.rect, cmd.shape, cmd.index);
+		break;
+	}
+	case DrawCommand::Type::SetColor:
+		currentColor = DrawCommand::getPayload<DrawCommand::CmdSetColor>(header).color;
+		break;
+	case DrawCommand::Type::SetFont:
+		currentFont = DrawCommand::getPayload<DrawCommand::CmdSetFont>(header).font;
+		break;
+	case DrawCommand::Type::ClipRect:
+		flushQuadQueue();
+		currentClipRect = DrawCommand::getPayload<DrawCommand::CmdClipRect>(header).rect;
+		currentClipRectIndex = shaderClipping ? DrawCommand::getPayload<DrawCommand::CmdClipRect>(header).index : 0;
+		break;
+	case DrawCommand::Type::SetTextStyle:
+		currentTextStyle = executedCommands->textStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex];
+		break;
+	case DrawCommand::Type::SetLineStyle:
+		currentLineStyle = executedCommands->lineStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex];
+		break;
+	case DrawCommand::Type::SetFillStyle:
+		currentFillStyle = executedCommands->fillStyles[DrawCommand::getPayload<DrawCommand::CmdSetStyle>(header).styleIndex];
+		break;
+	case DrawCommand::Type::DrawLine:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawLine>(header);
+		currentColor = currentLineStyle.color.getRgba();
+		drawLine(cmd.a, cmd.b);
+		break;
+	}
+	case DrawCommand::Type::DrawPolyLine:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawPolyLine>(header);
+		currentColor = currentLineStyle.color.getRgba();
+		drawPolyLine(cmd.points, cmd.count, cmd.closed);
+		break;
+	}
+	case DrawCommand::Type::DrawSolidTriangle:
+	{
+		auto& cmd = DrawCommand::getPayload<DrawCommand::CmdDrawTriangle>(header);
+		currentColor = currentFillStyle.color.getRgba();
+		drawTriangle(cmd.p1, cmd.p2, cmd.p3, cmd.uv1, cmd.uv2, cmd.uv3, cmd.image);
+		break;
+	}
+	case DrawCommand::Type::SetAtlas:
+	{
+		auto atlas = DrawCommand::getPayload<DrawCommand::CmdSetAtlas>(header).atlas;
+
+		if (currentAtlas != atlas)
+		{
+			flushQuadQueue();
+			currentAtlas = atlas;
+			addBatch();
+		}
+		break;
+	}
+	case DrawCommand::Type::BeginCachedLayer:
+	{
+		auto& layers = mainRenderer ? mainRenderer->frameCachedLayers : frameCachedLayers;
+		u32 index = DrawCommand::getPayload<DrawCommand::CmdCachedLayer>(header).index;
+
+		// the captured frames don't have the cached layers, their commands are executed
+		if (index < layers.size() && layers[index].composite)
+		{
+			drawCachedLayer(layers[index]);
+			skipCachedLayerCommands = true;
+		}
+		break;
+	}
+	case DrawCommand::Type::EndCachedLayer:
+		skipCachedLayerCommands = false;
+		break;
+	}
+}
+
+void Renderer::cmdSetColor(const Color& newColor)
+{
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetColor>(DrawCommand::Type::SetColor);
+	cmd.color = newColor.getRgba();
+}
+
+void Renderer::cmdSetAtlas(UiAtlas* newAtlas)
+{
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetAtlas>(DrawCommand::Type::SetAtlas);
+	cmd.atlas = newAtlas;
+	currentAtlas = newAtlas;
+}
+
+void Renderer::cmdSetFont(UiFont* font)
+{
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetFont>(DrawCommand::Type::SetFont);
+	cmd.font = font;
+	currentFont = font;
+}
+
+void Renderer::cmdSetTextUnderline(bool underline)
+{
+	currentTextStyle.underline = underline;
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetStyle>(DrawCommand::Type::SetTextStyle);
+	cmd.styleIndex = drawCommands.addTextStyle(currentTextStyle);
+}
+
+void Renderer::cmdSetTextBackfill(bool backfill)
+{
+	currentTextStyle.backFill = backfill;
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetStyle>(DrawCommand::Type::SetTextStyle);
+	cmd.styleIndex = drawCommands.addTextStyle(currentTextStyle);
+}
+
+void Renderer::cmdSetTextBackfillColor(const Color& color)
+{
+	currentTextStyle.backFillColor = color;
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetStyle>(DrawCommand::Type::SetTextStyle);
+	cmd.styleIndex = drawCommands.addTextStyle(currentTextStyle);
+}
+
+void Renderer::cmdSetLineStyle(const LineStyle& style)
+{
+	currentLineStyle = style;
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetStyle>(DrawCommand::Type::SetLineStyle);
+	cmd.styleIndex = drawCommands.addLineStyle(style);
+}
+
+void Renderer::cmdSetFillStyle(const FillStyle& style)
+{
+	currentFillStyle = style;
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetStyle>(DrawCommand::Type::SetFillStyle);
+	cmd.styleIndex = drawCommands.addFillStyle(style);
+}
+
+bool Renderer::isRectVisible(const Rect& rect) const
+{
+	// the commands inserted at an insertion point are executed with the clip rect set there, not the current one
+	if (currentSpliceIndex != ~0u)
+		return true;
+
+	return !rect.outside(currentClipRect);
+}
+
+bool Renderer::cullDrawCommand(const Rect& bounds)
+{
+	if (isRectVisible(bounds))
+		return false;
+
+	frameStats.culledDrawCommandCount++;
+
+	return true;
+}
+
+void Renderer::addCulledDrawCommandColor(const Color& color)
+{
+	auto& cmd = addDrawCommand<DrawCommand::CmdSetColor>(DrawCommand::Type::SetColor);
+	cmd.color = color.getRgba();
+}
+
+void Renderer::cmdDrawImage(UiImage* image, const Point& position, f32 scale)
+{
+	Rect rect(position.x, position.y, image->rect.width * scale, image->rect.height * scale);
+
+	if (image->isShape)
+	{
+		cmdDrawShape(image->shape, rect, scale);
+		return;
+	}
+
+	if (cullDrawCommand(rect))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawRect>(DrawCommand::Type::DrawRect);
+	cmd.rect = rect;
+	cmd.uvRect = image->uvRect;
+	cmd.rotated = image->rotated;
+	cmd.textureIndex = image->atlasTexture->textureIndex;
+}
+
+void Renderer::cmdDrawImage(UiImage* image, const Rect& rect)
+{
+	if (image->isShape)
+	{
+		cmdDrawShape(image->shape, rect, ctx->globalScale);
+		return;
+	}
+
+	if (cullDrawCommand(rect))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawRect>(DrawCommand::Type::DrawRect);
+	cmd.rect = rect;
+	cmd.uvRect = image->uvRect;
+	cmd.rotated = image->rotated;
+	cmd.textureIndex = image->atlasTexture->textureIndex;
+}
+
+void Renderer::cmdDrawImage(UiImage* image, const Rect& rect, const Rect& uvRect)
+{
+	if (image->isShape)
+	{
+		cmdDrawShape(image->shape, rect, ctx->globalScale);
+		return;
+	}
+
+	if (cullDrawCommand(rect))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawRect>(DrawCommand::Type::DrawRect);
+	cmd.rect = rect;
+	cmd.uvRect = uvRect;
+	cmd.rotated = image->rotated;
+	cmd.textureIndex = image->atlasTexture->textureIndex;
+}
+
+void Renderer::cmdDrawQuad(UiImage* image, const Point& p1, const Point& p2, const Point& p3, const Point& p4)
+{
+	Point corners[4] = { p1, p2, p3, p4 };
+
+	if (cullDrawCommand(getPointsBounds(corners, 4, 0)))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawQuad>(DrawCommand::Type::DrawQuad);
+	cmd.corners[0] = p1;
+	cmd.corners[1] = p2;
+	cmd.corners[2] = p3;
+	cmd.corners[3] = p4;
+	// the shapes cannot be mapped on arbitrary quads, they're filled instead
+	cmd.image = image->isShape ? currentAtlas->whiteImage : image;
+}
+
+void Renderer::cmdDrawImageBordered(UiImage* image, u32 border, const Rect& rect, f32 scale)
+{
+	// a shape is a single quad at any size, it doesn't need the 9 cells
+	if (image->isShape)
+	{
+		cmdDrawShape(image->shape, rect, scale);
+		return;
+	}
+
+	if (cullDrawCommand(rect))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawImageBordered>(DrawCommand::Type::DrawImageBordered);
+	cmd.rect = rect;
+	cmd.image = image;
+	cmd.border = border;
+	cmd.scale = scale;
+}
+
+void Renderer::cmdDrawImageScaledAligned(UiImage* image, const Rect& rect, HAlignType halign, VAlignType valign, f32 scale)
+{
+	f32 newWidth = image->rect.width * scale;
+	f32 newHeight = image->rect.height * scale;
+	Rect newRect = { rect.x, rect.y, newWidth, newHeight };
 
 	switch (halign)
 	{
@@ -796,21 +2353,67 @@ void Renderer::cmdDrawSolidRectangle(const Rect& rect)
 	cmdDrawImage(image, rect, uvRect);
 }
 
+void Renderer::cmdDrawShape(const Shape& shape, const Rect& rect, f32 scale)
+{
+	ShapeParameters params;
+	Rect shapeRect = rect;
+	f32 radius = std::min(rect.width, rect.height) / 2;
+
+	params.type = (u32)shape.type;
+	params.borderWidth = shape.borderWidth * scale;
+	params.borderColor = shape.borderColor.getRgba();
+	params.startAngle = shape.startAngle;
+	params.endAngle = shape.endAngle;
+
+	if (shape.type == ShapeType::RoundedRectangle)
+	{
+		params.halfSize = { rect.width / 2, rect.height / 2 };
+		params.cornerRadius = std::min(shape.cornerRadius * scale, radius);
+	}
+	else
+	{
+		// the circles are centered in the rect, their quad is the square around them
+		Point center = rect.center();
+
+		shapeRect = { center.x - radius, center.y - radius, radius * 2, radius * 2 };
+		params.halfSize = { radius, radius };
+		params.cornerRadius = radius;
+
+		if (shape.type != ShapeType::Circle)
+			params.borderWidth = std::min(params.borderWidth, radius);
+	}
+
+	if (shapeRect.width <= 0 || shapeRect.height <= 0 || cullDrawCommand(shapeRect))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawShape>(DrawCommand::Type::DrawShape);
+	cmd.rect = shapeRect;
+	cmd.shape = params;
+	cmd.index = drawCommands.addShape(params);
+}
+
 void Renderer::cmdDrawInterpolatedColors(const Rect& rect, const Color& topLeft, const Color& bottomLeft, const Color& topRight, const Color& bottomRight)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawInterpolatedColors);
-	cmd.zOrder = zOrder;
-	cmd.drawInterpolatedColors.rect = rect;
-	cmd.drawInterpolatedColors.bottomLeft = bottomLeft;
-	cmd.drawInterpolatedColors.bottomRight = bottomRight;
-	cmd.drawInterpolatedColors.topLeft = topLeft;
-	cmd.drawInterpolatedColors.topRight = topRight;
-	addDrawCommand(cmd);
+	if (cullDrawCommand(rect))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawInterpolatedColors>(DrawCommand::Type::DrawInterpolatedColors);
+	cmd.rect = rect;
+	cmd.bottomLeft = bottomLeft;
+	cmd.bottomRight = bottomRight;
+	cmd.topLeft = topLeft;
+	cmd.topRight = topRight;
 }
 
 void Renderer::cmdDrawSpectrumColors(const Rect& rect, DrawSpectrumBrightness brightness, DrawSpectrumDirection dir)
 {
-	//TODO
+	if (cullDrawCommand(rect))
+		return;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawSpectrumColors>(DrawCommand::Type::DrawSpectrumColors);
+	cmd.rect = rect;
+	cmd.brightness = brightness == DrawSpectrumBrightness::On;
+	cmd.vertical = dir == DrawSpectrumDirection::Vertical;
 }
 
 void Renderer::cmdDrawInterpolatedColorsTopBottom(const Rect& rect, const Color& top, const Color& bottom)
@@ -825,51 +2428,73 @@ void Renderer::cmdDrawInterpolatedColorsLeftRight(const Rect& rect, const Color&
 
 void Renderer::cmdDrawLine(const Point& a, const Point& b)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawLine);
-	cmd.zOrder = zOrder;
-	cmd.drawLine.a = a;
-	cmd.drawLine.b = b;
-	addDrawCommand(cmd);
+	Point points[2] = { a, b };
+
+	if (cullDrawCommand(getPointsBounds(points, 2, currentLineStyle.width)))
+	{
+		addCulledDrawCommandColor(currentLineStyle.color);
+		return;
+	}
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawLine>(DrawCommand::Type::DrawLine);
+	cmd.a = a;
+	cmd.b = b;
 }
 
 void Renderer::cmdDrawPolyLine(const Point* points, u32 pointCount, bool closed)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawPolyLine);
-	cmd.zOrder = zOrder;
-	cmd.drawPolyLine.count = pointCount;
-	cmd.drawPolyLine.closed = closed;
-	cmd.drawPolyLine.points = &pointBuffer[pointBufferPosition];
-	memcpy(pointBuffer.data() + pointBufferPosition, points, pointCount * sizeof(Point));
-	pointBufferPosition += pointCount;
-	addDrawCommand(cmd);
+	if (pointCount && cullDrawCommand(getPointsBounds(points, pointCount, currentLineStyle.width)))
+	{
+		addCulledDrawCommandColor(currentLineStyle.color);
+		return;
+	}
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawPolyLine>(DrawCommand::Type::DrawPolyLine);
+	cmd.count = pointCount;
+	cmd.closed = closed;
+	cmd.points = frameArena.allocate<Point>(pointCount);
+	std::uninitialized_copy(points, points + pointCount, cmd.points);
 }
 
 void Renderer::cmdDrawSolidTriangle(const Point& p1, const Point& p2, const Point& p3)
 {
-	DrawCommand cmd(DrawCommand::Type::DrawSolidTriangle);
-	cmd.zOrder = zOrder;
-	cmd.drawTriangle.p1 = p1;
-	cmd.drawTriangle.p2 = p2;
-	cmd.drawTriangle.p3 = p3;
+	Point points[3] = { p1, p2, p3 };
+
+	if (cullDrawCommand(getPointsBounds(points, 3, 0)))
+	{
+		addCulledDrawCommandColor(currentFillStyle.color);
+		return;
+	}
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawTriangle>(DrawCommand::Type::DrawSolidTriangle);
+	cmd.p1 = p1;
+	cmd.p2 = p2;
+	cmd.p3 = p3;
 	auto uvRc =  ctx->theme->atlas->whiteImage->uvRect;
 	uvRc = uvRc.contract(ctx->settings.whiteImageUvBorder);
-	cmd.drawTriangle.uv1 = uvRc.topLeft();
-	cmd.drawTriangle.uv2 = uvRc.topRight();
-	cmd.drawTriangle.uv3 = uvRc.bottomRight();
-	cmd.drawTriangle.image = ctx->theme->atlas->whiteImage;
-	addDrawCommand(cmd);
+	cmd.uv1 = uvRc.topLeft();
+	cmd.uv2 = uvRc.topRight();
+	cmd.uv3 = uvRc.bottomRight();
+	cmd.image = ctx->theme->atlas->whiteImage;
 }
 
 FontTextSize Renderer::cmdDrawTextAt(
 	const char* text,
 	const Point& position)
 {
+	// measured without the text cache, so the culled texts are not cached and kept alive for this frame
 	FontTextSize fsize = currentFont->computeTextSize(text);
-	DrawCommand cmd(DrawCommand::Type::DrawText);
-	cmd.zOrder = zOrder;
-	cmd.drawText.position = position;
-	cmd.drawText.text = addUtf8TextToBuffer(text, strlen(text));
-	addDrawCommand(cmd);
+	Rect bounds = getTextBounds(position, fsize);
+
+	if (cullDrawCommand(bounds))
+		return fsize;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawText>(DrawCommand::Type::DrawText);
+	cmd.position = position;
+	cmd.text = addUtf8TextToBuffer(text, strlen(text));
+	// looked up with the caller's buffer, so the texts changing every frame are found
+	cmd.unicodeText = ctx->textCache->getText(text);
+	cmd.bounds = bounds;
 	return fsize;
 }
 
@@ -880,7 +2505,6 @@ FontTextSize Renderer::cmdDrawTextInBox(
 	VAlignType vertical)
 {
 	FontTextSize fsize = currentFont->computeTextSize(text);
-	DrawCommand cmd(DrawCommand::Type::DrawText);
 	Point pos;
 
 	switch (vertical)
@@ -915,13 +2539,36 @@ FontTextSize Renderer::cmdDrawTextInBox(
 		break;
 	}
 
-	cmd.zOrder = zOrder;
-	cmd.drawText.position = pos;
-	cmd.drawText.text = addUtf8TextToBuffer(text, strlen(text));
-	addDrawCommand(cmd);
+	Rect bounds = getTextBounds(pos, fsize);
+
+	if (cullDrawCommand(bounds))
+		return fsize;
+
+	auto& cmd = addDrawCommand<DrawCommand::CmdDrawText>(DrawCommand::Type::DrawText);
+	cmd.position = pos;
+	cmd.text = addUtf8TextToBuffer(text, strlen(text));
+	cmd.unicodeText = ctx->textCache->getText(text);
+	cmd.bounds = bounds;
 	return fsize;
 }
 
+Rect Renderer::getTextBounds(const Point& position, const FontTextSize& fsize)
+{
+	auto& metrics = currentFont->getMetrics();
+	// the glyphs can overhang their advance, and the position is rounded when drawn
+	f32 margin = ceilf(metrics.height * 0.25f) + 1;
+	f32 above = std::max(metrics.ascender, fsize.maxBearingY);
+	f32 below = std::max(
+		std::max(-metrics.descender, fsize.maxGlyphHeight - fsize.maxBearingY),
+		metrics.underlineThickness - metrics.underlinePosition);
+
+	return {
+		position.x - margin,
+		position.y - above - margin,
+		fsize.width + margin * 2,
+		above + below + margin * 2 };
+}
+
 void Renderer::drawAtlasRegion(bool rotated, const Rect& rect, const Rect& uvRect)
 {
 	Rect newRect = rect, newUvRect = uvRect;
@@ -937,83 +2584,70 @@ void Renderer::drawAtlasRegion(bool rotated, const Rect& rect, const Rect& uvRec
 		drawQuad(newRect, newUvRect);
 }
 
-void Renderer::drawTextGlyph(UiImage* image, const Point& position)
+void Renderer::drawTextGlyph(UiImage* image, const Point& position, f32 scale, u32 textureIndexFlags)
 {
-	atlasTextureIndex = image->atlasTexture->textureIndex;
+	atlasTextureIndex = image->atlasTexture->textureIndex | textureIndexFlags;
 	Rect rect = Rect(
 		position.x,
 		position.y,
-		image->rect.width,
-		image->rect.height);
+		image->rect.width * scale,
+		image->rect.height * scale);
 	Rect uvRect = image->uvRect;
 
-	if (!clipRect(image->rotated, rect, uvRect))
+	if (!image->rotated)
+	{
+		queueQuad(rect, uvRect);
 		return;
+	}
 
-	if (image->rotated)
+	if (clipRectRot(rect, uvRect))
 		drawQuadRot90(rect, uvRect);
-	else
-		drawQuad(rect, uvRect);
 }
 
 void Renderer::drawQuad(UiImage* image, const Point& p1, const Point& p2, const Point& p3, const Point& p4)
 {
-	drawTriangle(p1, p2, p3, image->uvRect.topLeft(), image->uvRect.topRight(), image->uvRect.bottomRight(), image);
-	drawTriangle(p1, p3, p4, image->uvRect.topLeft(), image->uvRect.bottomRight(), image->uvRect.bottomLeft(), image);
+	drawQuad(
+		p1, p2, p3, p4,
+		image->uvRect.topLeft(), image->uvRect.topRight(), image->uvRect.bottomRight(), image->uvRect.bottomLeft(),
+		image);
 }
 
-void Renderer::drawQuad(const Rect& rect, const Rect& uvRect)
+void Renderer::drawQuad(
+	const Point& p1, const Point& p2, const Point& p3, const Point& p4,
+	const Point& uv1, const Point& uv2, const Point& uv3, const Point& uv4,
+	UiImage* image)
 {
-	needToAddVertexCount(6);
-
-	u32 i = vertexBufferData.drawVertexCount;
-
-	vertexBufferData.vertices[i].position = rect.topLeft();
-	vertexBufferData.vertices[i].uv = uvRect.topLeft();
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].uv = uvRect.topRight();
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].uv = uvRect.bottomLeft();
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
+	// when the quad is not clipped or is clipped in the shader, draw it directly as a 4 point fan, otherwise clip its triangles
+	if (currentClipRectIndex
+		|| (computeLineClipCode(p1, currentClipRect) == LineClipBit::Inside
+			&& computeLineClipCode(p2, currentClipRect) == LineClipBit::Inside
+			&& computeLineClipCode(p3, currentClipRect) == LineClipBit::Inside
+			&& computeLineClipCode(p4, currentClipRect) == LineClipBit::Inside))
+	{
+		Point pts[] = { p1, p2, p3, p4 };
+		Point uvPts[] = { uv1, uv2, uv3, uv4 };
 
-	// 2nd triangle
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].uv = uvRect.topRight();
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
+		atlasTextureIndex = image->atlasTexture->textureIndex;
+		drawTriangleFan(pts, uvPts, 4);
+		return;
+	}
 
-	vertexBufferData.vertices[i].position = rect.bottomRight();
-	vertexBufferData.vertices[i].uv = uvRect.bottomRight();
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
+	drawTriangle(p1, p2, p3, uv1, uv2, uv3, image);
+	drawTriangle(p1, p3, p4, uv1, uv3, uv4, image);
+}
 
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].uv = uvRect.bottomLeft();
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
+void Renderer::drawQuad(const Rect& rect, const Rect& uvRect)
+{
+	auto v = addQuadVertices();
 
-	vertexBufferData.drawVertexCount = i;
-	currentBatch->vertexCount += 6;
+	setVertex(v[0], rect.topLeft(), uvRect.topLeft(), currentColor, atlasTextureIndex, currentClipRectIndex);
+	setVertex(v[1], rect.topRight(), uvRect.topRight(), currentColor, atlasTextureIndex, currentClipRectIndex);
+	setVertex(v[2], rect.bottomLeft(), uvRect.bottomLeft(), currentColor, atlasTextureIndex, currentClipRectIndex);
+	setVertex(v[3], rect.bottomRight(), uvRect.bottomRight(), currentColor, atlasTextureIndex, currentClipRectIndex);
 }
 
 void Renderer::drawQuadRot90(const Rect& rect, const Rect& uvRect)
 {
-	needToAddVertexCount(6);
-
-	u32 i = vertexBufferData.drawVertexCount;
 	Point t0(uvRect.topLeft());
 	Point t1(uvRect.topRight());
 	Point t2(uvRect.right(), uvRect.bottom());
@@ -1024,90 +2658,75 @@ void Renderer::drawQuadRot90(const Rect& rect, const Rect& uvRect)
 	//  |  /     |
 	// t2-------t1
 
-	vertexBufferData.vertices[i].position = rect.topLeft();
-	vertexBufferData.vertices[i].uv = t3;
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].uv = t0;
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].uv = t2;
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	// 2nd triangle
+	auto v = addQuadVertices();
 
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].uv = t0;
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomRight();
-	vertexBufferData.vertices[i].uv = t1;
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].uv = t2;
-	vertexBufferData.vertices[i].color = currentColor;
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.drawVertexCount = i;
-	currentBatch->vertexCount += 6;
+	setVertex(v[0], rect.topLeft(), t3, currentColor, atlasTextureIndex, currentClipRectIndex);
+	setVertex(v[1], rect.topRight(), t0, currentColor, atlasTextureIndex, currentClipRectIndex);
+	setVertex(v[2], rect.bottomLeft(), t2, currentColor, atlasTextureIndex, currentClipRectIndex);
+	setVertex(v[3], rect.bottomRight(), t1, currentColor, atlasTextureIndex, currentClipRectIndex);
 }
 
 void Renderer::drawInterpolatedColors(
 	const Rect& rect,
-	const Rect& uvRect,
 	const Color& topLeft,
 	const Color& bottomLeft,
 	const Color& topRight,
 	const Color& bottomRight)
 {
-	//TODO: optimize for speed and multiple textures
-	u32 width = rect.width;
-	u32 height = rect.height;
+	if (rect.width <= 0 || rect.height <= 0 || rect.outside(currentClipRect))
+		return;
+
+	auto whiteImg = currentAtlas->whiteImage;
+	auto uvRect = whiteImg->uvRect.contract(ctx->settings.whiteImageUvBorder);
 
-	std::vector<u32> pixels;
-	auto t = 0.0f;
-	Color xcTop;
-	Color xcBottom;
-	Color c;
+	// the colors at the clipped corners, the GPU interpolates them across the quad
+	auto colorAt = [&](const Point& pt)
+	{
+		f32 tx = (pt.x - rect.x) / rect.width;
+		f32 ty = (pt.y - rect.y) / rect.height;
+		Color top = topLeft + (topRight - topLeft) * tx;
+		Color bottom = bottomLeft + (bottomRight - bottomLeft) * tx;
+
+		return (top + (bottom - top) * ty).getRgba();
+	};
+
+	// the quad's two triangles interpolate the colors linearly, so when the colors don't change along
+	// a single axis, the bilinear blend shows a seam on the diagonal, then the rect is drawn as a grid of quads
+	const f32 gridCellSize = 16;
+	const u32 maxGridSize = 16;
+	Color twist = topLeft - topRight - bottomLeft + bottomRight;
+	bool linear = fabs(twist.r) < FLT_EPSILON
+		&& fabs(twist.g) < FLT_EPSILON
+		&& fabs(twist.b) < FLT_EPSILON
+		&& fabs(twist.a) < FLT_EPSILON;
+	u32 columnCount = linear ? 1 : std::min(maxGridSize, (u32)ceilf(rect.width / gridCellSize));
+	u32 rowCount = linear ? 1 : std::min(maxGridSize, (u32)ceilf(rect.height / gridCellSize));
 
-	pixels.resize(width * height);
+	atlasTextureIndex = whiteImg->atlasTexture->textureIndex;
 
-	for (size_t x = 0; x < width; x++)
+	for (u32 row = 0; row < rowCount; row++)
 	{
-		t = (f32)x / width;
-		xcTop = topLeft + (topRight - topLeft) * t;
-		xcBottom = bottomLeft + (bottomRight - bottomLeft) * t;
+		f32 top = rect.y + rect.height * row / rowCount;
+		f32 bottom = rect.y + rect.height * (row + 1) / rowCount;
 
-		for (size_t y = 0; y < height; y++)
+		for (u32 column = 0; column < columnCount; column++)
 		{
-			c = xcTop + (xcBottom - xcTop) * ((f32)y / height);
-			pixels[x + y * width] = c.getRgba();
-		}
-	}
+			f32 left = rect.x + rect.width * column / columnCount;
+			f32 right = rect.x + rect.width * (column + 1) / columnCount;
+			Rect cell(left, top, right - left, bottom - top);
+
+			if (cell.outside(currentClipRect))
+				continue;
 
-	//if (pixels.data())
-	//{
-	//	currentBatch->textureArray->updateRectData( pixels.data());
-	//}
+			auto clippedRect = currentClipRectIndex ? cell : cell.clipInside(currentClipRect);
+			auto v = addQuadVertices();
 
-	//beginBatch(coloredQuadAtlas);
-	//atlasTextureIndex = 0;
-	//drawQuad(clippedUvRect, clippedRect);
-	//endBatch();
+			setVertex(v[0], clippedRect.topLeft(), uvRect.topLeft(), colorAt(clippedRect.topLeft()), atlasTextureIndex, currentClipRectIndex);
+			setVertex(v[1], clippedRect.topRight(), uvRect.topRight(), colorAt(clippedRect.topRight()), atlasTextureIndex, currentClipRectIndex);
+			setVertex(v[2], clippedRect.bottomLeft(), uvRect.bottomLeft(), colorAt(clippedRect.bottomLeft()), atlasTextureIndex, currentClipRectIndex);
+			setVertex(v[3], clippedRect.bottomRight(), uvRect.bottomRight(), colorAt(clippedRect.bottomRight()), atlasTextureIndex, currentClipRectIndex);
+		}
+	}
 }
 
 void Renderer::drawSpectrumColors(
@@ -1115,211 +2734,54 @@ void Renderer::drawSpectrumColors(
 	DrawSpectrumBrightness brightness,
 	DrawSpectrumDirection dir)
 {
-	//TODO: optimize for speed and multiple textures
-	u32 width = rect.width;
-	u32 height = rect.height;
+	// the hue wheel, back to red at the end
+	const Color spectrum[] = { Color::red, Color::yellow, Color::green, Color::cyan, Color::blue, Color::magenta, Color::red };
+	const u32 spectrumCount = 6;
+	const bool horizontal = dir == DrawSpectrumDirection::Horizontal;
 
-	//spectrumQuadAtlas->textureArray->resize(1, width, height);
-
-	std::vector<u32> pixels;
-	auto t = 0.0f;
-	Color xcTop;
-	Color xcBottom;
-	Color c;
-	Color spectrum[] = { Color::red, Color::yellow, Color::green, Color::cyan, Color::blue, Color::magenta };
-	const int spectrumCount = 6;
-	Color top = Color::white;
-	Color bottom = Color::black;
-
-	pixels.resize(width * height);
-
-	if (dir == DrawSpectrumDirection::Horizontal)
+	// one gradient per hue segment, two when the brightness goes from white through the hue to black
+	for (u32 i = 0; i < spectrumCount; i++)
 	{
-		for (size_t x = 0; x < width; x++)
-		{
-			t = (f32)x / width;
-			size_t index = t * spectrumCount;
-			size_t indexNext = index + 1;
-			f32 indexF = t * (f32)spectrumCount;
-			f32 fraction = indexF - (f32)index;
+		const Color& c0 = spectrum[i];
+		const Color& c1 = spectrum[i + 1];
+		Rect segment = rect;
 
-			if (indexNext == spectrumCount)
-				indexNext = 0;
-
-			c = spectrum[index] + (spectrum[indexNext] - spectrum[index]) * fraction;
-			c.a = 1;
-			Color cf = c;
+		if (horizontal)
+		{
+			segment.x = rect.x + rect.width * i / spectrumCount;
+			segment.width = rect.x + rect.width * (i + 1) / spectrumCount - segment.x;
+		}
+		else
+		{
+			segment.y = rect.y + rect.height * i / spectrumCount;
+			segment.height = rect.y + rect.height * (i + 1) / spectrumCount - segment.y;
+		}
 
-			for (size_t y = 0; y < height; y++)
-			{
-				if (brightness == DrawSpectrumBrightness::On)
-				{
-					f32 b = (f32)y / height;
+		if (brightness == DrawSpectrumBrightness::Off)
+		{
+			if (horizontal)
+				drawInterpolatedColors(segment, c0, c0, c1, c1);
+			else
+				drawInterpolatedColors(segment, c0, c1, c0, c1);
 
-					if (b <= 0.5f)
-						cf = Color::white + (c - Color::white) * (b / 0.5f);
-					else
-						cf = c + (Color::black - c) * ((b - 0.5f) / 0.5f);
+			continue;
+		}
 
-					cf.a = 1;
-				}
+		if (horizontal)
+		{
+			f32 half = segment.height / 2.0f;
 
-				pixels[x + y * width] = cf.getRgba();
-			}
+			drawInterpolatedColors({ segment.x, segment.y, segment.width, half }, Color::white, c0, Color::white, c1);
+			drawInterpolatedColors({ segment.x, segment.y + half, segment.width, segment.height - half }, c0, Color::black, c1, Color::black);
 		}
-	}
-	else
-	{
-		for (size_t y = 0; y < height; y++)
+		else
 		{
-			t = (f32)y / height;
-			size_t index = t * spectrumCount;
-			size_t indexNext = index + 1;
-			f32 indexF = t * (f32)spectrumCount;
-			f32 fraction = indexF - (f32)index;
+			f32 half = segment.width / 2.0f;
 
-			if (indexNext == spectrumCount)
-				indexNext = 0;
-
-			c = spectrum[index] + (spectrum[indexNext] - spectrum[index]) * fraction;
-			c.a = 1;
-			u32 color = c.getRgba();
-			auto offs = y * width;
-
-			for (size_t x = 0; x < width; x++)
-			{
-				pixels[x + offs] = color;
-			}
+			drawInterpolatedColors({ segment.x, segment.y, half, segment.height }, Color::white, Color::white, c0, c1);
+			drawInterpolatedColors({ segment.x + half, segment.y, segment.width - half, segment.height }, c0, c1, Color::black, Color::black);
 		}
 	}
-
-	//if (pixels.data())
-	//{
-	//	spectrumQuadAtlas->textureArray->updateData(pixels.data());
-	//}
-
-	//beginBatch(spectrumQuadAtlas);
-	//atlasTextureIndex = 0;
-	//drawQuad(clippedUvRect, clippedRect);
-	//endBatch();
-}
-
-void Renderer::drawInterpolatedColorsTopBottom(
-	const Rect& rect,
-	const Rect& uvRect,
-	const Color& top,
-	const Color& bottom)
-{
-	auto whiteImg = currentAtlas->whiteImage;
-	atlasTextureIndex = whiteImg->atlasTexture->textureIndex;
-
-	Color clippedTopColor = top;
-	Color clippedBottomColor = bottom;
-
-	if (uvRect.y > 0.0f)
-		clippedTopColor = top + (bottom - top) * uvRect.y;
-
-	if (uvRect.height < 1.0f && uvRect.y == 0.0f)
-		clippedBottomColor = top + (bottom - top) * uvRect.height;
-
-	needToAddVertexCount(6);
-
-	u32 i = vertexBufferData.drawVertexCount;
-
-	vertexBufferData.vertices[i].position = rect.topLeft();
-	vertexBufferData.vertices[i].color = clippedTopColor.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.topLeft();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].color = clippedTopColor.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.topRight();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].color = clippedBottomColor.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.bottomLeft();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	// 2nd tri
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].color = clippedTopColor.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.topRight();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomRight();
-	vertexBufferData.vertices[i].color = clippedBottomColor.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.bottomRight();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].color = clippedBottomColor.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.bottomLeft();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.drawVertexCount = i;
-	currentBatch->vertexCount += 6;
-}
-
-void Renderer::drawInterpolatedColorsLeftRight(
-	const Rect& rect,
-	const Rect& uvRect,
-	const Color& left,
-	const Color& right)
-{
-	auto whiteImg = currentAtlas->whiteImage;
-
-	atlasTextureIndex = whiteImg->atlasTexture->textureIndex;
-	needToAddVertexCount(6);
-
-	u32 i = vertexBufferData.drawVertexCount;
-
-	vertexBufferData.vertices[i].position = rect.topLeft();
-	vertexBufferData.vertices[i].color = left.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.topLeft();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].color = right.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.topRight();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].color = left.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.bottomLeft();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	// 2nd tri
-
-	vertexBufferData.vertices[i].position = rect.topRight();
-	vertexBufferData.vertices[i].color = right.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.topRight();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomRight();
-	vertexBufferData.vertices[i].color = right.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.bottomRight();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.vertices[i].position = rect.bottomLeft();
-	vertexBufferData.vertices[i].color = left.getRgba();
-	vertexBufferData.vertices[i].uv = whiteImg->uvRect.bottomLeft();
-	vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-	i++;
-
-	vertexBufferData.drawVertexCount = i;
-	currentBatch->vertexCount += 6;
 }
 
 void Renderer::drawImageBordered(UiImage* image, u32 border, const Rect& rect, f32 scale)
@@ -1508,14 +2970,31 @@ void Renderer::drawLine(const Point& a, const Point& b)
 
 void Renderer::drawPolyLine(const Point* points, u32 pointCount, bool closed)
 {
-	std::vector<Point> stippleLines;
-	std::vector<bool> stippleLinesSkip;
+	Point* stippleLines = nullptr;
+	bool* stippleLinesSkip = nullptr;
+	u32 stippleCount = 0;
+	u32 stippleCapacity = 0;
 	Point* pts = (Point*)points;
 
+	// the stipple segments are kept in the frame arena, grown by doubling
+	auto addStipplePoint = [&](const Point& pt, bool skipPoint)
+	{
+		if (stippleCount == stippleCapacity)
+		{
+			u32 newCapacity = std::max(stippleCapacity * 2, pointCount * 4);
+
+			stippleLines = frameArena.reallocate(stippleLines, stippleCount, newCapacity);
+			stippleLinesSkip = frameArena.reallocate(stippleLinesSkip, stippleCount, newCapacity);
+			stippleCapacity = newCapacity;
+		}
+
+		stippleLines[stippleCount] = pt;
+		stippleLinesSkip[stippleCount] = skipPoint;
+		stippleCount++;
+	};
+
 	if (currentLineStyle.useStipple)
 	{
-		stippleLines.clear();
-		stippleLinesSkip.clear();
 		f32 remainder = 0;
 		u32 oldJ = 0;
 		bool skip = false;
@@ -1554,11 +3033,9 @@ void Renderer::drawPolyLine(const Point* points, u32 pointCount, bool closed)
 
 		for (u32 i = 0; i < pointCount; i++)
 		{
-			if (stippleLines.empty() ||
-				(stippleLines.size() && points[i] != stippleLines.back()))
+			if (!stippleCount || points[i] != stippleLines[stippleCount - 1])
 			{
-				stippleLines.push_back(points[i]);
-				stippleLinesSkip.push_back(skip);
+				addStipplePoint(points[i], skip);
 			}
 
 			idx = i + 1;
@@ -1602,13 +3079,11 @@ void Renderer::drawPolyLine(const Point* points, u32 pointCount, bool closed)
 					f32 t = currentLength / totalLineLength;
 					Point pt = points[i] + line * t;
 
-					if (stippleLines.empty() 
-						|| (stippleLines.size() && pt != stippleLines.back()))
+					if (!stippleCount || pt != stippleLines[stippleCount - 1])
 					{
-						stippleLines.push_back(pt);
 						// toggle pattern skip
 						skip = !skip;
-						stippleLinesSkip.push_back(skip);
+						addStipplePoint(pt, skip);
 					}
 				}
 
@@ -1622,8 +3097,8 @@ void Renderer::drawPolyLine(const Point* points, u32 pointCount, bool closed)
 			}
 		}
 
-		pts = stippleLines.data();
-		pointCount = stippleLines.size();
+		pts = stippleLines;
+		pointCount = stippleCount;
 	}
 
 	Point d1;
@@ -1839,97 +3314,257 @@ void Renderer::drawPolyLine(const Point* points, u32 pointCount, bool closed)
 		lastP11 = p21;
 		lastP12 = p22;
 
-		bool drawIt = true;
+		bool drawIt = true;
+
+		if (currentLineStyle.useStipple)
+		{
+			drawIt = !stippleLinesSkip[p];
+		}
+
+		if (drawIt)
+		{
+			drawQuad(p11, p21, p22, p12, uv11, uv21, uv22, uv12, lineImage);
+		}
+	}
+}
+
+void Renderer::drawTriangle(
+	const Point& p1, const Point& p2, const Point& p3,
+	const Point& uv1, const Point& uv2, const Point& uv3,
+	UiImage* image)
+{
+	Point pts[12];
+	Point uvPts[12];
+	u32 pointCount;
+	Point newUv1, newUv2, newUv3;
+	auto img = image ? image : currentAtlas->whiteImage;
+
+	if (image)
+	{
+		newUv1 = uv1;
+		newUv2 = uv2;
+		newUv3 = uv3;
+	}
+	else
+	{
+		newUv1 = img->uvRect.topLeft();
+		newUv1.x += ctx->settings.whiteImageUvBorder;
+		newUv1.y += ctx->settings.whiteImageUvBorder;
+		newUv2 = img->uvRect.topRight();
+		newUv2.x -= ctx->settings.whiteImageUvBorder;
+		newUv2.y += ctx->settings.whiteImageUvBorder;
+		newUv3 = img->uvRect.bottomRight();
+		newUv3.x -= ctx->settings.whiteImageUvBorder;
+		newUv3.y -= ctx->settings.whiteImageUvBorder;
+	}
+
+	if (currentClipRectIndex)
+	{
+		pts[0] = p1;
+		pts[1] = p2;
+		pts[2] = p3;
+		uvPts[0] = newUv1;
+		uvPts[1] = newUv2;
+		uvPts[2] = newUv3;
+		pointCount = 3;
+	}
+	else
+	{
+		clipTriangleToRect(
+			p1, p2, p3, newUv1, newUv2, newUv3,
+			currentClipRect, pts, uvPts, pointCount);
+	}
+
+	if (!pointCount)
+		return;
+
+	atlasTextureIndex = img->atlasTexture->textureIndex;
+	drawTriangleFan(pts, uvPts, pointCount);
+}
+
+void Renderer::drawTriangleFan(const Point* points, const Point* uvPoints, u32 pointCount)
+{
+	if (pointCount < 3)
+		return;
+
+	const Point& fp = points[0];
+	const Point& uvFp = uvPoints[0];
+
+	// the fan triangles are paired into quads sharing the edge from the first point,
+	// the quad index pattern draws (v0, v1, v2) and (v1, v3, v2)
+	for (u32 k = 1; k < pointCount - 1; k += 2)
+	{
+		auto v = addQuadVertices();
+
+		setVertex(v[0], points[k], uvPoints[k], currentColor, atlasTextureIndex, currentClipRectIndex);
+		setVertex(v[1], points[k + 1], uvPoints[k + 1], currentColor, atlasTextureIndex, currentClipRectIndex);
+		setVertex(v[2], fp, uvFp, currentColor, atlasTextureIndex, currentClipRectIndex);
+
+		if (k + 2 < pointCount)
+		{
+			setVertex(v[3], points[k + 2], uvPoints[k + 2], currentColor, atlasTextureIndex, currentClipRectIndex);
+		}
+		else
+		{
+			// odd triangle left, make the second one degenerate
+			v[3] = v[1];
+		}
+	}
+}
+
+void Renderer::drawShape(const Rect& rect, const ShapeParameters& shape, u32 shapeIndex)
+{
+	if (!shaderShapes || shapeIndex >= maxShapeCount)
+	{
+		drawShapeTessellated(rect, shape);
+		return;
+	}
+
+	// the uvs are the offsets from the shape's center, so they're clipped along with the quad
+	Rect uvRect(-rect.width / 2, -rect.height / 2, rect.width, rect.height);
+
+	atlasTextureIndex = shapeTextureIndexFlag | shapeIndex;
+	queueQuad(rect, uvRect);
+}
+
+void Renderer::drawShapeTessellated(const Rect& rect, const ShapeParameters& shape)
+{
+	const f32 pi = 3.14159265f;
+	Point center = rect.center();
+	u32 fillColor = currentColor;
+
+	shapePoints.clear();
+
+	if (shape.type == (u32)ShapeType::Ring || shape.type == (u32)ShapeType::Arc)
+	{
+		bool isArc = shape.type == (u32)ShapeType::Arc && shape.endAngle - shape.startAngle < pi * 2;
+		f32 startAngle = isArc ? shape.startAngle : 0;
+		f32 angleSpan = isArc ? shape.endAngle - shape.startAngle : pi * 2;
+		f32 outerRadius = shape.cornerRadius;
+		f32 innerRadius = std::max(shape.cornerRadius - shape.borderWidth, 0.0f);
+
+		if (angleSpan <= 0 || outerRadius <= innerRadius)
+			return;
+
+		// about 4 pixels long segments on the outer edge
+		u32 segmentCount = std::min(std::max((u32)ceilf(angleSpan * outerRadius / 4), 8u), 256u);
+		u32 pointCount = segmentCount + 1;
+
+		shapePoints.resize(pointCount * 2);
+
+		for (u32 i = 0; i < pointCount; i++)
+		{
+			f32 angle = startAngle + angleSpan * i / segmentCount;
+			Point dir(cosf(angle), sinf(angle));
+
+			shapePoints[i] = center + dir * outerRadius;
+			shapePoints[pointCount + i] = center + dir * innerRadius;
+		}
+
+		drawOutlineBand(&shapePoints[0], &shapePoints[pointCount], pointCount, false);
+
+		if (!isArc)
+			return;
+
+		// the round ends, half discs on the arc's center line
+		const u32 capSegmentCount = 8;
+		f32 capRadius = (outerRadius - innerRadius) / 2;
+		Point capPoints[capSegmentCount + 1];
+
+		for (u32 end = 0; end < 2; end++)
+		{
+			f32 angle = end ? startAngle + angleSpan : startAngle;
+			Point dir(cosf(angle), sinf(angle));
+			// pointing away from the arc
+			Point tangent = end ? Point(-dir.y, dir.x) : Point(dir.y, -dir.x);
+			Point capCenter = center + dir * (innerRadius + capRadius);
+
+			for (u32 i = 0; i <= capSegmentCount; i++)
+			{
+				f32 capAngle = pi * i / capSegmentCount;
+
+				capPoints[i] = capCenter + (dir * cosf(capAngle) + tangent * sinf(capAngle)) * capRadius;
+			}
 
-		if (currentLineStyle.useStipple)
-		{
-			drawIt = !stippleLinesSkip[p];
+			drawConvexPolygon(capPoints, capSegmentCount + 1);
 		}
 
-		if (drawIt)
-		{
-			drawTriangle(p11, p21, p22, uv11, uv21, uv22, lineImage);
-			drawTriangle(p11, p22, p12, uv11, uv22, uv12, lineImage);
-		}
+		return;
 	}
-}
 
-void Renderer::drawTriangle(
-	const Point& p1, const Point& p2, const Point& p3,
-	const Point& uv1, const Point& uv2, const Point& uv3,
-	UiImage* image)
-{
-	// not thread safe
-	static Point pts[12];
-	static Point uvPts[12];
-	static u32 pointCount;
-	static Point newUv1, newUv2, newUv3;
-	auto img = image ? image : currentAtlas->whiteImage;
+	// the rounded rectangle outline, with the same point count for the border's inner outline
+	f32 cornerRadius = std::min(shape.cornerRadius, std::min(shape.halfSize.x, shape.halfSize.y));
+	u32 cornerSegmentCount = std::min(std::max((u32)ceilf(cornerRadius / 2), 1u), 16u);
+	u32 pointCount = (cornerSegmentCount + 1) * 4;
+	f32 borderWidth = std::min(shape.borderWidth, std::min(shape.halfSize.x, shape.halfSize.y));
+	u32 outlineCount = borderWidth > 0 ? 2 : 1;
 
-	if (image)
+	shapePoints.resize(pointCount * outlineCount);
+
+	for (u32 outline = 0; outline < outlineCount; outline++)
 	{
-		newUv1 = uv1;
-		newUv2 = uv2;
-		newUv3 = uv3;
+		f32 inset = outline ? borderWidth : 0;
+		f32 radius = std::max(cornerRadius - inset, 0.0f);
+		Point cornerOffset(
+			std::max(shape.halfSize.x - inset - radius, 0.0f),
+			std::max(shape.halfSize.y - inset - radius, 0.0f));
+		Point* points = &shapePoints[pointCount * outline];
+
+		// clockwise from the bottom right corner, the Y axis points down
+		for (u32 corner = 0; corner < 4; corner++)
+		{
+			Point cornerCenter(
+				center.x + (corner == 0 || corner == 3 ? cornerOffset.x : -cornerOffset.x),
+				center.y + (corner < 2 ? cornerOffset.y : -cornerOffset.y));
+
+			for (u32 i = 0; i <= cornerSegmentCount; i++)
+			{
+				f32 angle = pi / 2 * (corner + (f32)i / cornerSegmentCount);
+
+				*points++ = cornerCenter + Point(cosf(angle), sinf(angle)) * radius;
+			}
+		}
 	}
-	else
+
+	if (outlineCount == 2)
 	{
-		newUv1 = img->uvRect.topLeft();
-		newUv1.x += ctx->settings.whiteImageUvBorder;
-		newUv1.y += ctx->settings.whiteImageUvBorder;
-		newUv2 = img->uvRect.topRight();
-		newUv2.x -= ctx->settings.whiteImageUvBorder;
-		newUv2.y += ctx->settings.whiteImageUvBorder;
-		newUv3 = img->uvRect.bottomRight();
-		newUv3.x -= ctx->settings.whiteImageUvBorder;
-		newUv3.y -= ctx->settings.whiteImageUvBorder;
+		currentColor = shape.borderColor;
+		drawOutlineBand(&shapePoints[0], &shapePoints[pointCount], pointCount, true);
+		currentColor = fillColor;
 	}
 
-	clipTriangleToRect(
-		p1, p2, p3, newUv1, newUv2, newUv3,
-		currentClipRect, pts, uvPts, pointCount);
+	drawConvexPolygon(&shapePoints[pointCount * (outlineCount - 1)], pointCount);
+}
 
-	if (!pointCount)
-		return;
+void Renderer::drawOutlineBand(const Point* outerPoints, const Point* innerPoints, u32 pointCount, bool closed)
+{
+	Point uv;
+	u32 segmentCount = closed ? pointCount : pointCount - 1;
 
-	Point& fp = pts[0];
-	Point& uvFp = uvPts[0];
+	for (u32 i = 0; i < segmentCount; i++)
+	{
+		u32 next = (i + 1) % pointCount;
 
-	atlasTextureIndex = img->atlasTexture->textureIndex;
+		drawTriangle(outerPoints[i], outerPoints[next], innerPoints[next], uv, uv, uv, nullptr);
+		drawTriangle(outerPoints[i], innerPoints[next], innerPoints[i], uv, uv, uv, nullptr);
+	}
+}
 
-	needToAddVertexCount((pointCount - 2) * 3);
-	u32 i = vertexBufferData.drawVertexCount;
+void Renderer::drawConvexPolygon(const Point* points, u32 pointCount)
+{
+	Point uv;
 
-	for (int k = 1; k < pointCount - 1; k++)
+	for (u32 i = 1; i + 1 < pointCount; i++)
 	{
-		vertexBufferData.vertices[i].position = fp;
-		vertexBufferData.vertices[i].color = currentColor;
-		vertexBufferData.vertices[i].uv = uvFp;
-		vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-		i++;
-
-		vertexBufferData.vertices[i].position = pts[k];
-		vertexBufferData.vertices[i].color = currentColor;
-		vertexBufferData.vertices[i].uv = uvPts[k];
-		vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-		i++;
-
-		vertexBufferData.vertices[i].position = pts[k+1];
-		vertexBufferData.vertices[i].color = currentColor;
-		vertexBufferData.vertices[i].uv = uvPts[k+1];
-		vertexBufferData.vertices[i].textureIndex = atlasTextureIndex;
-		i++;
+		drawTriangle(points[0], points[i], points[i + 1], uv, uv, uv, nullptr);
 	}
-
-	currentBatch->vertexCount += (pointCount - 2) * 3;
-	vertexBufferData.drawVertexCount = i;
 }
 
 void Renderer::drawTextInternal(
-	const char* text,
+	const UnicodeString& utext,
 	const Point& position)
 {
-	if (!strcmp(text, ""))
+	if (utext.empty())
 	{
 		return;
 	}
@@ -1941,13 +3576,46 @@ void Renderer::drawTextInternal(
 
 	GlyphCode lastChr = 0;
 	Point underlineStartPos = pos;
+	const GlyphRun* run = nullptr;
+
+	if (glyphRunCache)
+	{
+		run = mainRenderer ? currentFont->findGlyphRun(utext) : currentFont->getGlyphRun(utext);
+	}
+
+	if (run)
+	{
+		if (!run->hasRotatedQuads)
+		{
+			queueGlyphRun(*run, pos);
+		}
+		else
+		{
+			for (auto& quad : run->quads)
+			{
+				Rect rect = quad.rect;
+				Rect uvRect = quad.uvRect;
+
+				rect.x += pos.x;
+				rect.y += pos.y;
+				atlasTextureIndex = quad.textureIndex;
+
+				if (!quad.rotated)
+				{
+					queueQuad(rect, uvRect);
+				}
+				else if (clipRectRot(rect, uvRect))
+				{
+					drawQuadRot90(rect, uvRect);
+				}
+			}
+		}
+	}
 
 	/////////////////////////////
 	// DRAW CHARS
 	/////////////////////////////
-	const UnicodeString& utext = *ctx->textCache->getText(text);
-
-	for (int i = 0; i < utext.size(); i++)
+	for (size_t i = 0; !run && i < utext.size(); i++)
 	{
 		auto chr = utext[i];
 
@@ -1965,18 +3633,25 @@ void Renderer::drawTextInternal(
 		}
 
 		auto kern = currentFont->getKerning(lastChr, chr);
+		f32 scale = currentFont->getGlyphScale();
 		pos.x += kern;
-		drawTextGlyph(img, { pos.x + glyph->bitmapLeft, pos.y - glyph->bitmapTop });
-		pos.x += glyph->advanceX;
+		drawTextGlyph(
+			img,
+			{ pos.x + glyph->bitmapLeft * scale, pos.y - glyph->bitmapTop * scale },
+			scale,
+			currentFont->getGlyphTextureIndexFlags());
+		pos.x += glyph->advanceX * scale;
 		lastChr = chr;
 	}
 
 	// render underline
 	if (currentTextStyle.underline)
 	{
-		auto fsize = currentFont->computeTextSize(utext);
+		auto fsize = run ? run->size : currentFont->computeTextSize(utext);
 		auto image = currentAtlas->whiteImage;
 
+		atlasTextureIndex = image->atlasTexture->textureIndex;
+
 		if (!image->rotated)
 		{
 			drawQuad(
@@ -2007,6 +3682,10 @@ bool Renderer::clipRectNoRot(Rect& rect, Rect& uvRect)
 	if (rect.outside(currentClipRect))
 		return false;
 
+	// the pixels are clipped in the shader
+	if (currentClipRectIndex)
+		return true;
+
 	auto newRect = rect.clipInside(currentClipRect);
 	auto oldUvRect = uvRect;
 
@@ -2039,6 +3718,9 @@ bool Renderer::clipRectRot(Rect& rect, Rect& uvRect)
 	if (rect.outside(currentClipRect))
 		return false;
 
+	if (currentClipRectIndex)
+		return true;
+
 	auto newRect = rect.clipInside(currentClipRect);
 
 	// clip left and top UVs
@@ -2071,24 +3753,457 @@ bool Renderer::clipRect(bool rotated, Rect& rect, Rect& uvRect)
 
 void Renderer::needToAddVertexCount(u32 count)
 {
-	if (vertexBufferData.drawVertexCount + count < vertexBufferData.vertices.size())
+	const u32 pageSize = VertexBufferData::pageVertexCount;
+	u32 pageCount = (vertexBufferData.drawVertexCount + count + pageSize - 1) / pageSize;
+
+	// add new pages, the vertices already written are never moved
+	while (vertexBufferData.pages.size() < pageCount)
+	{
+		vertexBufferData.pages.emplace_back();
+		vertexBufferData.pages.back().resize(pageSize);
+	}
+}
+
+static inline u32 packVertexUv(f32 uv)
+{
+	if (uv <= 0.0f) return 0;
+	if (uv >= 1.0f) return packedVertexUvMask;
+
+	return (u32)(uv * (f32)packedVertexUvMask + 0.5f);
+}
+
+/// \return the vertex count of the quads when uploaded without an index buffer, as two triangles of 3 vertices
+static inline u32 getUnindexedVertexCount(u32 quadVertexCount)
+{
+	return quadVertexCount / 4 * 6;
+}
+
+/// Expand the quads' 4 vertices in place to the two triangles of the quad index pattern, the buffer must hold the expanded vertices
+template <typename VertexType>
+static void expandQuadsToTriangles(VertexType* vertices, u32 quadCount)
+{
+	// back to front, so every quad is read before the expanded quads after it overwrite it
+	for (u32 i = quadCount; i--;)
+	{
+		VertexType quad[4] = { vertices[i * 4], vertices[i * 4 + 1], vertices[i * 4 + 2], vertices[i * 4 + 3] };
+		VertexType* out = &vertices[i * 6];
+
+		out[0] = quad[0];
+		out[1] = quad[1];
+		out[2] = quad[2];
+		out[3] = quad[1];
+		out[4] = quad[3];
+		out[5] = quad[2];
+	}
+}
+
+void Renderer::uploadVertices()
+{
+	auto& settings = ctx->settings;
+
+	if (settings.vertexStreamingMode != vertexStreamingMode
+		|| settings.vertexStreamingRingSize != vertexStreamingRingSize)
+	{
+		vertexStreamingMode = settings.vertexStreamingMode;
+		vertexStreamingRingSize = settings.vertexStreamingRingSize;
+		vertexBuffer->setStreamingMode(vertexStreamingMode, vertexStreamingRingSize);
+	}
+
+	const u32 vertexCount = vertexBufferData.drawVertexCount;
+	// without an index buffer the quads are expanded to triangles, so the GPU buffer holds more vertices
+	const u32 uploadVertexCount = indexBuffer ? vertexCount : getUnindexedVertexCount(vertexCount);
+
+	// the GPU buffer only grows when the frame doesn't fit, its old contents are not needed since the whole frame is uploaded
+	if (vertexBufferData.gpuVertexCount < vertexCount)
+	{
+		u32 newCount = vertexBufferData.gpuVertexCount * vertexBufferData.vertexCountGrowFactor;
+
+		newCount = std::max(newCount, vertexCount);
+		newCount = (newCount + 3) & ~3;
+		vertexBuffer->resize(indexBuffer ? newCount : getUnindexedVertexCount(newCount));
+		growQuadIndexBuffer(newCount / 4);
+		vertexBufferData.gpuVertexCount = newCount;
+	}
+
+	vertexBuffer->beginFrameUpload();
+
+	if (!vertexCount)
+	{
+		return;
+	}
+
+	const u32 pageSize = VertexBufferData::pageVertexCount;
+	const u32 stagingVertexCount = indexBuffer ? vertexBufferData.gpuVertexCount : getUnindexedVertexCount(vertexBufferData.gpuVertexCount);
+
+	frameStats.uploadedByteCount += uploadVertexCount * (vertexFormat == VertexFormat::Full ? sizeof(Vertex) : sizeof(PackedVertex));
+
+	if (vertexFormat == VertexFormat::Full)
+	{
+		// the first page tells if the provider can take the pages as slices, otherwise they're gathered below
+		if (!verticesReordered && indexBuffer
+			&& vertexBuffer->updateDataRange(vertexBufferData.pages[0].data(), 0, std::min(pageSize, vertexCount)))
+		{
+			for (u32 start = pageSize, page = 1; start < vertexCount; start += pageSize, page++)
+			{
+				vertexBuffer->updateDataRange(
+					vertexBufferData.pages[page].data(), start,
+					std::min(pageSize, vertexCount - start));
+			}
+
+			return;
+		}
+
+		// gather the merged batches' vertices, so they're uploaded in one go
+		if (stagingVertices.size() < uploadVertexCount)
+		{
+			stagingVertices.clear();
+			stagingVertices.resize(stagingVertexCount);
+		}
+
+		for (auto& range : vertexRanges)
+		{
+			copyVertices(&stagingVertices[range.destIndex], range.sourceIndex, range.count);
+		}
+
+		if (!indexBuffer)
+		{
+			expandQuadsToTriangles(stagingVertices.data(), vertexCount / 4);
+		}
+
+		vertexBuffer->updateData(stagingVertices.data(), 0, uploadVertexCount);
+		return;
+	}
+
+	// the packed buffer never shrinks, so after the first frames this doesn't allocate
+	if (packedVertices.size() < uploadVertexCount)
+	{
+		// no need to keep the old contents
+		packedVertices.clear();
+		packedVertices.resize(stagingVertexCount);
+	}
+
+	for (auto& range : vertexRanges)
+	{
+		for (u32 i = 0; i < range.count; i++)
+		{
+			auto& vtx = vertexBufferData[range.sourceIndex + i];
+			auto& packed = packedVertices[range.destIndex + i];
+
+			packed.position = vtx.position;
+			packed.color = vtx.color;
+			packed.uvAndTextureIndex =
+				packVertexUv(vtx.uv.x)
+				| (packVertexUv(vtx.uv.y) << packedVertexUvBits)
+				| ((vtx.textureIndex & packedVertexMaxTextureIndex) << (packedVertexUvBits * 2));
+		}
+	}
+
+	if (!indexBuffer)
+	{
+		expandQuadsToTriangles(packedVertices.data(), vertexCount / 4);
+	}
+
+	vertexBuffer->updatePackedData(packedVertices.data(), 0, uploadVertexCount);
+}
+
+void Renderer::copyVertices(Vertex* outVertices, u32 startVertexIndex, u32 count)
+{
+	const u32 pageSize = VertexBufferData::pageVertexCount;
+
+	while (count)
+	{
+		u32 offset = startVertexIndex % pageSize;
+		u32 copyCount = std::min(count, pageSize - offset);
+
+		auto pageVertices = &vertexBufferData.pages[startVertexIndex / pageSize][offset];
+
+		std::copy(pageVertices, pageVertices + copyCount, outVertices);
+		outVertices += copyCount;
+		startVertexIndex += copyCount;
+		count -= copyCount;
+	}
+}
+
+static bool isSameBatchState(const RenderBatch& a, const RenderBatch& b)
+{
+	return a.primitiveType == b.primitiveType
+		&& a.vertexBuffer == b.vertexBuffer
+		&& a.indexBuffer == b.indexBuffer
+		&& a.textureArray == b.textureArray
+		&& a.atlas == b.atlas
+		&& !a.commandCallback
+		&& !b.commandCallback;
+}
+
+void Renderer::mergeBatches()
+{
+	frameStats.generatedBatchCount += batches.size();
+	drawBatches.clear();
+	batchGroups.clear();
+	vertexRanges.clear();
+	nextBatchInGroup.resize(batches.size());
+	verticesReordered = false;
+
+	for (u32 i = 0; i < batches.size(); i++)
+	{
+		auto& batch = batches[i];
+
+		// atlas switches that didn't draw anything
+		if (!batch.vertexCount && !batch.commandCallback)
+		{
+			continue;
+		}
+
+		f32 minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+
+		for (u32 j = batch.startVertexIndex; j < batch.startVertexIndex + batch.vertexCount; j++)
+		{
+			auto& pos = vertexBufferData[j].position;
+
+			minX = std::min(minX, pos.x);
+			minY = std::min(minY, pos.y);
+			maxX = std::max(maxX, pos.x);
+			maxY = std::max(maxY, pos.y);
+		}
+
+		Rect bounds(minX, minY, maxX - minX, maxY - minY);
+		i32 targetGroup = -1;
+		i32 lookback = ctx->settings.batchMergeLookback;
+
+		// a batch can be drawn earlier, together with a previous batch with the same state,
+		// as long as it doesn't overlap anything drawn in between
+		for (i32 j = (i32)batchGroups.size() - 1; j >= 0 && j >= (i32)batchGroups.size() - 1 - lookback; j--)
+		{
+			auto& group = batchGroups[j];
+
+			if (isSameBatchState(batches[group.lastBatch], batch))
+			{
+				targetGroup = j;
+				break;
+			}
+
+			// user callbacks can draw anywhere
+			if (!group.bounds.outside(bounds)
+				|| batches[group.lastBatch].commandCallback)
+			{
+				break;
+			}
+		}
+
+		nextBatchInGroup[i] = ~0;
+
+		if (targetGroup == -1)
+		{
+			BatchGroup group;
+
+			group.firstBatch = i;
+			group.lastBatch = i;
+			group.bounds = bounds;
+			batchGroups.push_back(group);
+			continue;
+		}
+
+		auto& group = batchGroups[targetGroup];
+		f32 groupRight = std::max(group.bounds.right(), bounds.right());
+		f32 groupBottom = std::max(group.bounds.bottom(), bounds.bottom());
+
+		group.bounds.x = std::min(group.bounds.x, bounds.x);
+		group.bounds.y = std::min(group.bounds.y, bounds.y);
+		group.bounds.width = groupRight - group.bounds.x;
+		group.bounds.height = groupBottom - group.bounds.y;
+		nextBatchInGroup[group.lastBatch] = i;
+		group.lastBatch = i;
+	}
+
+	// lay out the vertices of each group one after the other
+	u32 destIndex = 0;
+
+	for (auto& group : batchGroups)
+	{
+		RenderBatch drawBatch = batches[group.firstBatch];
+
+		drawBatch.startVertexIndex = destIndex;
+		drawBatch.startIndex = destIndex / 4 * 6;
+		drawBatch.vertexCount = 0;
+		drawBatch.indexCount = 0;
+
+		for (u32 i = group.firstBatch; i != ~0u; i = nextBatchInGroup[i])
+		{
+			auto& batch = batches[i];
+
+			if (!vertexRanges.empty()
+				&& vertexRanges.back().sourceIndex + vertexRanges.back().count == batch.startVertexIndex
+				&& vertexRanges.back().destIndex + vertexRanges.back().count == destIndex)
+			{
+				vertexRanges.back().count += batch.vertexCount;
+			}
+			else
+			{
+				VertexRange range;
+
+				range.sourceIndex = batch.startVertexIndex;
+				range.destIndex = destIndex;
+				range.count = batch.vertexCount;
+				vertexRanges.push_back(range);
+				verticesReordered |= range.sourceIndex != range.destIndex;
+			}
+
+			destIndex += batch.vertexCount;
+			drawBatch.vertexCount += batch.vertexCount;
+			drawBatch.indexCount += batch.indexCount;
+		}
+
+		if (!indexBuffer)
+		{
+			// the quads are uploaded expanded to triangles, see uploadVertices
+			drawBatch.startVertexIndex = getUnindexedVertexCount(drawBatch.startVertexIndex);
+			drawBatch.vertexCount = getUnindexedVertexCount(drawBatch.vertexCount);
+		}
+
+		drawBatches.push_back(drawBatch);
+	}
+}
+
+void Renderer::growQuadIndexBuffer(u32 quadCount)
+{
+	if (!indexBuffer || quadCount <= quadIndexBufferQuadCount)
 	{
-		// already have space available
 		return;
 	}
 
-	std::vector<Vertex> verts = vertexBufferData.vertices;
+	// the pattern is the same for all quads, so it's only uploaded when the vertex buffer grows
+	std::vector<u32> indices;
+
+	indices.resize(quadCount * 6);
+
+	for (u32 i = 0; i < quadCount; i++)
+	{
+		u32 v = i * 4;
+		u32* idx = &indices[i * 6];
+
+		idx[0] = v;
+		idx[1] = v + 1;
+		idx[2] = v + 2;
+		idx[3] = v + 1;
+		idx[4] = v + 3;
+		idx[5] = v + 2;
+	}
+
+	indexBuffer->resize(indices.size());
+	indexBuffer->updateData(indices.data(), 0, indices.size());
+	frameStats.uploadedByteCount += indices.size() * sizeof(indices[0]);
+	quadIndexBufferQuadCount = quadCount;
+}
+
+void Renderer::queueQuad(const Rect& rect, const Rect& uvRect)
+{
+	if (quadQueue.count == QuadQueue::maxQuadCount
+		|| (quadQueue.count && quadQueue.color != currentColor))
+	{
+		flushQuadQueue();
+	}
+
+	quadQueue.rects[quadQueue.count] = rect;
+	quadQueue.uvRects[quadQueue.count] = uvRect;
+	quadQueue.textureIndices[quadQueue.count] = atlasTextureIndex;
+	quadQueue.color = currentColor;
+	quadQueue.count++;
+}
+
+void Renderer::queueGlyphRun(const GlyphRun& run, const Point& position)
+{
+	u32 index = 0;
+	u32 quadCount = run.quads.size();
+
+	while (index < quadCount)
+	{
+		if (quadQueue.count == QuadQueue::maxQuadCount
+			|| (quadQueue.count && quadQueue.color != currentColor))
+		{
+			flushQuadQueue();
+		}
+
+		u32 count = std::min(quadCount - index, QuadQueue::maxQuadCount - quadQueue.count);
+		auto quad = &run.quads[index];
+
+		for (u32 i = 0; i < count; i++, quad++)
+		{
+			u32 queueIndex = quadQueue.count + i;
+
+			quadQueue.rects[queueIndex] = quad->rect;
+			quadQueue.rects[queueIndex].x += position.x;
+			quadQueue.rects[queueIndex].y += position.y;
+			quadQueue.uvRects[queueIndex] = quad->uvRect;
+			quadQueue.textureIndices[queueIndex] = quad->textureIndex;
+		}
+
+		quadQueue.color = currentColor;
+		quadQueue.count += count;
+		index += count;
+		atlasTextureIndex = quad[-1].textureIndex;
+	}
+}
+
+void Renderer::flushQuadQueue()
+{
+	const u32 pageSize = VertexBufferData::pageVertexCount;
+	u32 index = 0;
+
+	while (index < quadQueue.count)
+	{
+		// the clipper writes the vertices in place, so never cross the current page
+		u32 pageQuadCount = (pageSize - vertexBufferData.drawVertexCount % pageSize) / 4;
+		u32 count = std::min(quadQueue.count - index, pageQuadCount);
+
+		needToAddVertexCount(count * 4);
+
+		u32 quadCount = currentClipRectIndex
+			? emitQuads(
+				quadQueue.rects + index,
+				quadQueue.uvRects + index,
+				quadQueue.textureIndices + index,
+				count,
+				currentClipRectIndex,
+				quadQueue.color,
+				&vertexBufferData[vertexBufferData.drawVertexCount])
+			: clipAndEmitQuads(
+				quadQueue.rects + index,
+				quadQueue.uvRects + index,
+				quadQueue.textureIndices + index,
+				count,
+				currentClipRect,
+				quadQueue.color,
+				&vertexBufferData[vertexBufferData.drawVertexCount]);
+
+		vertexBufferData.drawVertexCount += quadCount * 4;
+		currentBatch->vertexCount += quadCount * 4;
+		currentBatch->indexCount += quadCount * 6;
+		index += count;
+	}
+
+	quadQueue.count = 0;
+}
+
+Vertex* Renderer::addQuadVertices()
+{
+	if (quadQueue.count)
+		flushQuadQueue();
+
+	needToAddVertexCount(4);
+
+	auto v = &vertexBufferData[vertexBufferData.drawVertexCount];
 
-	vertexBufferData.vertices.resize(vertexBufferData.vertices.size() * vertexBufferData.vertexCountGrowFactor + count);
-	vertexBufferData.vertices.insert(vertexBufferData.vertices.begin(), verts.begin(), verts.end());
-	vertexBuffer->resize(vertexBufferData.vertices.size());
+	vertexBufferData.drawVertexCount += 4;
+	currentBatch->vertexCount += 4;
+	currentBatch->indexCount += 6;
+
+	return v;
 }
 
 char* Renderer::addUtf8TextToBuffer(const char* text, u32 sizeBytes)
 {
-	auto pos = textBuffer.data() + textBufferPosition;
+	auto pos = frameArena.allocate<char>(sizeBytes + 1);
 	memcpy(pos, text, sizeBytes + 1); // and zero
-	textBufferPosition += sizeBytes + 1;
 	return pos;
 }
 
@@ -2099,21 +4214,10 @@ void Renderer::addBatch()
 	currentBatch->atlas = currentAtlas;
 	currentBatch->primitiveType = RenderBatch::PrimitiveType::TriangleList;
 	currentBatch->startVertexIndex = vertexBufferData.drawVertexCount;
+	currentBatch->startIndex = vertexBufferData.drawVertexCount / 4 * 6;
 	currentBatch->vertexBuffer = vertexBuffer;
+	currentBatch->indexBuffer = indexBuffer;
 	currentBatch->textureArray = currentAtlas->textureArray;
 }
 
-void Renderer::addDrawCommand(const DrawCommand& cmd)
-{
-	if (drawCmdNextInsertIndex == ~0)
-	{
-		drawCommands.push_back(cmd);
-	}
-	else
-	{
-		drawCommands.insert(drawCommands.begin() + drawCmdNextInsertIndex, cmd);
-		drawCmdNextInsertIndex++;
-	}
-}
-
-}
+}
\ No newline at end of file
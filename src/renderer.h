@@ -2,7 +2,12 @@
 #include "types.h"
 #include "horus.h"
 #include "horus_interfaces.h"
+#include "worker_pool.h"
 #include <unordered_map>
+#include <new>
+#include <memory>
+#include <string.h>
+#include <chrono>
 
 namespace hui
 {
@@ -10,6 +15,8 @@ class UiFont;
 struct UiImage;
 class UiAtlas;
 struct FontTextSize;
+struct GlyphRun;
+struct DrawCommandCaptureData;
 
 /// How an image is drawn, repeated or stretched across the rectangle
 enum class ImageSizingPolicy
@@ -27,38 +34,29 @@ struct TextStyle
 	bool backFill = false; /// true if back is filled color
 };
 
-/// Vertex buffer data used in rendering the UI
+/// Vertex buffer data used in rendering the UI.
+/// The vertices are kept in fixed size pages, so growing never moves the vertices already written
 struct VertexBufferData
 {
-	std::vector<Vertex> vertices;
+	static const u32 pageVertexCount = 16384; /// a multiple of 4, so the quads never cross pages
+
+	std::vector<std::vector<Vertex>> pages;
 	u32 drawVertexCount = 0;
+	u32 gpuVertexCount = 0; /// the vertex count the GPU vertex buffer was last resized to
 	f32 vertexCountGrowFactor = 1.5f;
+
+	Vertex& operator [](u32 index) { return pages[index / pageVertexCount][index % pageVertexCount]; }
 };
 
 struct DrawCommand
 {
-	enum class Type
-	{
-		None,
-		DrawRect,
-		DrawQuad,
-		DrawImageBordered,
-		DrawLine,
-		DrawPolyLine,
-		DrawText,
-		DrawInterpolatedColors,
-		DrawSolidTriangle,
-		ClipRect,
-		SetViewportOffset,
-		SetAtlas,
-		SetColor,
-		SetFont,
-		SetTextStyle,
-		SetLineStyle,
-		SetFillStyle,
-		Callback,
-
-		Count
+	typedef DrawCommandType Type;
+
+	/// Every command in the stream starts with a header, followed by the command's payload
+	struct Header
+	{
+		Type type = Type::None;
+		u16 size = 0; /// the whole command size in bytes, header and padding included
 	};
 
 	struct CmdDrawRect
@@ -98,6 +96,8 @@ struct DrawCommand
 	{
 		Point position;
 		char* text;
+		const UnicodeString* unicodeText; /// resolved when recorded, null if the text is not valid UTF-8
+		Rect bounds; /// the area the glyphs and the underline can cover, from the font metrics
 	};
 
 	struct CmdDrawImageBordered
@@ -111,44 +111,195 @@ struct DrawCommand
 	struct CmdDrawInterpolatedColors
 	{
 		Rect rect;
-		Rect uvRect;
 		Color topLeft;
 		Color bottomLeft;
 		Color topRight;
 		Color bottomRight;
 	};
 
+	struct CmdDrawSpectrumColors
+	{
+		Rect rect;
+		bool brightness; /// white to the hue to black, across the spectrum direction
+		bool vertical;
+	};
+
+	struct CmdDrawShape
+	{
+		Rect rect; /// the shape's quad, for the circles, rings and arcs it's the square around the circle
+		ShapeParameters shape; /// the sizes are already scaled
+		u32 index; /// the shape's index in the frame's shape table, maxShapeCount if the table is full
+	};
+
 	struct CmdSetViewportOffset
 	{
 		Point offset;
 	};
 
-	DrawCommand() {}
-	DrawCommand(Type newType)
-		: type(newType)
-	{}
+	struct CmdClipRect
+	{
+		Rect rect;
+		u32 index; /// the rect's index in the frame's clip rect table, used when clipping in the shader
+	};
+
+	struct CmdSetAtlas
+	{
+		UiAtlas* atlas;
+	};
 
-	Type type = Type::None;
-	i32 zOrder = 0;
-	CmdDrawRect drawRect;
-	CmdDrawQuad drawQuad;
-	CmdDrawLine drawLine;
-	CmdDrawPolyLine drawPolyLine;
-	CmdDrawText drawText;
-	CmdDrawImageBordered drawImageBordered;
-	CmdDrawInterpolatedColors drawInterpolatedColors;
-	CmdDrawTriangle drawTriangle;
-	CmdSetViewportOffset setViewportOffset;
-	Rect clipRect;
-	bool clipToParent;
-	bool popClipRect = false;
-	UiAtlas* setAtlas;
-	Color setColor;
-	UiFont* setFont;
-	Color setTextColor;
-	TextStyle setTextStyle;
-	LineStyle setLineStyle;
-	FillStyle setFillStyle;
+	struct CmdSetColor
+	{
+		u32 color; /// packed RGBA, as used by the vertices
+	};
+
+	struct CmdSetFont
+	{
+		UiFont* font;
+	};
+
+	/// Used by the text, line and fill style commands, the index points into the frame's deduplicated style tables
+	struct CmdSetStyle
+	{
+		u32 styleIndex;
+	};
+
+	/// Used by the begin and end cached layer commands, the index points into the frame's cached layers
+	struct CmdCachedLayer
+	{
+		u32 index;
+	};
+
+	/// All commands start at offsets multiple of this value
+	static const u32 alignment = 8;
+
+	/// \return the offset of the payload from the start of the header, payloads needing bigger alignment are padded
+	template<typename T>
+	static constexpr u32 getPayloadOffset()
+	{
+		return alignof(T) > sizeof(Header) ? alignof(T) : sizeof(Header);
+	}
+
+	/// \return the full size of a command with the given payload, header and padding included
+	template<typename T>
+	static constexpr u32 getSize()
+	{
+		return (getPayloadOffset<T>() + sizeof(T) + alignment - 1) & ~(alignment - 1);
+	}
+
+	template<typename T>
+	static T& getPayload(Header* header)
+	{
+		return *(T*)((u8*)header + getPayloadOffset<T>());
+	}
+};
+
+/// A linear allocator for the data living only for the current frame, like the text and points copied by the draw commands.
+/// It grows by chaining blocks, so the memory already given out never moves, and it is reset at the beginning of each frame
+struct FrameArena
+{
+	static const size_t defaultBlockSize = 1024 * 1024;
+
+	/// Allocate uninitialized memory, valid until the next reset
+	void* allocate(size_t size, size_t alignment);
+
+	template<typename T>
+	T* allocate(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+
+	/// Allocate a bigger array and copy the old elements into it, the old array is reclaimed on reset
+	template<typename T>
+	T* reallocate(T* data, size_t count, size_t newCount)
+	{
+		T* newData = allocate<T>(newCount);
+
+		if (count)
+			std::uninitialized_copy(data, data + count, newData);
+
+		return newData;
+	}
+
+	/// Free all the allocations, the blocks are kept for the next frame
+	void reset();
+	/// \return the bytes allocated in the current frame
+	size_t getUsedByteSize() const { return usedByteSize; }
+
+	std::vector<std::vector<u8>> blocks;
+	u32 currentBlock = 0;
+	size_t currentBlockUsed = 0;
+	size_t usedByteSize = 0;
+};
+
+/// A packed stream of draw commands, each command taking only the space its payload needs.
+/// The styles are kept in separate tables and consecutive identical styles share the same entry.
+/// Commands are referenced from per z-order layers, so the frame is assembled by walking the layers in order, no sorting needed
+struct DrawCommandBuffer
+{
+	/// A position in a layer where commands can be inserted later, like the box backgrounds drawn after the box contents
+	struct InsertionPoint
+	{
+		i32 zOrder = 0;
+		u32 position = 0; /// the layer's entry count when the point was added
+	};
+
+	/// A run of commands inserted at an insertion point, stitched into the layer's entries when the frame is rendered
+	struct Splice
+	{
+		u32 position = 0;
+		u32 insertionPoint = 0; /// splices at the same position are executed in the order their insertion points were added
+		u32 start = 0; /// first entry in the layer's splicedEntries
+		u32 count = 0;
+	};
+
+	/// All the commands recorded with the same z-order, in recording order
+	struct Layer
+	{
+		i32 zOrder = 0;
+		std::vector<u32> entries; /// offsets of the commands in the stream
+		std::vector<u32> splicedEntries; /// offsets of the inserted commands, grouped by splice
+		std::vector<Splice> splices;
+	};
+
+	/// Add a new command to the stream, the entry must be added by the caller to a layer
+	/// \return the offset of the new command
+	template<typename T>
+	u32 add(DrawCommand::Type type)
+	{
+		u32 offset = allocate(type, DrawCommand::getSize<T>());
+		new (data.data() + offset + DrawCommand::getPayloadOffset<T>()) T();
+		return offset;
+	}
+
+	DrawCommand::Header* getHeader(u32 offset) { return (DrawCommand::Header*)(data.data() + offset); }
+
+	template<typename T>
+	T& getPayload(u32 offset) { return DrawCommand::getPayload<T>(getHeader(offset)); }
+
+	/// \return the index of the layer for the given z-order, the layer is created if missing, keeping the layers sorted
+	u32 getLayerIndex(i32 zOrder);
+	u32 addTextStyle(const TextStyle& style);
+	u32 addLineStyle(const LineStyle& style);
+	u32 addFillStyle(const FillStyle& style);
+	/// Add a rect to the clip rect table, the first entry is reserved for the vertices which are not clipped
+	/// \return the rect's index, zero if the table is full
+	u32 addClipRect(const Rect& rect);
+	/// Add a shape to the shape table, evaluated by the graphics provider when it supports it
+	/// \return the shape's index, maxShapeCount if the table is full
+	u32 addShape(const ShapeParameters& shape);
+	void clear();
+	/// \return the bytes used by the commands and style tables in the current frame
+	size_t getByteSize() const;
+
+	std::vector<u8> data;
+	std::vector<Layer> layers;
+	std::vector<InsertionPoint> insertionPoints;
+	u32 commandCount = 0;
+	std::vector<TextStyle> textStyles;
+	std::vector<LineStyle> lineStyles;
+	std::vector<FillStyle> fillStyles;
+	std::vector<Rect> clipRects; /// the rects of the clip rect commands, in recording order, the vertices point to them when clipping in the shader
+	std::vector<ShapeParameters> shapes; /// the shapes of the shape commands, in recording order, the vertices point to them when drawing the shapes in the shader
+
+protected:
+	u32 allocate(DrawCommand::Type type, u32 size);
 };
 
 class Renderer
@@ -167,11 +318,15 @@ public:
 	};
 
 	Renderer();
+	/// Create a renderer generating the vertices for a chunk of the main renderer's commands, on a worker thread
+	explicit Renderer(Renderer* mainRenderer);
 	virtual ~Renderer();
 	void clear(const Color& color);
 	Rect pushClipRect(const Rect& rect, bool clipToParent = true);
 	void popClipRect();
 	const Rect& getClipRect() const { return currentClipRect; }
+	/// \return true if the rect is not outside the current clip rect, the draw commands outside it are not recorded
+	bool isRectVisible(const Rect& rect) const;
 	void setWindowSize(const Point& size);
 	const Point& getWindowSize() const { return windowSize; }
 	Rect getWindowRect() const { return { 0, 0, windowSize.x, windowSize.y }; }
@@ -181,10 +336,37 @@ public:
 	u32 getZOrder() const { return zOrder; }
 	void beginFrame();
 	void endFrame();
+	/// \return true if only the damaged area of the window is redrawn, over the previous frame kept in the back buffer
+	bool isPartialRedraw() const;
 	UiFont* getFont() const { return currentFont; }
-	u32 getDrawCommandCount() const { return drawCommands.size(); }
-	void beginDrawCmdInsertion(u32 index) { drawCmdNextInsertIndex = index; }
-	void endDrawCmdInsertion() { drawCmdNextInsertIndex = ~0; }
+	u32 getDrawCommandCount() const { return drawCommands.commandCount; }
+	size_t getDrawCommandBufferSize() const { return drawCommands.getByteSize(); }
+	/// \return the statistics of the frame being recorded, the counters are reset on beginFrame
+	FrameStats& getFrameStats() { return frameStats; }
+	/// \return the statistics of the last rendered frame
+	const FrameStats& getLastFrameStats() const { return lastFrameStats; }
+	/// \return the rolling timing of a phase, over the last ContextSettings::frameStatsHistorySize frames
+	FramePhaseTiming getFramePhaseTiming(FramePhase phase) const;
+	/// \return the per frame scratch memory, reset on beginFrame
+	FrameArena& getFrameArena() { return frameArena; }
+	/// Mark the current position in the current z-order layer, to insert commands there later
+	/// \return the insertion point index, to be used with beginDrawCmdInsertion
+	u32 addDrawCmdInsertionPoint();
+	/// Begin inserting commands at an insertion point, the commands are recorded normally and spliced into place on endFrame
+	void beginDrawCmdInsertion(u32 insertionPoint);
+	void endDrawCmdInsertion() { currentSpliceIndex = ~0; }
+	/// Save the commands of the next rendered frame to a capture file, when the frame ends
+	void captureNextFrame(const char* filename) { captureFilename = filename; }
+	/// Execute a loaded capture's commands instead of the ones recorded in this frame, when the frame ends
+	void replayCapture(DrawCommandCaptureData* capture) { replayedCapture = capture; }
+	/// Begin recording the commands of a cached layer, see hui::beginCachedLayer
+	void beginCachedLayer(u64 key, const Rect& rect);
+	void endCachedLayer();
+	void invalidateCachedLayer(u64 key);
+	/// \return the rectangles changed in the window's last rendered frame, when ContextSettings::partialRedraw is enabled, null if the window wasn't rendered yet
+	const std::vector<Rect>* findDamageRects(Window window) const;
+	/// Forget the window's last frame, when the window is destroyed
+	void removeWindowDamage(Window window) { windowDamages.erase(window); }
 
 	// Commands
 	void cmdSetColor(const Color& color);
@@ -209,6 +391,9 @@ public:
 	void cmdDrawLine(const Point& a, const Point& b);
 	void cmdDrawPolyLine(const Point* points, u32 pointCount, bool closed);
 	void cmdDrawSolidTriangle(const Point& p1, const Point& p2, const Point& p3);
+	/// Record a shape filled with the current color
+	/// \param scale multiplies the shape's corner radius and border width
+	void cmdDrawShape(const Shape& shape, const Rect& rect, f32 scale);
 	FontTextSize cmdDrawTextAt(
 		const char* text,
 		const Point& position);
@@ -228,45 +413,255 @@ public:
 
 protected:
 	void drawAtlasRegion(bool rotatedUv, const Rect& rect, const Rect& atlasUvRect);
-	void drawTextGlyph(UiImage* image, const Point& pos);
+	void drawTextGlyph(UiImage* image, const Point& pos, f32 scale, u32 textureIndexFlags);
 	void drawQuad(UiImage* image, const Point& p1, const Point& p2, const Point& p3, const Point& p4);
+	void drawQuad(
+		const Point& p1, const Point& p2, const Point& p3, const Point& p4,
+		const Point& uv1, const Point& uv2, const Point& uv3, const Point& uv4,
+		UiImage* image);
 	void drawQuad(const Rect& rect, const Rect& uvRect);
 	void drawQuadRot90(const Rect& rect, const Rect& uvRect);
 	void drawTextInternal(
-		const char* text,
-		const Point& rect);
+		const UnicodeString& text,
+		const Point& position);
+	/// Draw the atlas white image with the corner colors interpolated by the GPU, as a grid of quads when the colors blend bilinearly
 	void drawInterpolatedColors(
 		const Rect& rect,
-		const Rect& uvRect,
 		const Color& topLeft,
 		const Color& bottomLeft,
 		const Color& topRight,
 		const Color& bottomRight);
 	void drawSpectrumColors(const Rect& rect, DrawSpectrumBrightness brightness, DrawSpectrumDirection dir);
-	void drawInterpolatedColorsTopBottom(const Rect& rect, const Rect& uvRect, const Color& top, const Color& bottom);
-	void drawInterpolatedColorsLeftRight(const Rect& rect, const Rect& uvRect, const Color& left, const Color& right);
 	void drawImageBordered(UiImage* image, u32 border, const Rect& rect, f32 scale);
 	void drawLine(const Point& a, const Point& b);
 	void drawPolyLine(const Point* points, u32 pointCount, bool closed);
 	void drawTriangle(const Point& p1, const Point& p2, const Point& p3, const Point& uv1, const Point& uv2, const Point& uv3, UiImage* image);
+	/// Draw a convex polygon as a triangle fan, packed in quads
+	void drawTriangleFan(const Point* points, const Point* uvPoints, u32 pointCount);
+	/// Draw a shape as a single quad evaluated in the shader, or tessellate it when the shader can't draw it
+	void drawShape(const Rect& rect, const ShapeParameters& shape, u32 shapeIndex);
+	void drawShapeTessellated(const Rect& rect, const ShapeParameters& shape);
+	/// Draw the band between two outlines with the same point count, as quads clipped to the current clip rect
+	void drawOutlineBand(const Point* outerPoints, const Point* innerPoints, u32 pointCount, bool closed);
+	/// Draw a convex polygon as triangles clipped to the current clip rect
+	void drawConvexPolygon(const Point* points, u32 pointCount);
 
 	bool clipRectNoRot(Rect& rect, Rect& uvRect);
 	bool clipRectRot(Rect& rect, Rect& uvRect);
 	bool clipRect(bool rotated, Rect& rect, Rect& uvRect);
 	void needToAddVertexCount(u32 count);
+	void growQuadIndexBuffer(u32 quadCount);
+	void mergeBatches();
+	void uploadVertices();
+	void copyVertices(Vertex* outVertices, u32 startVertexIndex, u32 count);
+	/// Add a quad to the current batch
+	/// \return the quad's 4 vertices, in top-left, top-right, bottom-left, bottom-right order
+	Vertex* addQuadVertices();
+	/// Queue a non rotated quad, to be clipped against the current clip rect and written in bulk,
+	/// with the current color and atlas texture index
+	void queueQuad(const Rect& rect, const Rect& uvRect);
+	/// Queue the quads of a glyph run without rotated glyphs, copying them in bulk at the given position
+	void queueGlyphRun(const GlyphRun& run, const Point& position);
+	/// Clip and write the queued quads into the current batch
+	void flushQuadQueue();
 	char* addUtf8TextToBuffer(const char* text, u32 sizeBytes);
 	void addBatch();
-	void addDrawCommand(const DrawCommand& cmd);
+	void executeDrawCommand(DrawCommand::Header* header);
+
+	DrawCommandBuffer::Layer& getCurrentLayer()
+	{
+		if (currentLayerIndex >= drawCommands.layers.size()
+			|| drawCommands.layers[currentLayerIndex].zOrder != zOrder)
+		{
+			currentLayerIndex = drawCommands.getLayerIndex(zOrder);
+		}
+
+		return drawCommands.layers[currentLayerIndex];
+	}
+
+	void executeLayer(DrawCommandBuffer::Layer& layer);
+	/// Add the time since the last phase ended to a phase's time
+	void endPhase(FramePhase phase);
+	void addPhaseTimesToHistory();
+	void saveCapture();
+	u64 hashDrawCommand(u64 hash, DrawCommand::Header* header);
+
+	/// Call the function for each command offset in the layer, in execution order, with the spliced commands in place
+	template<typename F>
+	void forEachLayerCommand(DrawCommandBuffer::Layer& layer, F func);
+
+	/// The state set by the commands, at the start of a chunk of commands generated in parallel
+	struct ChunkState
+	{
+		u32 firstCommand = 0; /// index in commandOrder
+		u32 commandCount = 0;
+		u32 color = 0;
+		UiFont* font = nullptr;
+		Rect clipRect;
+		u32 clipRectIndex = 0;
+		UiAtlas* atlas = nullptr;
+		TextStyle textStyle;
+		LineStyle lineStyle;
+		FillStyle fillStyle;
+		bool skipCachedLayerCommands = false; /// inside a cached layer drawn from its render target
+	};
+
+	/// Update the state with a state changing command, as executeDrawCommand would
+	void updateChunkState(ChunkState& state, DrawCommand::Header* header);
+	u64 hashChunkState(u64 hash, const ChunkState& state);
+
+	/// A region of the UI rendered into its own render target, drawn as a single quad until its contents change
+	struct CachedLayer
+	{
+		GraphicsApiRenderTarget renderTarget = nullptr;
+		TextureArray* textureArray = nullptr; /// the render target's texture, null if the graphics provider cannot draw it
+		u32 width = 0;
+		u32 height = 0;
+		u64 contentHash = 0; /// the hash of the commands drawn in the render target, and of the state they started with
+		u32 lastUsedFrame = 0;
+		bool valid = false; /// false when the render target must be redrawn
+	};
+
+	/// A cached layer used in the current frame
+	struct FrameCachedLayer
+	{
+		CachedLayer* layer = nullptr;
+		Rect rect; /// aligned to pixels
+		bool composite = false; /// true if the contents are drawn from the render target, instead of executing their commands
+	};
+
+	/// Redraw the render targets of the frame's cached layers whose contents changed, and choose which layers are drawn from them
+	void renderCachedLayers();
+	/// Generate the vertices of a cached layer's commands and draw them into its render target
+	void renderCachedLayer(const FrameCachedLayer& frameLayer, const ChunkState& state, u32 firstCommand, u32 commandCount);
+	/// Create or resize the layer's render target
+	/// \return false if the layer cannot be drawn from a render target
+	bool prepareCachedLayerRenderTarget(CachedLayer& layer, const Rect& rect);
+	void destroyCachedLayer(CachedLayer& layer);
+	/// Draw the cached layer's render target as a quad, clipped to the current clip rect
+	void drawCachedLayer(const FrameCachedLayer& frameLayer);
+
+	/// A draw command of a window's frame, compared with the previous frame's to find what changed
+	struct DamageItem
+	{
+		u64 key = 0; /// the hash of the command and of the state it's drawn with
+		Rect bounds; /// clipped to the clip rect
+	};
+
+	/// The draw commands of a window's last rendered frame
+	struct WindowDamage
+	{
+		Point windowSize;
+		bool cleared = false;
+		u32 clearColor = 0;
+		std::vector<DamageItem> items; /// sorted by key
+		std::vector<Rect> rects; /// the rectangles changed since the previous frame
+	};
+
+	/// Compare the frame's draw commands with the window's previous frame, and compute the rectangles which changed
+	/// \return the window's damage, with the new rectangles
+	WindowDamage& computeDamage();
+	/// \return false if the command doesn't draw anything, the bounds are not clipped
+	bool getDrawCommandBounds(DrawCommand::Header* header, const ChunkState& state, Rect& bounds);
+	/// \return the area a text drawn at the position can cover, with the current font
+	Rect getTextBounds(const Point& position, const FontTextSize& fsize);
+	/// Check if a draw command can be skipped, counting it as culled
+	/// \return true if the command's bounds are outside the current clip rect
+	bool cullDrawCommand(const Rect& bounds);
+	/// Record the current color a culled line or triangle would have set, the commands after it are drawn with it
+	void addCulledDrawCommandColor(const Color& color);
+
+	/// Split the commands in chunks, generate their vertices on the worker threads and stitch them in order,
+	/// the vertices and batches are the same as generated serially
+	void generateVerticesParallel(u32 threadCount);
+	/// Generate the vertices for a chunk of the main renderer's commands, into this renderer's vertices and batches
+	void executeChunk(const ChunkState& state);
+	/// Cache the glyph run, or the glyphs and kernings, a text command will use, caching them on worker threads is not safe
+	void cacheTextGlyphs(UiFont* font, const UnicodeString& text, bool underline);
+
+	template<typename T>
+	T& addDrawCommand(DrawCommand::Type type)
+	{
+		u32 offset = drawCommands.add<T>(type);
+
+		frameStats.drawCommandCountByType[(u32)type]++;
+
+		if (currentSpliceIndex == ~0u)
+		{
+			getCurrentLayer().entries.push_back(offset);
+		}
+		else
+		{
+			auto& layer = drawCommands.layers[spliceLayerIndex];
+
+			layer.splicedEntries.push_back(offset);
+			layer.splices[currentSpliceIndex].count++;
+		}
+
+		drawCommands.commandCount++;
+
+		return drawCommands.getPayload<T>(offset);
+	}
+
+	FrameArena frameArena; /// the per frame scratch memory, for the commands data and the temporary geometry
+	DrawCommandBuffer drawCommands;
+	DrawCommandBuffer* executedCommands = &drawCommands; /// the commands executed, the main renderer's for the chunk renderers
+	Renderer* mainRenderer = nullptr; /// set for the chunk renderers
+	WorkerPool workerPool;
+	std::vector<Renderer*> chunkRenderers;
+	std::vector<ChunkState> chunkStates;
+	std::vector<u32> commandOrder; /// the command offsets of all the layers, in execution order
+	/// A group of generated batches with the same state, drawn as a single batch
+	struct BatchGroup
+	{
+		u32 firstBatch = 0;
+		u32 lastBatch = 0;
+		Rect bounds;
+	};
+
+	/// Where a generated batch's vertices are moved, when the merged batches are uploaded
+	struct VertexRange
+	{
+		u32 sourceIndex = 0;
+		u32 destIndex = 0;
+		u32 count = 0;
+	};
+
+	/// Non rotated quads waiting to be clipped and written by the SIMD quad clipper
+	struct QuadQueue
+	{
+		static const u32 maxQuadCount = 64;
+
+		Rect rects[maxQuadCount];
+		Rect uvRects[maxQuadCount];
+		u32 textureIndices[maxQuadCount];
+		u32 count = 0;
+		u32 color = 0;
+	};
 
-	u32 textBufferPosition = 0;
-	std::vector<char> textBuffer;
-	u32 pointBufferPosition = 0;
-	std::vector<Point> pointBuffer;
-	std::vector<DrawCommand> drawCommands;
+	QuadQueue quadQueue;
 	std::vector<RenderBatch> batches;
+	std::vector<RenderBatch> drawBatches; /// the merged batches, sent to the graphics provider
+	std::vector<BatchGroup> batchGroups;
+	std::vector<u32> nextBatchInGroup;
+	std::vector<VertexRange> vertexRanges;
+	std::vector<Vertex> stagingVertices;
+	bool verticesReordered = false;
+	FrameStats frameStats;
+	FrameStats lastFrameStats;
+	std::vector<f64> phaseTimeHistory; /// the phase times of the last frames, a ring of FramePhase::Count times per frame
+	u32 phaseTimeHistoryIndex = 0;
+	u32 phaseTimeHistoryCount = 0;
+	std::chrono::high_resolution_clock::time_point phaseStartTime;
 	std::vector<Rect> clipRectStack;
 	VertexBufferData vertexBufferData;
 	VertexBuffer* vertexBuffer = nullptr;
+	IndexBuffer* indexBuffer = nullptr; /// holds the static quad index pattern, shared by all batches, null if the provider doesn't support index buffers
+	VertexFormat vertexFormat = VertexFormat::Full;
+	VertexStreamingMode vertexStreamingMode = VertexStreamingMode::Direct;
+	u32 vertexStreamingRingSize = 0;
+	std::vector<PackedVertex> packedVertices;
+	u32 quadIndexBufferQuadCount = 0;
 	RenderBatch* currentBatch = nullptr;
 	Rect currentClipRect;
 	UiFont* currentFont = nullptr;
@@ -274,8 +669,25 @@ protected:
 	Point windowSize;
 	u32 currentColor;
 	i32 zOrder = 0;
+	u32 currentLayerIndex = ~0;
 	u32 atlasTextureIndex = 0;
-	u32 drawCmdNextInsertIndex = ~0;
+	u32 spliceLayerIndex = 0;
+	u32 currentSpliceIndex = ~0;
+	std::string captureFilename; /// if not empty, the frame's commands are saved to this file on endFrame
+	DrawCommandCaptureData* replayedCapture = nullptr;
+	std::unordered_map<u64, CachedLayer> cachedLayers;
+	std::vector<FrameCachedLayer> frameCachedLayers;
+	u32 cachedLayerDepth = 0; /// the nested cached layers only record their clip rects, they're part of the outer one
+	bool skipCachedLayerCommands = false; /// true while executing the commands of a layer drawn from its render target
+	bool shaderClipping = false; /// the graphics provider clips the pixels to the vertices' clip rects, so the geometry is not clipped
+	u16 currentClipRectIndex = 0; /// the clip rect index written in the vertices, zero when the geometry is clipped on the CPU
+	bool shaderShapes = false; /// the graphics provider draws the shapes from the shape table, so they're not tessellated
+	std::vector<Point> shapePoints; /// the outlines of the tessellated shapes
+	bool glyphRunCache = false; /// the texts are drawn from the fonts' cached glyph runs
+	std::unordered_map<Window, WindowDamage> windowDamages;
+	std::vector<DamageItem> damageItems;
+	bool frameCleared = false; /// the back buffer was cleared in this frame, when only the damaged area is redrawn the clear is done on endFrame
+	Color frameClearColor;
 };
 
 }
\ No newline at end of file
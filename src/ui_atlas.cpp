@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stdio.h>
 #include "ui_atlas.h"
 #include "horus_interfaces.h"
 #include "renderer.h"
@@ -121,6 +122,9 @@ bool UiAtlas::pack(
 	if (pendingPackImages.empty())
 		return true;
 
+	if (ctx && ctx->renderer)
+		ctx->renderer->getFrameStats().atlasPackCount++;
+
 	lastUsedBgColor = bgColor;
 	lastUsedPolicy = packPolicy;
 	lastUsedSpacing = spacing;
@@ -283,6 +287,15 @@ bool UiAtlas::pack(
 
 		if (!pendingPackImages.empty())
 		{
+			// the packed vertices keep the texture index in 4 bits, a 17th texture would be sampled as the first one
+			if (ctx->gfx->getVertexFormat() == VertexFormat::Packed
+				&& atlasTextures.size() > packedVertexMaxTextureIndex)
+			{
+				printf("UiAtlas: %u images do not fit in the %u textures the packed vertex format can address, use a bigger atlas or VertexFormat::Full\n",
+					(u32)pendingPackImages.size(), packedVertexMaxTextureIndex + 1);
+				break;
+			}
+
 			AtlasTexture* newTexture = new AtlasTexture();
 
 			newTexture->packPolicy = packPolicy;
@@ -402,6 +415,7 @@ bool UiAtlas::pack(
 void UiAtlas::repackImages()
 {
 	deletePackerImages();
+	repackCount++;
 
 	for (auto img : images)
 	{
@@ -455,6 +469,7 @@ void UiAtlas::deletePackerImages()
 void UiAtlas::clearImages()
 {
 	deletePackerImages();
+	repackCount++;
 
 	for (auto image : images)
 	{
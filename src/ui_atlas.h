@@ -48,6 +48,8 @@ struct UiImage
 	Rgba32* imageData = nullptr;
 	u32 width = 0, height = 0;
 	bool bleedOut = false;
+	bool isShape = false; /// the image is drawn as its shape, it has no atlas pixels
+	Shape shape;
 };
 
 class UiAtlas
@@ -70,6 +72,8 @@ public:
 	void repackImages();
 	void packWithLastUsedParams() { pack(lastUsedSpacing, lastUsedBgColor, lastUsedPolicy); }
 	void clearImages();
+	/// \return how many times the images were repacked or cleared, the images' uv rects may have changed when it increases
+	u32 getRepackCount() const { return repackCount; }
 
 	UiImage* whiteImage = nullptr;
 	TextureArray* textureArray = nullptr;
@@ -98,6 +102,7 @@ protected:
 	Color lastUsedBgColor = Color::black;
 	UiAtlasPackPolicy lastUsedPolicy = UiAtlasPackPolicy::Skyline;
 	bool useWasteMap = true;
+	u32 repackCount = 0;
 	std::vector<AtlasTexture*> atlasTextures;
 	std::unordered_map<UiImageId, UiImage*> images;
 	std::vector<PackImageData> pendingPackImages;
@@ -64,7 +64,7 @@ Rect UiContext::drawMultilineText(
 		}
 
 		auto kern = crtFont->getKerning(lastGlyphCode, chr);
-		f32 charWidth = glyph->advanceX + kern;
+		f32 charWidth = glyph->advanceX * crtFont->getGlyphScale() + kern;
 
 		crtWidth += charWidth;
 		crtWordWidth += charWidth;
@@ -87,7 +87,7 @@ Rect UiContext::drawMultilineText(
 					if (!glyph2)
 						continue;
 
-					f32 charWidth = glyph2->advanceX + kern2;
+					f32 charWidth = glyph2->advanceX * crtFont->getGlyphScale() + kern2;
 
 					wordSize += charWidth;
 
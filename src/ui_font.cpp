@@ -1,11 +1,15 @@
 ﻿#include "ui_font.h"
 #include "util.h"
+#include "ui_context.h"
+#include "renderer.h"
 #include <ft2build.h>
 #include <freetype/freetype.h>
 #include <freetype/ftglyph.h>
 #include <freetype/ftoutln.h>
 #include <freetype/fttrigon.h>
 #include <assert.h>
+#include <float.h>
+#include <algorithm>
 
 #include FT_FREETYPE_H
 #include FT_STROKER_H
@@ -15,6 +19,8 @@ namespace hui
 {
 static FT_Library freetypeLibHandle;
 static u32 freetypeUsageCount = 0;
+// the dense kerning tables in font units, by font filename, so the fonts of other sizes or rescaled fonts reuse them
+static std::unordered_map<std::string, std::vector<FontKerningTable>> fontFileKerningTables;
 
 #define PIXEL(x) ((((x)+63) & -64)>>6)
 #define PIXEL2(x) ((x) >> 6)
@@ -32,6 +38,130 @@ static bool startFreeType()
 	return true;
 }
 
+/// Felzenszwalb and Huttenlocher's squared euclidean distance transform of a sampled function, in one dimension
+static void distanceTransform(const f32* f, u32 count, f32* distances, u32* parabolas, f32* bounds)
+{
+	u32 k = 0;
+
+	parabolas[0] = 0;
+	bounds[0] = -FLT_MAX;
+	bounds[1] = FLT_MAX;
+
+	for (u32 q = 1; q < count; q++)
+	{
+		f32 s = 0;
+
+		// drop the lower envelope parabolas hidden by the one at q
+		while (true)
+		{
+			u32 p = parabolas[k];
+
+			s = ((f[q] + (f32)q * q) - (f[p] + (f32)p * p)) / (2.0f * q - 2.0f * p);
+
+			if (s > bounds[k] || !k)
+				break;
+
+			k--;
+		}
+
+		k++;
+		parabolas[k] = q;
+		bounds[k] = s;
+		bounds[k + 1] = FLT_MAX;
+	}
+
+	k = 0;
+
+	for (u32 q = 0; q < count; q++)
+	{
+		while (bounds[k + 1] < q)
+		{
+			k++;
+		}
+
+		f32 offset = (f32)q - parabolas[k];
+
+		distances[q] = offset * offset + f[parabolas[k]];
+	}
+}
+
+/// Transform the columns, then the rows, of a grid of squared distances
+static void distanceTransform(std::vector<f32>& grid, u32 width, u32 height)
+{
+	u32 maxSize = std::max(width, height);
+	std::vector<f32> f(maxSize);
+	std::vector<f32> distances(maxSize);
+	std::vector<u32> parabolas(maxSize);
+	std::vector<f32> bounds(maxSize + 1);
+
+	for (u32 x = 0; x < width; x++)
+	{
+		for (u32 y = 0; y < height; y++)
+		{
+			f[y] = grid[x + y * width];
+		}
+
+		distanceTransform(f.data(), height, distances.data(), parabolas.data(), bounds.data());
+
+		for (u32 y = 0; y < height; y++)
+		{
+			grid[x + y * width] = distances[y];
+		}
+	}
+
+	for (u32 y = 0; y < height; y++)
+	{
+		distanceTransform(&grid[y * width], width, distances.data(), parabolas.data(), bounds.data());
+		memcpy(&grid[y * width], distances.data(), width * sizeof(f32));
+	}
+}
+
+/// Compute the signed distance field of a glyph bitmap, with a border of spread pixels, the distance is stored in the alpha,
+/// 0.5 on the outline, growing inside, and the distances beyond the spread are clamped
+static void computeDistanceField(const FT_Bitmap& bitmap, u32 spread, Rgba32* rgbaBuffer)
+{
+	const f32 infinity = 1e20f;
+	u32 width = bitmap.width + spread * 2;
+	u32 height = bitmap.rows + spread * 2;
+	std::vector<f32> insideDistances(width * height);
+	std::vector<f32> outsideDistances(width * height);
+	std::vector<u8> coverage(width * height, 0);
+
+	for (u32 y = 0; y < bitmap.rows; y++)
+	{
+		memcpy(&coverage[spread + (y + spread) * width], bitmap.buffer + y * bitmap.pitch, bitmap.width);
+	}
+
+	// the squared distances to the nearest pixel inside the glyph and to the nearest one outside it
+	for (u32 i = 0; i < width * height; i++)
+	{
+		bool inside = coverage[i] >= 128;
+
+		insideDistances[i] = inside ? 0 : infinity;
+		outsideDistances[i] = inside ? infinity : 0;
+	}
+
+	distanceTransform(insideDistances, width, height);
+	distanceTransform(outsideDistances, width, height);
+
+	for (u32 i = 0; i < width * height; i++)
+	{
+		f32 distance = 0;
+
+		// the antialiased edge pixels are closer to the outline than the pixel centers
+		if (coverage[i] && coverage[i] != 255)
+			distance = coverage[i] / 255.0f - 0.5f;
+		else if (coverage[i])
+			distance = sqrtf(outsideDistances[i]) - 0.5f;
+		else
+			distance = 0.5f - sqrtf(insideDistances[i]);
+
+		f32 alpha = std::min(std::max(0.5f + distance / (2.0f * spread), 0.0f), 1.0f);
+
+		rgbaBuffer[i] = 0x00FFFFFF | ((u32)(alpha * 255.0f + 0.5f) << 24);
+	}
+}
+
 static void stopFreeType()
 {
 	freetypeUsageCount--;
@@ -39,6 +169,7 @@ static void stopFreeType()
 	if (freetypeUsageCount <= 0)
 	{
 		FT_Done_FreeType(freetypeLibHandle);
+		fontFileKerningTables.clear();
 	}
 }
 
@@ -52,6 +183,18 @@ void UiFont::load(const std::string& fontFilename, u32 facePointSize, UiAtlas* t
 	filename = fontFilename;
 	faceSize = facePointSize;
 	atlas = themeAtlas;
+	hasKerning = false;
+	kerningTables = nullptr;
+	glyphSource = nullptr;
+
+	// the distance field glyphs need the full vertices, so the shader knows which ones they are
+	distanceField = ctx
+		&& ctx->settings.distanceFieldGlyphs
+		&& ctx->settings.distanceFieldGlyphFaceSize
+		&& ctx->gfx
+		&& ctx->gfx->supportsDistanceFieldGlyphs();
+	distanceFieldFaceSize = distanceField ? ctx->settings.distanceFieldGlyphFaceSize : 0;
+	distanceFieldSpread = distanceField ? ctx->settings.distanceFieldGlyphSpread : 0;
 
 	startFreeType();
 
@@ -80,13 +223,51 @@ void UiFont::load(const std::string& fontFilename, u32 facePointSize, UiAtlas* t
 
 	// freetype measures fonts in 64ths of pixels
 	//FT_Set_Char_Size((FT_Face)face, faceSize << 6, faceSize << 6, 96, 96);
-	FT_Set_Pixel_Sizes((FT_Face)face, 0, faceSize);
+	// the distance field glyphs are rasterized once at their own size and scaled to the face size
+	FT_Set_Pixel_Sizes((FT_Face)face, 0, distanceField ? distanceFieldFaceSize : faceSize);
+
+	unscaledMetrics.ascender = PIXEL2(((FT_Face)face)->size->metrics.ascender);
+	unscaledMetrics.descender = PIXEL2(((FT_Face)face)->size->metrics.descender);
+	unscaledMetrics.height = PIXEL2(((FT_Face)face)->size->metrics.height);
+	unscaledMetrics.underlinePosition = PIXEL2(((FT_Face)face)->underline_position);
+	unscaledMetrics.underlineThickness = PIXEL2(((FT_Face)face)->underline_thickness);
+	updateScaledMetrics();
+
+	FT_Face ftFace = (FT_Face)face;
+
+	// the kerning tables are in font units, only the pairs cached on use are in pixels and change with the rasterized face size
+	hasKerning = FT_HAS_KERNING(ftFace);
+	kerningScale = ftFace->size->metrics.x_scale / 65536.0f / 64.0f;
+	kerningFitScale = !distanceField && ftFace->size->metrics.x_ppem < 25 ? ftFace->size->metrics.x_ppem / 25.0f : 1.0f;
+	kerningPairs.clear();
+}
 
-	metrics.ascender = PIXEL2(((FT_Face)face)->size->metrics.ascender);
-	metrics.descender = PIXEL2(((FT_Face)face)->size->metrics.descender);
-	metrics.height = PIXEL2(((FT_Face)face)->size->metrics.height);
-	metrics.underlinePosition = PIXEL2(((FT_Face)face)->underline_position);
-	metrics.underlineThickness = PIXEL2(((FT_Face)face)->underline_thickness);
+void UiFont::load(UiFont* source, u32 fontFaceSize)
+{
+	filename = source->filename;
+	faceSize = fontFaceSize;
+	atlas = source->atlas;
+	hasKerning = false;
+	kerningTables = nullptr;
+	kerningPairs.clear();
+	glyphSource = source;
+	distanceField = true;
+	distanceFieldFaceSize = source->distanceFieldFaceSize;
+	distanceFieldSpread = source->distanceFieldSpread;
+	unscaledMetrics = source->unscaledMetrics;
+	startFreeType();
+	updateScaledMetrics();
+}
+
+void UiFont::updateScaledMetrics()
+{
+	glyphScale = distanceField ? (f32)faceSize / (f32)distanceFieldFaceSize : 1.0f;
+
+	metrics.ascender = unscaledMetrics.ascender * glyphScale;
+	metrics.descender = unscaledMetrics.descender * glyphScale;
+	metrics.height = unscaledMetrics.height * glyphScale;
+	metrics.underlinePosition = unscaledMetrics.underlinePosition * glyphScale;
+	metrics.underlineThickness = unscaledMetrics.underlineThickness * glyphScale;
 
 	// if its too big, clamp it
 	if (metrics.underlinePosition < -2)
@@ -95,15 +276,104 @@ void UiFont::load(const std::string& fontFilename, u32 facePointSize, UiAtlas* t
 	metrics.underlinePosition = round(metrics.underlinePosition);
 }
 
+void UiFont::computeKerningTables()
+{
+	FT_Face ftFace = (FT_Face)face;
+	auto iter = fontFileKerningTables.find(filename);
+
+	if (iter != fontFileKerningTables.end())
+	{
+		kerningTables = &iter->second;
+		return;
+	}
+
+	auto& tables = fontFileKerningTables[filename];
+
+	kerningTables = &tables;
+
+	if (!ctx)
+	{
+		return;
+	}
+
+	std::vector<FT_UInt> charIndices;
+
+	for (auto& range : ctx->settings.denseKerningRanges)
+	{
+		if (!range.last || range.last < range.first)
+		{
+			continue;
+		}
+
+		FontKerningTable table;
+
+		table.firstCode = range.first;
+		table.codeCount = range.last - range.first + 1;
+		table.kernings.resize(table.codeCount * table.codeCount, 0);
+		charIndices.resize(table.codeCount);
+
+		for (u32 i = 0; i < table.codeCount; i++)
+		{
+			charIndices[i] = FT_Get_Char_Index(ftFace, table.firstCode + i);
+		}
+
+		// the codes without a glyph in the font have no kerning
+		for (u32 left = 0; left < table.codeCount; left++)
+		{
+			if (!charIndices[left])
+			{
+				continue;
+			}
+
+			i16* row = &table.kernings[left * table.codeCount];
+
+			for (u32 right = 0; right < table.codeCount; right++)
+			{
+				FT_Vector kerning;
+
+				if (!charIndices[right]
+					|| FT_Get_Kerning(ftFace, charIndices[left], charIndices[right], FT_KERNING_UNSCALED, &kerning))
+				{
+					continue;
+				}
+
+				row[right] = (i16)kerning.x;
+			}
+		}
+
+		tables.push_back(std::move(table));
+	}
+}
+
 void UiFont::resetFaceSize(u32 fontFaceSize)
 {
 	faceSize = fontFaceSize;
+	deleteGlyphRuns();
+
+	// the distance field glyphs and kernings are only scaled
+	if (distanceField)
+	{
+		updateScaledMetrics();
+		return;
+	}
+
 	load(filename, faceSize, atlas);
 	resizeFaceMode = true;
 
-	for (auto glyph : glyphs)
+	for (u32 pageIndex = 0; pageIndex < glyphPages.size(); pageIndex++)
 	{
-		cacheGlyph(glyph.first);
+		auto page = glyphPages[pageIndex];
+
+		if (!page)
+			continue;
+
+		for (u32 i = 0; i < FontGlyphPage::glyphCount; i++)
+		{
+			if (page->isPresent(i))
+			{
+				cacheGlyph((pageIndex << FontGlyphPage::codeShift) + i);
+			}
+		}
 	}
 
 	resizeFaceMode = false;
@@ -122,20 +392,74 @@ UiFont::~UiFont()
 
 FontGlyph* UiFont::getGlyph(GlyphCode glyphCode)
 {
-	auto iter = glyphs.find(glyphCode);
+	if (glyphSource)
+	{
+		return glyphSource->getGlyph(glyphCode);
+	}
 
-	// glyph not cached, do it
-	if (iter == glyphs.end())
+	auto glyph = findGlyph(glyphCode);
+
+	// glyph not cached, do it, unless it failed to load before
+	if (!glyph && !isMissingGlyph(glyphCode))
 	{
 		return cacheGlyph(glyphCode, true);
 	}
 
-	return iter->second;
+	return glyph;
+}
+
+bool UiFont::isMissingGlyph(GlyphCode glyphCode) const
+{
+	u32 pageIndex = glyphCode >> FontGlyphPage::codeShift;
+
+	if (glyphCode > maxGlyphCode)
+		return true;
+
+	if (pageIndex >= glyphPages.size() || !glyphPages[pageIndex])
+		return false;
+
+	return glyphPages[pageIndex]->isMissing(glyphCode & (FontGlyphPage::glyphCount - 1));
 }
 
 f32 UiFont::getKerning(GlyphCode glyphCodeLeft, GlyphCode glyphCodeRight)
 {
-	u64 hash = ((u64)glyphCodeLeft) << 32 + glyphCodeRight;
+	if (glyphSource)
+	{
+		return glyphSource->getUnscaledKerning(glyphCodeLeft, glyphCodeRight) * glyphScale;
+	}
+
+	return getUnscaledKerning(glyphCodeLeft, glyphCodeRight) * glyphScale;
+}
+
+f32 UiFont::getUnscaledKerning(GlyphCode glyphCodeLeft, GlyphCode glyphCodeRight)
+{
+	// the text start has no left glyph
+	if (!hasKerning || !glyphCodeLeft)
+	{
+		return 0;
+	}
+
+	if (!kerningTables)
+	{
+		computeKerningTables();
+	}
+
+	for (auto& table : *kerningTables)
+	{
+		u32 left = glyphCodeLeft - table.firstCode;
+		u32 right = glyphCodeRight - table.firstCode;
+
+		// the offsets of the codes below the range wrap around, so they're out of range too
+		if (left < table.codeCount && right < table.codeCount)
+		{
+			f32 kern = table.kernings[left * table.codeCount + right] * kerningScale;
+
+			// the scaled distance field kernings keep their fraction, the bitmap ones are rounded to whole pixels
+			return distanceField ? kern : floorf(kern * kerningFitScale + 0.5f);
+		}
+	}
+
+	u64 hash = (((u64)glyphCodeLeft) << 32) + glyphCodeRight;
 	auto iter = kerningPairs.find(hash);
 
 	if (iter != kerningPairs.end())
@@ -150,10 +474,10 @@ f32 UiFont::getKerning(GlyphCode glyphCodeLeft, GlyphCode glyphCodeRight)
 			(FT_Face)face,
 			FT_Get_Char_Index((FT_Face)face, glyphCodeLeft),
 			FT_Get_Char_Index((FT_Face)face, glyphCodeRight),
-			FT_KERNING_DEFAULT,
+			distanceField ? FT_KERNING_UNFITTED : FT_KERNING_DEFAULT,
 			&kerning);
 
-		f32 kern = kerning.x >> 6;
+		f32 kern = distanceField ? kerning.x / 64.0f : kerning.x >> 6;
 		kerningPairs[hash] = kern;
 
 		return kern;
@@ -190,17 +514,42 @@ void UiFont::precacheLatinAlphabetGlyphs()
 
 FontGlyph* UiFont::cacheGlyph(GlyphCode glyphCode, bool packAtlasNow)
 {
+	if (glyphSource)
+	{
+		return glyphSource->cacheGlyph(glyphCode, packAtlasNow);
+	}
+
 	if (!face)
 	{
 		return nullptr;
 	}
 
-	auto iter = glyphs.find(glyphCode);
+	if (glyphCode > maxGlyphCode)
+	{
+		return nullptr;
+	}
 
-	if (iter != glyphs.end() && !resizeFaceMode)
-		return iter->second;
+	auto cachedGlyph = findGlyph(glyphCode);
+
+	if (cachedGlyph && !resizeFaceMode)
+		return cachedGlyph;
+
+	u32 pageIndex = glyphCode >> FontGlyphPage::codeShift;
+	u32 pageGlyphIndex = glyphCode & (FontGlyphPage::glyphCount - 1);
+	u64 pageGlyphBit = 1ull << (pageGlyphIndex & 63);
+
+	if (pageIndex >= glyphPages.size())
+	{
+		glyphPages.resize(pageIndex + 1, nullptr);
+	}
 
-	FontGlyph* fontGlyph = resizeFaceMode ? iter->second : new FontGlyph();
+	if (!glyphPages[pageIndex])
+	{
+		glyphPages[pageIndex] = new FontGlyphPage();
+	}
+
+	auto page = glyphPages[pageIndex];
+	FontGlyph* fontGlyph = &page->glyphs[pageGlyphIndex];
 	FT_GlyphSlot slot = ((FT_Face)face)->glyph;
 
 	// FT_LCD_FILTER_LIGHT   is (0x00, 0x55, 0x56, 0x55, 0x00)
@@ -218,37 +567,58 @@ FontGlyph* UiFont::cacheGlyph(GlyphCode glyphCode, bool packAtlasNow)
 	flags |= FT_LOAD_TARGET_LCD;
 	FT_Library_SetLcdFilterWeights(freetypeLibHandle, lcd_weights);
 
+	// the distance field glyphs are scaled, so they're not fitted to the pixel grid of the size they're rasterized at
+	if (distanceField)
+		flags = FT_LOAD_NO_HINTING;
+
 	if (FT_Load_Glyph(
 		(FT_Face)face,
 		FT_Get_Char_Index((FT_Face)face, glyphCode),
-		flags))
+		flags)
+		|| FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL))
 	{
-		return nullptr;
-	}
+		// the resized glyphs keep their previous bitmap
+		if (!resizeFaceMode)
+			page->missingBits[pageGlyphIndex >> 6] |= pageGlyphBit;
 
-	if (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL))
-	{
 		return nullptr;
 	}
 
+	if (ctx && ctx->renderer)
+		ctx->renderer->getFrameStats().rasterizedGlyphCount++;
+
 	FT_Bitmap bitmap = slot->bitmap;
 	u32 width = bitmap.width;
 	u32 height = bitmap.rows;
-	Rgba32* rgbaBuffer = new Rgba32[width * height];
+	u32 padding = distanceField && width && height ? distanceFieldSpread : 0;
+	Rgba32* rgbaBuffer = nullptr;
 
-	for (int j = 0; j < height; ++j)
+	if (padding)
 	{
-		for (int i = 0; i < width; ++i)
+		width += padding * 2;
+		height += padding * 2;
+		rgbaBuffer = new Rgba32[width * height];
+		computeDistanceField(bitmap, padding, rgbaBuffer);
+	}
+	else
+	{
+		rgbaBuffer = new Rgba32[width * height];
+
+		for (int j = 0; j < height; ++j)
 		{
-			u8 lum = bitmap.buffer[i + width * j];
-			u32 index = (i + j * width);
-			rgbaBuffer[index] = ~0;
-			*((u8*)&(rgbaBuffer[index]) + 3) = lum;
+			for (int i = 0; i < width; ++i)
+			{
+				u8 lum = bitmap.buffer[i + width * j];
+				u32 index = (i + j * width);
+				rgbaBuffer[index] = ~0;
+				*((u8*)&(rgbaBuffer[index]) + 3) = lum;
+			}
 		}
 	}
 
 	fontGlyph->pixelWidth = width;
 	fontGlyph->pixelHeight = height;
+	fontGlyph->padding = padding;
 
 	if (resizeFaceMode)
 		delete[] fontGlyph->rgbaBuffer;
@@ -259,13 +629,21 @@ FontGlyph* UiFont::cacheGlyph(GlyphCode glyphCode, bool packAtlasNow)
 	fontGlyph->advanceY = ((FT_Face)face)->glyph->advance.y >> 6;
 	fontGlyph->bearingX = ((FT_Face)face)->glyph->metrics.horiBearingX >> 6;
 	fontGlyph->bearingY = ((FT_Face)face)->glyph->metrics.horiBearingY >> 6;
-	fontGlyph->bitmapLeft = ((FT_Face)face)->glyph->bitmap_left;
-	fontGlyph->bitmapTop = ((FT_Face)face)->glyph->bitmap_top;
+	fontGlyph->bitmapLeft = ((FT_Face)face)->glyph->bitmap_left - (i32)padding;
+	fontGlyph->bitmapTop = ((FT_Face)face)->glyph->bitmap_top + (i32)padding;
+
+	if (distanceField)
+	{
+		fontGlyph->advanceX = ((FT_Face)face)->glyph->linearHoriAdvance / 65536.0f;
+		fontGlyph->advanceY = ((FT_Face)face)->glyph->linearVertAdvance / 65536.0f;
+		fontGlyph->bearingX = ((FT_Face)face)->glyph->metrics.horiBearingX / 64.0f;
+		fontGlyph->bearingY = ((FT_Face)face)->glyph->metrics.horiBearingY / 64.0f;
+	}
 
 	// if we do not currently resizing the font glyphs, then create and insert the image into the atlas
 	if (!resizeFaceMode)
 	{
-		glyphs.insert(std::make_pair(glyphCode, fontGlyph));
+		page->presentBits[pageGlyphIndex >> 6] |= pageGlyphBit;
 		assert(rgbaBuffer);
 
 		auto image = atlas->addImage(
@@ -296,12 +674,12 @@ FontGlyph* UiFont::cacheGlyph(GlyphCode glyphCode, bool packAtlasNow)
 
 UiImage* UiFont::getGlyphImage(GlyphCode glyphCode)
 {
-	auto iter = glyphs.find(glyphCode);
+	auto glyph = findGlyph(glyphCode);
 
-	if (iter == glyphs.end())
+	if (!glyph)
 		return nullptr;
 
-	return iter->second->image;
+	return glyph->image;
 }
 
 FontTextSize UiFont::computeTextSize(const UnicodeString& text)
@@ -329,7 +707,7 @@ FontTextSize UiFont::computeTextSize(const GlyphCode* const text, u32 size)
 	{
 		auto chr = text[i];
 		auto glyph = getGlyph(chr);
-		auto glyphImage = glyph->image;
+		auto glyphImage = glyph ? glyph->image : nullptr;
 
 		if (chr == '\n')
 		{
@@ -345,10 +723,10 @@ FontTextSize UiFont::computeTextSize(const GlyphCode* const text, u32 size)
 
 		if (glyphImage && glyph)
 		{
-			f32 top = glyph->bearingY;
-			f32 bottom = -(glyph->pixelHeight - glyph->bearingY);
+			f32 top = glyph->bearingY * glyphScale;
+			f32 bottom = -((f32)(glyph->pixelHeight - glyph->padding * 2) - glyph->bearingY) * glyphScale;
 			auto kern = getKerning(lastChr, chr);
-			crtLineWidth += glyph->advanceX + kern;
+			crtLineWidth += glyph->advanceX * glyphScale + kern;
 			lastChr = chr;
 
 			if (fsize.maxGlyphHeight < fabs(top - bottom))
@@ -356,9 +734,9 @@ FontTextSize UiFont::computeTextSize(const GlyphCode* const text, u32 size)
 				fsize.maxGlyphHeight = fabs(top - bottom);
 			}
 
-			if (fsize.maxBearingY < glyph->bearingY)
+			if (fsize.maxBearingY < top)
 			{
-				fsize.maxBearingY = glyph->bearingY;
+				fsize.maxBearingY = top;
 			}
 		}
 	}
@@ -376,15 +754,137 @@ FontTextSize UiFont::computeTextSize(const GlyphCode* const text, u32 size)
 
 void UiFont::deleteGlyphs()
 {
-	for (auto glyph : glyphs)
+	for (auto page : glyphPages)
 	{
-		atlas->deleteImage(glyph.second->image);
-		delete[] glyph.second->rgbaBuffer;
-		delete glyph.second;
+		if (!page)
+			continue;
+
+		for (u32 i = 0; i < FontGlyphPage::glyphCount; i++)
+		{
+			if (page->isPresent(i))
+			{
+				atlas->deleteImage(page->glyphs[i].image);
+				delete[] page->glyphs[i].rgbaBuffer;
+			}
+		}
+
+		delete page;
 	}
 
 	kerningPairs.clear();
-	glyphs.clear();
+	glyphPages.clear();
+	deleteGlyphRuns();
+}
+
+const GlyphRun* UiFont::getGlyphRun(const UnicodeString& text)
+{
+	auto iter = glyphRuns.find(text);
+	GlyphRun* run = nullptr;
+
+	if (iter != glyphRuns.end())
+	{
+		run = iter->second;
+	}
+	else
+	{
+		run = new GlyphRun();
+		glyphRuns.insert(std::make_pair(text, run));
+	}
+
+	run->lastUsedFrame = ctx->frameCount;
+
+	if (iter != glyphRuns.end() && run->atlasRepackCount == atlas->getRepackCount())
+	{
+		ctx->renderer->getFrameStats().glyphRunCacheHitCount++;
+		return run;
+	}
+
+	ctx->renderer->getFrameStats().glyphRunCacheMissCount++;
+	layoutGlyphRun(text, *run);
+
+	return run;
+}
+
+const GlyphRun* UiFont::findGlyphRun(const UnicodeString& text) const
+{
+	auto iter = glyphRuns.find(text);
+
+	if (iter == glyphRuns.end() || iter->second->atlasRepackCount != atlas->getRepackCount())
+		return nullptr;
+
+	return iter->second;
+}
+
+void UiFont::layoutGlyphRun(const UnicodeString& text, GlyphRun& run)
+{
+	f32 x = 0;
+	GlyphCode lastChr = 0;
+
+	run.quads.clear();
+	run.hasRotatedQuads = false;
+
+	// the same layout as Renderer::drawTextInternal, the new glyphs are packed without moving the already packed ones
+	for (auto chr : text)
+	{
+		if (chr == '\n')
+		{
+			continue;
+		}
+
+		auto glyph = getGlyph(chr);
+
+		if (!glyph || !glyph->image)
+		{
+			continue;
+		}
+
+		auto image = glyph->image;
+		GlyphRunQuad quad;
+
+		x += getKerning(lastChr, chr);
+		quad.rect = Rect(
+			x + glyph->bitmapLeft * glyphScale,
+			-glyph->bitmapTop * glyphScale,
+			image->rect.width * glyphScale,
+			image->rect.height * glyphScale);
+		quad.uvRect = image->uvRect;
+		quad.textureIndex = image->atlasTexture->textureIndex | getGlyphTextureIndexFlags();
+		quad.rotated = image->rotated;
+		run.hasRotatedQuads |= image->rotated;
+		run.quads.push_back(quad);
+		x += glyph->advanceX * glyphScale;
+		lastChr = chr;
+	}
+
+	run.size = computeTextSize(text);
+	run.atlasRepackCount = atlas->getRepackCount();
+}
+
+void UiFont::pruneUnusedGlyphRuns(u32 maxUnusedFrames)
+{
+	auto iter = glyphRuns.begin();
+
+	while (iter != glyphRuns.end())
+	{
+		if (ctx->frameCount - iter->second->lastUsedFrame >= maxUnusedFrames)
+		{
+			delete iter->second;
+			iter = glyphRuns.erase(iter);
+			continue;
+		}
+
+		++iter;
+	}
+}
+
+void UiFont::deleteGlyphRuns()
+{
+	for (auto& run : glyphRuns)
+	{
+		delete run.second;
+	}
+
+	glyphRuns.clear();
 }
 
 }
\ No newline at end of file
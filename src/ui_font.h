@@ -19,11 +19,26 @@ struct FontGlyph
 	i32 bitmapTop = 0;
 	u32 pixelWidth = 0;
 	u32 pixelHeight = 0;
+	u32 padding = 0; /// the distance field spread around the glyph on each side, included in the bitmap size and placement
 	i32 pixelX = 0;
 	i32 pixelY = 0;
 	Rgba32* rgbaBuffer = nullptr;
 };
 
+/// A page of the glyph table, with the glyphs of 256 consecutive code points stored in place
+struct FontGlyphPage
+{
+	static const u32 glyphCount = 256;
+	static const u32 codeShift = 8;
+
+	bool isPresent(u32 index) const { return presentBits[index >> 6] & (1ull << (index & 63)); }
+	bool isMissing(u32 index) const { return missingBits[index >> 6] & (1ull << (index & 63)); }
+
+	FontGlyph glyphs[glyphCount];
+	u64 presentBits[glyphCount / 64] = {}; /// the cached glyphs
+	u64 missingBits[glyphCount / 64] = {}; /// the glyphs which failed to load, so they're not loaded again
+};
+
 struct FontKerningPair
 {
 	GlyphCode glyphLeft = 0;
@@ -31,6 +46,15 @@ struct FontKerningPair
 	f32 kerning = 0.0f;
 };
 
+/// The kernings of all the glyph pairs in a code point range, computed on the first kerning lookup of a font file
+/// and shared by all the fonts loaded from it, at any size
+struct FontKerningTable
+{
+	GlyphCode firstCode = 0;
+	u32 codeCount = 0;
+	std::vector<i16> kernings; /// indexed by the left code offset * codeCount + the right code offset, in font units
+};
+
 struct FontMetrics
 {
 	f32 height;
@@ -50,6 +74,42 @@ struct FontTextSize
 	std::vector<f32> lineHeights;
 };
 
+/// A glyph quad of a laid out text, relative to the text's rounded start position
+struct GlyphRunQuad
+{
+	Rect rect;
+	Rect uvRect;
+	u32 textureIndex = 0;
+	bool rotated = false;
+};
+
+/// A text laid out with a font, drawn by copying its quads instead of looking up each glyph and kerning pair
+struct GlyphRun
+{
+	std::vector<GlyphRunQuad> quads;
+	FontTextSize size;
+	bool hasRotatedQuads = false; /// some glyphs are rotated in the atlas, so the quads can't be queued in bulk
+	u32 atlasRepackCount = 0; /// the atlas repack count when laid out, the uv rects are stale when the atlas images were repacked since
+	u32 lastUsedFrame = 0;
+};
+
+struct UnicodeStringHash
+{
+	size_t operator()(const UnicodeString& text) const
+	{
+		u64 hash = 14695981039346656037ull;
+
+		// FNV-1a
+		for (auto chr : text)
+		{
+			hash ^= chr;
+			hash *= 1099511628211ull;
+		}
+
+		return (size_t)hash;
+	}
+};
+
 class UiFont
 {
 public:
@@ -58,11 +118,47 @@ public:
 	~UiFont();
 
 	void load(const std::string& fontFilename, u32 fontFaceSize, UiAtlas* themeAtlas);
+
+	/// Load a distance field font using the glyphs and kernings of another distance field font of the same face, only scaled to its own size
+	/// \param source the font with the glyphs, which must outlive this font
+	/// \param fontFaceSize the face size in pixels
+	void load(UiFont* source, u32 fontFaceSize);
+
+	/// Change the face size, the bitmap glyphs are rasterized again and the atlas must be repacked, the distance field glyphs are only scaled
+	/// \param fontFaceSize the new face size in pixels
 	void resetFaceSize(u32 fontFaceSize);
 	FontGlyph* getGlyph(GlyphCode glyphCode);
+
+	/// \return the cached glyph, null if it's not cached
+	FontGlyph* findGlyph(GlyphCode glyphCode) const
+	{
+		if (glyphSource)
+			return glyphSource->findGlyph(glyphCode);
+
+		u32 pageIndex = glyphCode >> FontGlyphPage::codeShift;
+
+		if (pageIndex >= glyphPages.size() || !glyphPages[pageIndex])
+			return nullptr;
+
+		auto page = glyphPages[pageIndex];
+		u32 index = glyphCode & (FontGlyphPage::glyphCount - 1);
+
+		return page->isPresent(index) ? &page->glyphs[index] : nullptr;
+	}
+
 	UiImage* getGlyphImage(GlyphCode glyphCode);
 	f32 getKerning(GlyphCode glyphCodeLeft, GlyphCode glyphCodeRight);
 	const FontMetrics& getMetrics() const { return metrics; }
+	const std::string& getFilename() const { return filename; }
+	u32 getFaceSize() const { return faceSize; }
+	/// \return true if the glyph images are signed distance fields, drawn with distanceFieldTextureIndexFlag
+	bool isDistanceField() const { return distanceField; }
+	/// \return the font this font's glyphs are shared from, null if it has its own glyphs
+	UiFont* getGlyphSource() const { return glyphSource; }
+	/// \return the scale of the glyph metrics and images to the face size, 1 for the bitmap glyphs
+	f32 getGlyphScale() const { return glyphScale; }
+	/// \return the texture index flags of the glyph images' vertices
+	u32 getGlyphTextureIndexFlags() const { return distanceField ? distanceFieldTextureIndexFlag : 0; }
 	void precacheGlyphs(const UnicodeString& glyphCodes);
 	void precacheGlyphs(u32* glyphs, u32 glyphCount);
 	void precacheLatinAlphabetGlyphs();
@@ -71,19 +167,52 @@ public:
 	FontTextSize computeTextSize(const char* text);
 	void deleteGlyphs();
 
+	/// Get the cached glyph run of a text, laying it out if it's not cached or the atlas images were repacked since
+	/// \param text the text
+	/// \return the glyph run
+	const GlyphRun* getGlyphRun(const UnicodeString& text);
+
+	/// Find the cached glyph run of a text, without laying it out or marking it as used, safe to call from several threads while no run is added
+	/// \param text the text
+	/// \return the glyph run, null if it's not cached or it's stale
+	const GlyphRun* findGlyphRun(const UnicodeString& text) const;
+
+	/// Delete the glyph runs which were not used in the last frames
+	/// \param maxUnusedFrames the frame count after which an unused glyph run is deleted
+	void pruneUnusedGlyphRuns(u32 maxUnusedFrames);
+	void deleteGlyphRuns();
+
 	UiAtlas* atlas = nullptr;
 
 protected:
 	FontGlyph* cacheGlyph(GlyphCode glyphCode, bool packAtlasNow = false);
+	bool isMissingGlyph(GlyphCode glyphCode) const;
+	void computeKerningTables();
+	void updateScaledMetrics();
+	/// \return the kerning at the rasterized face size
+	f32 getUnscaledKerning(GlyphCode glyphCodeLeft, GlyphCode glyphCodeRight);
+	void layoutGlyphRun(const UnicodeString& text, GlyphRun& run);
 
 	bool resizeFaceMode = false;
 	std::string filename;
 	u32 faceSize = 12;
 	f32 ascender = 0;
 	FontMetrics metrics;
+	FontMetrics unscaledMetrics; /// the metrics at the rasterized face size
+	bool distanceField = false;
+	u32 distanceFieldFaceSize = 0; /// the face size the distance field glyphs are rasterized at
+	u32 distanceFieldSpread = 0;
+	f32 glyphScale = 1.0f;
+	UiFont* glyphSource = nullptr;
 	void* face = 0;
-	std::unordered_map<GlyphCode, FontGlyph*> glyphs;
-	std::unordered_map<u64, f32> kerningPairs;
+	static const GlyphCode maxGlyphCode = 0x10FFFF;
+	std::vector<FontGlyphPage*> glyphPages; /// indexed by the code point's page, allocated when a glyph in the page is cached
+	bool hasKerning = false; /// if the font has no kerning, the kerning lookups are skipped
+	const std::vector<FontKerningTable>* kerningTables = nullptr; /// shared by the fonts of the same file, null until the first kerning lookup
+	f32 kerningScale = 0; /// the pixels per font unit at the rasterized face size
+	f32 kerningFitScale = 1; /// the small bitmap sizes' kerning reduction, as FreeType's FT_KERNING_DEFAULT does it
+	std::unordered_map<u64, f32> kerningPairs; /// the pairs outside the kerning tables, cached on use
+	std::unordered_map<UnicodeString, GlyphRun*, UnicodeStringHash> glyphRuns;
 };
 
 }
\ No newline at end of file
@@ -12,6 +12,11 @@ UiTheme::UiTheme(u32 atlasTextureSize)
 
 UiTheme::~UiTheme()
 {
+	for (auto image : shapeImages)
+	{
+		delete image;
+	}
+
 	delete fontCache;
 	delete atlas;
 }
@@ -26,6 +31,21 @@ UiImage* UiTheme::addImage(const Rgba32* pixels, u32 width, u32 height)
 	return atlas->addImage(pixels, width, height);
 }
 
+UiImage* UiTheme::addShapeImage(const Shape& shape, u32 width, u32 height)
+{
+	UiImage* image = new UiImage();
+
+	image->atlas = atlas;
+	image->width = width;
+	image->height = height;
+	image->rect = { 0, 0, (f32)width, (f32)height };
+	image->isShape = true;
+	image->shape = shape;
+	shapeImages.push_back(image);
+
+	return image;
+}
+
 void UiTheme::packAtlas()
 {
 	atlas->pack();
@@ -13,12 +13,15 @@ public:
 	~UiTheme();
 
 	UiImage* addImage(const Rgba32* pixels, u32 width, u32 height);
+	/// Add an image drawn as a shape, it's not packed in the atlas
+	UiImage* addShapeImage(const Shape& shape, u32 width, u32 height);
 	void packAtlas();
 	inline UiThemeElement& getElement(WidgetElementId id) { return elements[(u32)id]; }
 	void setDefaultWidgetStyle();
 
 	std::unordered_map<std::string, UiFont*> fonts;
 	std::unordered_map<std::string, UiImage*> images;
+	std::vector<UiImage*> shapeImages;
 	UiThemeElement elements[(int)WidgetElementId::Count];
 	std::unordered_map<std::string, UiThemeElement*> userElements;
 	std::unordered_map<std::string, std::string> userSettings;
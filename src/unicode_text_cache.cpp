@@ -4,95 +4,364 @@
 #include <algorithm>
 #include <string.h>
 #include "ui_context.h"
+#include "renderer.h"
 
 namespace hui
 {
 UnicodeTextCache::UnicodeTextCache()
-{}
+{
+	slots.resize(1024, nullptr);
+}
 
 UnicodeTextCache::~UnicodeTextCache()
 {
-	for (auto txt : texts)
+	for (auto block : entryBlocks)
+	{
+		delete[] block;
+	}
+
+	for (auto text : volatileTexts)
 	{
-		delete txt.second.text;
+		delete text;
 	}
 }
 
+u64 UnicodeTextCache::hashText(const char* text, size_t size)
+{
+	u64 hash = 14695981039346656037ull;
+
+	// FNV-1a
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (u8)text[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
 UnicodeString* UnicodeTextCache::getText(const char* text)
 {
-	auto iter = texts.find((const char*)text);
+	u64 hash = 14695981039346656037ull;
+	size_t size = 0;
+
+	// hash and measure the text in one pass
+	for (; text[size]; size++)
+	{
+		hash ^= (u8)text[size];
+		hash *= 1099511628211ull;
+	}
+
+	return getText(text, size, hash);
+}
+
+UnicodeString* UnicodeTextCache::getText(const char* text, size_t size, u64 hash)
+{
+	bool isVolatile = isVolatileText(text, hash);
+	auto entry = findText(text, size, hash);
 
-	if (iter == texts.end())
+	if (!entry)
 	{
-		UnicodeString* txt = new UnicodeString();
+		// the texts changing every frame would only flood the cache
+		if (isVolatile)
+		{
+			ctx->renderer->getFrameStats().textCacheBypassCount++;
+			return convertVolatileText(text, size);
+		}
+
+		ctx->renderer->getFrameStats().textCacheMissCount++;
+		entry = allocateText();
+		entry->text.clear();
 
 		try
 		{
-			utf8::utf8to32((char*)text, (char*)(text + strlen((const char*)text)), std::back_inserter(*txt));
+			utf8::utf8to32(text, text + size, std::back_inserter(entry->text));
 		}
 
 		catch (utf8::invalid_utf8 ex)
 		{
-			delete txt;
+			entry->newer = freeTexts;
+			freeTexts = entry;
 			return nullptr;
 		}
 
-		CachedText ct;
+		entry->hash = hash;
+		entry->utf8Text.assign(text, size);
+		entry->byteSize = sizeof(CachedText) + entry->utf8Text.capacity() + entry->text.capacity() * sizeof(GlyphCode);
+		entry->lastUsedFrame = ctx->frameCount;
+		insertText(entry);
+		evictTexts();
+	}
+	else
+	{
+		ctx->renderer->getFrameStats().textCacheHitCount++;
+		entry->lastUsedFrame = ctx->frameCount;
+		touchText(entry);
+	}
 
-		ct.text = txt;
+	if (ctx->settings.textCachePruneMode == TextCachePruneMode::Time)
+	{
+		entry->lastUsedTimeOrFrame = ctx->totalTime;
+	}
+	else
+	{
+		entry->lastUsedTimeOrFrame = ctx->frameCount;
+	}
+
+	return &entry->text;
+}
 
+void UnicodeTextCache::pruneUnusedTexts()
+{
+	// the least recently used texts are at the end of the list, stop at the first one still in use
+	while (oldestText)
+	{
 		if (ctx->settings.textCachePruneMode == TextCachePruneMode::Time)
 		{
-			ct.lastUsedTimeOrFrame = ctx->totalTime;
+			if (ctx->totalTime - oldestText->lastUsedTimeOrFrame < ctx->settings.textCachePruneMaxTimeSec)
+				break;
 		}
 		else
 		{
-			ct.lastUsedTimeOrFrame = ctx->frameCount;
+			if (ctx->frameCount - oldestText->lastUsedTimeOrFrame < ctx->settings.textCachePruneMaxFrames)
+				break;
 		}
 
-		texts.insert(std::make_pair((const char*)text, ct));
-		return txt;
+		removeText(oldestText);
 	}
+}
 
-	if (ctx->settings.textCachePruneMode == TextCachePruneMode::Time)
+UnicodeTextCache::CachedText* UnicodeTextCache::findText(const char* text, size_t size, u64 hash) const
+{
+	u32 mask = slots.size() - 1;
+
+	for (u32 i = hash & mask; slots[i]; i = (i + 1) & mask)
 	{
-		iter->second.lastUsedTimeOrFrame = ctx->totalTime;
+		auto entry = slots[i];
+
+		if (entry->hash == hash
+			&& entry->utf8Text.size() == size
+			&& !memcmp(entry->utf8Text.data(), text, size))
+		{
+			return entry;
+		}
 	}
-	else
+
+	return nullptr;
+}
+
+UnicodeTextCache::CachedText* UnicodeTextCache::allocateText()
+{
+	if (!freeTexts)
 	{
-		iter->second.lastUsedTimeOrFrame = ctx->frameCount;
+		auto block = new CachedText[entryBlockSize];
+
+		entryBlocks.push_back(block);
+
+		for (u32 i = 0; i < entryBlockSize; i++)
+		{
+			block[i].newer = freeTexts;
+			freeTexts = &block[i];
+		}
 	}
 
-	return iter->second.text;
+	// the free entries keep their buffers, so the texts fitting in them are not allocated again
+	auto entry = freeTexts;
+
+	freeTexts = entry->newer;
+	entry->newer = nullptr;
+	entry->older = nullptr;
+
+	return entry;
 }
 
-void UnicodeTextCache::pruneUnusedTexts()
+void UnicodeTextCache::insertText(CachedText* entry)
 {
-	auto iter = texts.begin();
+	// keep the table at most half full
+	if ((textCount + 1) * 2 > slots.size())
+	{
+		growSlots();
+	}
+
+	u32 mask = slots.size() - 1;
+	u32 i = entry->hash & mask;
 
-	while (iter != texts.end())
+	while (slots[i])
 	{
-		if (ctx->settings.textCachePruneMode == TextCachePruneMode::Time)
+		i = (i + 1) & mask;
+	}
+
+	slots[i] = entry;
+	textCount++;
+	byteSize += entry->byteSize;
+
+	entry->older = newestText;
+	entry->newer = nullptr;
+
+	if (newestText)
+		newestText->newer = entry;
+	else
+		oldestText = entry;
+
+	newestText = entry;
+}
+
+void UnicodeTextCache::removeText(CachedText* entry)
+{
+	u32 mask = slots.size() - 1;
+	u32 i = entry->hash & mask;
+
+	while (slots[i] != entry)
+	{
+		i = (i + 1) & mask;
+	}
+
+	slots[i] = nullptr;
+
+	// shift back the next entries of the probe sequence, which are not at their home slot
+	for (u32 j = (i + 1) & mask; slots[j]; j = (j + 1) & mask)
+	{
+		u32 home = slots[j]->hash & mask;
+		bool homeInHole = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+
+		if (homeInHole)
 		{
-			if (ctx->totalTime - iter->second.lastUsedTimeOrFrame >= ctx->settings.textCachePruneMaxTimeSec)
-			{
-				delete iter->second.text;
-				iter = texts.erase(iter);
-				continue;
-			}
+			slots[i] = slots[j];
+			slots[j] = nullptr;
+			i = j;
 		}
-		else
+	}
+
+	unlinkText(entry);
+	textCount--;
+	byteSize -= entry->byteSize;
+	entry->newer = freeTexts;
+	freeTexts = entry;
+}
+
+void UnicodeTextCache::touchText(CachedText* entry)
+{
+	if (entry == newestText)
+		return;
+
+	unlinkText(entry);
+	entry->older = newestText;
+	entry->newer = nullptr;
+	newestText->newer = entry;
+	newestText = entry;
+}
+
+void UnicodeTextCache::unlinkText(CachedText* entry)
+{
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		newestText = entry->older;
+
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		oldestText = entry->newer;
+
+	entry->newer = nullptr;
+	entry->older = nullptr;
+}
+
+void UnicodeTextCache::growSlots()
+{
+	std::vector<CachedText*> oldSlots;
+
+	oldSlots.swap(slots);
+	slots.resize(oldSlots.size() * 2, nullptr);
+
+	u32 mask = slots.size() - 1;
+
+	for (auto entry : oldSlots)
+	{
+		if (!entry)
+			continue;
+
+		u32 i = entry->hash & mask;
+
+		while (slots[i])
 		{
-			if (ctx->frameCount - iter->second.lastUsedTimeOrFrame >= ctx->settings.textCachePruneMaxFrames)
-			{
-				delete iter->second.text;
-				iter = texts.erase(iter);
-				continue;
-			}
+			i = (i + 1) & mask;
 		}
 
-		++iter;
+		slots[i] = entry;
+	}
+}
+
+bool UnicodeTextCache::isVolatileText(const char* text, u64 hash)
+{
+	auto& source = textSources[((uintptr_t)text >> 4) % textSourceCount];
+
+	if (source.text != text)
+	{
+		source.text = text;
+		source.firstHashInFrame = hash;
+		source.frame = ctx->frameCount;
+		source.changedFrameCount = 0;
+		return false;
 	}
+
+	// only compare the first text in each frame, a buffer reused for several texts in a frame is not volatile if they don't change
+	if (source.frame != ctx->frameCount)
+	{
+		if (source.firstHashInFrame != hash)
+			source.changedFrameCount++;
+		else
+			source.changedFrameCount = 0;
+
+		source.firstHashInFrame = hash;
+		source.frame = ctx->frameCount;
+	}
+
+	return ctx->settings.textCacheVolatileFrameCount
+		&& source.changedFrameCount >= ctx->settings.textCacheVolatileFrameCount;
 }
 
+UnicodeString* UnicodeTextCache::convertVolatileText(const char* text, size_t size)
+{
+	if (volatileTextFrame != ctx->frameCount)
+	{
+		volatileTextFrame = ctx->frameCount;
+		volatileTextCount = 0;
+	}
+
+	if (volatileTextCount == volatileTexts.size())
+	{
+		volatileTexts.push_back(new UnicodeString());
+	}
+
+	auto str = volatileTexts[volatileTextCount];
+
+	str->clear();
+
+	try
+	{
+		utf8::utf8to32(text, text + size, std::back_inserter(*str));
+	}
+
+	catch (utf8::invalid_utf8 ex)
+	{
+		return nullptr;
+	}
+
+	volatileTextCount++;
+
+	return str;
+}
+
+void UnicodeTextCache::evictTexts()
+{
+	// the texts used in this frame can be in the recorded draw commands, so they're kept even if over the budget
+	while (byteSize > ctx->settings.textCacheMaxByteSize
+		&& oldestText
+		&& oldestText->lastUsedFrame != ctx->frameCount)
+	{
+		removeText(oldestText);
+	}
 }
+
+}
\ No newline at end of file
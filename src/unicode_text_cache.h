@@ -1,27 +1,80 @@
 #pragma once
-#include <unordered_map>
+#include <vector>
 #include <string>
 #include "types.h"
 
 namespace hui
 {
+/// Caches the UTF-32 conversion of the UTF-8 texts drawn or measured by the widgets.
+/// The lookups don't allocate, the entries come from a pool and are reused with their buffers,
+/// the least recently used ones are evicted when over the memory budget, and the texts which
+/// change every frame from the same buffer (like counters) are converted into per frame buffers instead of being cached
 class UnicodeTextCache
 {
 public:
 	UnicodeTextCache();
 	~UnicodeTextCache();
-	//TODO: warning for dynamic text that can change per frame, maybe that should not be cached
-	// or just convert from utf8 to utf32 directly every frame, check speed
+	/// Get the UTF-32 text, valid until the next frame
+	/// \param text the zero terminated UTF-8 text
+	/// \return the text, null if it's not valid UTF-8
 	UnicodeString* getText(const char* text);
+	/// Get the UTF-32 text, valid until the next frame
+	/// \param text the UTF-8 text, not zero terminated
+	/// \param size the text size in bytes
+	/// \param hash the text hash computed with hashText
+	/// \return the text, null if it's not valid UTF-8
+	UnicodeString* getText(const char* text, size_t size, u64 hash);
 	void pruneUnusedTexts();
+	size_t getByteSize() const { return byteSize; }
+	static u64 hashText(const char* text, size_t size);
 
 protected:
 	struct CachedText
 	{
-		UnicodeString* text = nullptr;
+		u64 hash = 0;
+		std::string utf8Text;
+		UnicodeString text;
 		f32 lastUsedTimeOrFrame = 0;
+		u32 lastUsedFrame = 0;
+		size_t byteSize = 0;
+		CachedText* newer = nullptr; /// the next entry in the LRU list, to the most recently used one, or the next free entry
+		CachedText* older = nullptr;
 	};
-	std::unordered_map<std::string, CachedText> texts;
+
+	/// Tracks the texts passed from the same buffer, to find the ones changing every frame
+	struct TextSource
+	{
+		const char* text = nullptr;
+		u64 firstHashInFrame = 0;
+		u32 frame = 0;
+		u32 changedFrameCount = 0;
+	};
+
+	static const u32 entryBlockSize = 256;
+	static const u32 textSourceCount = 64;
+
+	CachedText* findText(const char* text, size_t size, u64 hash) const;
+	CachedText* allocateText();
+	void insertText(CachedText* entry);
+	void removeText(CachedText* entry);
+	void touchText(CachedText* entry);
+	void unlinkText(CachedText* entry);
+	void growSlots();
+	bool isVolatileText(const char* text, u64 hash);
+	UnicodeString* convertVolatileText(const char* text, size_t size);
+	void evictTexts();
+
+	std::vector<CachedText*> slots; /// open addressing hash table, linear probing, the size is a power of two
+	u32 textCount = 0;
+	size_t byteSize = 0;
+	CachedText* newestText = nullptr;
+	CachedText* oldestText = nullptr;
+	CachedText* freeTexts = nullptr;
+	std::vector<CachedText*> entryBlocks;
+	TextSource textSources[textSourceCount];
+	std::vector<UnicodeString*> volatileTexts; /// the volatile texts converted in the current frame, the buffers are reused next frame
+	u32 volatileTextCount = 0;
+	u32 volatileTextFrame = 0;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+namespace hui
+{
+WorkerPool::~WorkerPool()
+{
+	stopThreads();
+}
+
+void WorkerPool::setThreadCount(u32 threadCount)
+{
+	if (!threadCount)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	if (threadCount == getThreadCount())
+	{
+		return;
+	}
+
+	stopThreads();
+	stopping = false;
+
+	for (u32 i = 1; i < threadCount; i++)
+	{
+		threads.emplace_back(&WorkerPool::workerThread, this, generation);
+	}
+}
+
+void WorkerPool::run(u32 jobCount, const std::function<void(u32)>& job)
+{
+	if (threads.empty() || jobCount < 2)
+	{
+		for (u32 i = 0; i < jobCount; i++)
+		{
+			job(i);
+		}
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		currentJob = &job;
+		currentJobCount = jobCount;
+		nextJobIndex = 0;
+		busyThreadCount = threads.size();
+		generation++;
+	}
+
+	startCondition.notify_all();
+	runJobs();
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	doneCondition.wait(lock, [this]() { return busyThreadCount == 0; });
+	currentJob = nullptr;
+}
+
+void WorkerPool::workerThread(u64 lastGeneration)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			startCondition.wait(lock, [&]() { return stopping || generation != lastGeneration; });
+
+			if (stopping)
+			{
+				return;
+			}
+
+			lastGeneration = generation;
+		}
+
+		runJobs();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyThreadCount--;
+		}
+
+		doneCondition.notify_one();
+	}
+}
+
+void WorkerPool::runJobs()
+{
+	u32 index;
+
+	while ((index = nextJobIndex++) < currentJobCount)
+	{
+		(*currentJob)(index);
+	}
+}
+
+void WorkerPool::stopThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	startCondition.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	threads.clear();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include "types.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace hui
+{
+/// A small pool of persistent threads, running indexed jobs and waiting for all of them to finish
+class WorkerPool
+{
+public:
+	~WorkerPool();
+
+	/// Set the worker thread count, the calling thread also runs jobs, so there is one less worker thread created
+	/// \param threadCount the total thread count, 0 will use all the hardware threads
+	void setThreadCount(u32 threadCount);
+	/// \return the total thread count, including the calling thread
+	u32 getThreadCount() const { return threads.size() + 1; }
+	/// Run the jobs on the worker threads and the calling thread, returns after all the jobs are done
+	/// \param jobCount the job count, each job is called with its index
+	/// \param job the job function, must be thread safe
+	void run(u32 jobCount, const std::function<void(u32)>& job);
+
+protected:
+	/// \param lastGeneration the run generation when the thread was created, only the newer runs are joined
+	void workerThread(u64 lastGeneration);
+	void runJobs();
+	void stopThreads();
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+	const std::function<void(u32)>* currentJob = nullptr;
+	u32 currentJobCount = 0;
+	std::atomic<u32> nextJobIndex { 0 };
+	u32 busyThreadCount = 0;
+	u64 generation = 0;
+	bool stopping = false;
+};
+
+}
\ No newline at end of file
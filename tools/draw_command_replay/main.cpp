@@ -0,0 +1,154 @@
+// Replays a draw command capture, saved with hui::captureNextFrameDrawCommands, headless and without the application,
+// to profile the renderer on a real frame or to render it into an image
+#include "horus.h"
+#include "headless_graphics_provider.h"
+#include "null_input_provider.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace hui;
+
+struct ReplaySettings
+{
+	std::string captureFilename;
+	std::string fontFolder;
+	std::string imageFilename;
+	u32 iterationCount = 100;
+	u32 threadCount = 1;
+	bool software = false;
+	bool printEachFrame = false;
+};
+
+static ReplaySettings settings;
+
+static void printUsage()
+{
+	printf("Usage: draw_command_replay <capture file> [options]\n");
+	printf("  --iterations N    how many times to replay the frame (default 100)\n");
+	printf("  --fonts PATH      load the captured fonts from this folder instead of their captured paths\n");
+	printf("  --threads N       vertex generation threads, 0 for all hardware threads (default 1)\n");
+	printf("  --software        rasterize the frames instead of discarding the draws\n");
+	printf("  --image FILE      save the last replayed frame as a PPM image, implies --software\n");
+	printf("  --stats           print the stats of each replayed frame\n");
+}
+
+static bool parseArgs(int argc, char** args)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = args[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--iterations" && hasValue) settings.iterationCount = atoi(args[++i]);
+		else if (arg == "--fonts" && hasValue) settings.fontFolder = args[++i];
+		else if (arg == "--threads" && hasValue) settings.threadCount = atoi(args[++i]);
+		else if (arg == "--software") settings.software = true;
+		else if (arg == "--image" && hasValue) { settings.imageFilename = args[++i]; settings.software = true; }
+		else if (arg == "--stats") settings.printEachFrame = true;
+		else if (arg[0] != '-' && settings.captureFilename.empty()) settings.captureFilename = arg;
+		else return false;
+	}
+
+	return !settings.captureFilename.empty() && settings.iterationCount;
+}
+
+static void printStats(const FrameStats& stats)
+{
+	printf("commands: %u batches: %u/%u vertices: %u uploaded: %llu bytes",
+		stats.drawCommandCount,
+		stats.drawnBatchCount,
+		stats.generatedBatchCount,
+		stats.vertexCount,
+		(unsigned long long)stats.uploadedByteCount);
+	printf(" damage: %.3f tessellate: %.3f merge: %.3f upload: %.3f submit: %.3f ms\n",
+		stats.phaseTime[(u32)FramePhase::Damage],
+		stats.phaseTime[(u32)FramePhase::Tessellate],
+		stats.phaseTime[(u32)FramePhase::Merge],
+		stats.phaseTime[(u32)FramePhase::Upload],
+		stats.phaseTime[(u32)FramePhase::Submit]);
+}
+
+int main(int argc, char** args)
+{
+	if (!parseArgs(argc, args))
+	{
+		printUsage();
+		return 1;
+	}
+
+	auto inputProvider = new NullInputProvider();
+	auto gfxProvider = new HeadlessGraphicsProvider(settings.software ? HeadlessRenderMode::Software : HeadlessRenderMode::Null);
+	auto ctx = createContext(inputProvider, gfxProvider);
+
+	getContextSettings().vertexGenerationThreadCount = settings.threadCount;
+	auto wnd = inputProvider->createWindow("draw_command_replay", 1, 1);
+	gfxProvider->initialize();
+	initializeContext(ctx);
+
+	// the theme is not used by the replayed commands, but the frame starts by selecting its atlas
+	setTheme(createTheme(512));
+
+	auto capture = loadDrawCommandCapture(
+		settings.captureFilename.c_str(),
+		settings.fontFolder.empty() ? nullptr : settings.fontFolder.c_str());
+
+	if (!capture)
+	{
+		fprintf(stderr, "Cannot load the capture '%s'\n", settings.captureFilename.c_str());
+		return 1;
+	}
+
+	auto windowSize = getDrawCommandCaptureWindowSize(capture);
+
+	inputProvider->setWindowRect(wnd, { 0, 0, windowSize.x, windowSize.y });
+
+	FrameStats total;
+
+	for (u32 i = 0; i < settings.iterationCount; i++)
+	{
+		processInputEvents();
+		forceRepaint();
+		beginFrame();
+		setWindow(wnd);
+		beginWindow(wnd);
+		replayDrawCommandCapture(capture);
+		endWindow();
+		endFrame();
+
+		auto& stats = getFrameStats();
+
+		if (settings.printEachFrame)
+			printStats(stats);
+
+		for (u32 p = 0; p < (u32)FramePhase::Count; p++)
+		{
+			total.phaseTime[p] += stats.phaseTime[p];
+		}
+
+		total.drawCommandCount = stats.drawCommandCount;
+		total.generatedBatchCount = stats.generatedBatchCount;
+		total.drawnBatchCount = stats.drawnBatchCount;
+		total.vertexCount = stats.vertexCount;
+		total.uploadedByteCount = stats.uploadedByteCount;
+	}
+
+	for (u32 p = 0; p < (u32)FramePhase::Count; p++)
+	{
+		total.phaseTime[p] /= settings.iterationCount;
+	}
+
+	printf("Replayed '%s' (%dx%d) %u times, average frame:\n",
+		settings.captureFilename.c_str(), (i32)windowSize.x, (i32)windowSize.y, settings.iterationCount);
+	printStats(total);
+
+	if (!settings.imageFilename.empty() && !gfxProvider->saveFramebuffer(settings.imageFilename.c_str()))
+	{
+		fprintf(stderr, "Cannot write '%s'\n", settings.imageFilename.c_str());
+	}
+
+	deleteDrawCommandCapture(capture);
+	shutdown();
+
+	return 0;
+}
\ No newline at end of file
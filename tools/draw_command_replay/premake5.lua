@@ -0,0 +1,22 @@
+project "draw_command_replay"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++11"
+
+	warnings "off"
+	files {
+		"../../examples/common/headless_graphics_provider.*",
+		"../../examples/common/null_input_provider.*",
+		"*.cpp"
+	}
+
+	includedirs {
+		".",
+		"../../include",
+		"../../examples/common"
+	}
+
+	defines "_CONSOLE"
+
+	using { "horus_static" }
+	distcopy(mytarget())
\ No newline at end of file
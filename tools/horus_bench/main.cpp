@@ -0,0 +1,785 @@
+// Runs scripted UI scenarios headless, for a fixed number of frames, and writes the phase timings,
+// allocation counts and renderer counters as JSON, used to compare releases and catch regressions
+#include "horus.h"
+#include "headless_graphics_provider.h"
+#include "null_input_provider.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace hui;
+
+//////////////////////////////////////////////////////////////////////////
+// Allocation counting, the library is linked statically so its allocations go through these too
+//////////////////////////////////////////////////////////////////////////
+
+static std::atomic<u64> allocationCount(0);
+static std::atomic<u64> allocatedByteCount(0);
+
+void* operator new(size_t size)
+{
+	allocationCount++;
+	allocatedByteCount += size;
+
+	void* ptr = malloc(size ? size : 1);
+
+	if (!ptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Scenarios
+//////////////////////////////////////////////////////////////////////////
+
+struct BenchSettings
+{
+	u32 frameCount = 300;
+	u32 warmupFrameCount = 10;
+	u32 width = 1280;
+	u32 height = 720;
+	u32 threadCount = 1;
+	bool software = false;
+	bool partialRedraw = false;
+	bool shaderClipping = false;
+	bool tessellateShapes = false;
+	bool noGlyphRunCache = false;
+	bool distanceFieldGlyphs = false;
+	std::string dataPath = "../themes";
+	std::string outputFilename;
+	std::string scenarioName;
+};
+
+struct Scenario
+{
+	const char* name;
+	void(*setup)();
+	void(*frame)(u32 frameIndex);
+	void(*input)(u32 frameIndex); /// adds the scripted input events for the frame
+	void(*teardown)();
+	bool docking;
+};
+
+BenchSettings settings;
+NullInputProvider* inputProvider = nullptr;
+HeadlessGraphicsProvider* gfxProvider = nullptr;
+Theme theme = 0;
+
+static void addMouseEvent(InputEvent::Type type, const Point& point)
+{
+	InputEvent ev;
+
+	ev.type = type;
+	ev.window = getMainWindow();
+	ev.mouse.button = MouseButton::Left;
+	ev.mouse.point = point;
+	inputProvider->mousePosition = point;
+	addInputEvent(ev);
+}
+
+// 10k labels, in four columns, most of them outside the window
+std::vector<std::string> labelTexts;
+
+static void setupLabels()
+{
+	labelTexts.resize(10000);
+
+	for (size_t i = 0; i < labelTexts.size(); i++)
+	{
+		labelTexts[i] = "Label number " + std::to_string(i);
+	}
+}
+
+static void frameLabels(u32 frameIndex)
+{
+	const u32 columnCount = 4;
+	u32 perColumn = (u32)labelTexts.size() / columnCount;
+
+	beginFourColumns();
+
+	for (u32 c = 0; c < columnCount; c++)
+	{
+		for (u32 i = 0; i < perColumn; i++)
+		{
+			label(labelTexts[c * perColumn + i].c_str());
+		}
+
+		if (c < columnCount - 1)
+			nextColumn();
+	}
+
+	endColumns();
+}
+
+// the same labels in a cached layer, its render target is drawn only in the first frame
+static void frameCachedLabels(u32 frameIndex)
+{
+	beginCachedLayer(1, { 0, 0, (f32)settings.width, (f32)settings.height });
+	frameLabels(frameIndex);
+	endCachedLayer();
+}
+
+// deeply nested two column layouts
+static void nestColumns(u32 depth)
+{
+	beginTwoColumns();
+	label("Nested");
+	button("Button");
+	nextColumn();
+
+	if (depth)
+		nestColumns(depth - 1);
+	else
+		label("Leaf");
+
+	endColumns();
+}
+
+static void frameNestedColumns(u32 frameIndex)
+{
+	for (u32 i = 0; i < 16; i++)
+	{
+		nestColumns(12);
+	}
+}
+
+// a long scroll view, scrolled a bit every frame
+f32 scrollPosition = 0;
+bool scrollChecks[5000] = { false };
+f32 scrollSliders[5000] = { 0 };
+
+static void setupScrollView()
+{
+	labelTexts.resize(5000);
+
+	for (size_t i = 0; i < labelTexts.size(); i++)
+	{
+		labelTexts[i] = "Row " + std::to_string(i);
+	}
+}
+
+static void frameScrollView(u32 frameIndex)
+{
+	beginScrollView(settings.height - 20, scrollPosition);
+
+	for (u32 i = 0; i < 5000; i++)
+	{
+		beginTwoColumns();
+		label(labelTexts[i].c_str());
+		nextColumn();
+		scrollChecks[i] = check("Enabled", scrollChecks[i]);
+		sliderFloat(0, 100, scrollSliders[i]);
+		endColumns();
+	}
+
+	endScrollView();
+	scrollPosition = fmodf(frameIndex * 37.0f, 5000 * 20.0f);
+}
+
+// many docked view panes, each with a few tabs
+struct BenchViewHandler : ViewHandler
+{
+	void onViewRender(Window window, Window viewPane, ViewId activeViewId, u64 userDataId) override
+	{
+		static f32 value = 50;
+		static bool checked = false;
+
+		label("Properties");
+		button("Apply");
+		checked = check("Enabled", checked);
+		sliderFloat(0, 100, value);
+
+		for (u32 i = 0; i < 10; i++)
+		{
+			label("Some property value");
+		}
+	}
+} benchViewHandler;
+
+ViewContainer benchViewContainer = 0;
+
+static void setupDockPanes()
+{
+	const DockType dockTypes[] = { DockType::Left, DockType::Right, DockType::Top, DockType::Bottom };
+
+	setCurrentViewHandler(&benchViewHandler);
+	benchViewContainer = createViewContainer(getMainWindow());
+
+	ViewPane parentPane = createViewPane(benchViewContainer, DockType::Left);
+
+	addViewPaneTab(parentPane, "Pane", 1, 0);
+
+	for (u32 i = 1; i < 48; i++)
+	{
+		ViewPane pane = i % 3 == 0
+			? createViewPane(benchViewContainer, dockTypes[i % 4])
+			: createChildViewPane(parentPane, dockTypes[i % 4]);
+
+		for (u32 t = 0; t < 3; t++)
+		{
+			addViewPaneTab(pane, "Pane tab", 1, i * 3 + t);
+		}
+
+		parentPane = pane;
+	}
+}
+
+static void teardownDockPanes()
+{
+	deleteViewContainer(benchViewContainer);
+	benchViewContainer = 0;
+}
+
+// a menu bar with an opened menu and a few popups
+Point fileMenuCenter;
+
+static void frameMenusAndPopups(u32 frameIndex)
+{
+	const char* menuNames[] = { "File", "Edit", "View", "Project", "Build", "Tools", "Window", "Help" };
+
+	beginMenuBar();
+
+	for (u32 m = 0; m < 8; m++)
+	{
+		bool opened = beginMenu(menuNames[m]);
+
+		if (m == 0)
+			fileMenuCenter = getWidgetRect().center();
+
+		if (opened)
+		{
+			for (u32 i = 0; i < 24; i++)
+			{
+				menuItem("Menu item", "Ctrl+Shift+X");
+			}
+
+			endMenu();
+		}
+	}
+
+	endMenuBar();
+
+	for (u32 p = 0; p < 4; p++)
+	{
+		beginPopup(300, PopupFlags::CustomPosition, { 40.0f + p * 220.0f, 80.0f + p * 60.0f });
+		label("Popup");
+
+		for (u32 i = 0; i < 12; i++)
+		{
+			button("Popup button");
+		}
+
+		endPopup();
+	}
+}
+
+static void inputMenusAndPopups(u32 frameIndex)
+{
+	// open the first menu once its position is known
+	if (frameIndex == 1)
+		addMouseEvent(InputEvent::Type::MouseDown, fileMenuCenter);
+}
+
+// a large multiline text
+std::string multilineText;
+
+static void setupMultilineText()
+{
+	const char* lorem = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. "
+		"Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat. ";
+
+	multilineText.clear();
+
+	for (u32 i = 0; i < 300; i++)
+	{
+		multilineText += lorem;
+	}
+}
+
+static void frameMultilineText(u32 frameIndex)
+{
+	multilineLabel(multilineText.c_str(), HAlignType::Left);
+}
+
+// thousands of different glyphs, in several font sizes
+std::vector<Font> glyphFonts;
+std::vector<std::string> glyphLines;
+
+static void appendUtf8(std::string& str, u32 codepoint)
+{
+	if (codepoint < 0x80)
+	{
+		str += (char)codepoint;
+	}
+	else if (codepoint < 0x800)
+	{
+		str += (char)(0xC0 | (codepoint >> 6));
+		str += (char)(0x80 | (codepoint & 0x3F));
+	}
+	else
+	{
+		str += (char)(0xE0 | (codepoint >> 12));
+		str += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		str += (char)(0x80 | (codepoint & 0x3F));
+	}
+}
+
+static void setupGlyphAtlas()
+{
+	// latin, latin extended, greek and cyrillic
+	const u32 ranges[][2] = { { 0x21, 0x7E }, { 0xA1, 0x24F }, { 0x391, 0x3CE }, { 0x400, 0x4FF } };
+	const u32 glyphsPerLine = 64;
+	std::string fontFilename = settings.dataPath + "/fonts/Roboto-Regular.ttf";
+
+	for (u32 size = 10; size <= 30; size += 4)
+	{
+		glyphFonts.push_back(createFont(theme, ("benchGlyphs" + std::to_string(size)).c_str(), fontFilename.c_str(), size));
+	}
+
+	glyphLines.clear();
+
+	std::string line;
+	u32 count = 0;
+
+	for (auto& range : ranges)
+	{
+		for (u32 cp = range[0]; cp <= range[1]; cp++)
+		{
+			appendUtf8(line, cp);
+
+			if (++count % glyphsPerLine == 0)
+			{
+				glyphLines.push_back(line);
+				line.clear();
+			}
+		}
+	}
+
+	if (!line.empty())
+		glyphLines.push_back(line);
+}
+
+static void frameGlyphAtlas(u32 frameIndex)
+{
+	for (auto font : glyphFonts)
+	{
+		for (auto& line : glyphLines)
+		{
+			labelCustomFont(line.c_str(), font);
+		}
+	}
+}
+
+// rounded rectangles, circles, rings and arcs drawn directly, a few thousand per frame
+static void frameShapes(u32 frameIndex)
+{
+	const u32 columnCount = 40;
+	const u32 rowCount = 50;
+	const f32 cellSize = 24;
+	Rect rect = beginCustomWidget(rowCount * cellSize);
+	Shape shape;
+
+	shape.borderColor = Color::gray;
+
+	for (u32 row = 0; row < rowCount; row++)
+	{
+		for (u32 column = 0; column < columnCount; column++)
+		{
+			u32 index = row * columnCount + column;
+
+			shape.type = (ShapeType)(index % 4);
+			shape.cornerRadius = 2 + index % 6;
+			shape.borderWidth = 1 + index % 3;
+			shape.startAngle = (f32)((index + frameIndex) % 64) / 10.0f;
+			shape.endAngle = shape.startAngle + 4.0f;
+			setColor(Color(0.2f, 0.5f, 0.8f, 1.0f));
+			drawShape(shape, { rect.x + column * cellSize + 2, rect.y + row * cellSize + 2, cellSize - 4, cellSize - 4 });
+		}
+	}
+
+	endCustomWidget();
+}
+
+Scenario scenarios[] =
+{
+	{ "labels_10k", setupLabels, frameLabels, nullptr, nullptr, false },
+	{ "cached_labels_10k", setupLabels, frameCachedLabels, nullptr, nullptr, false },
+	{ "nested_columns", nullptr, frameNestedColumns, nullptr, nullptr, false },
+	{ "long_scroll_view", setupScrollView, frameScrollView, nullptr, nullptr, false },
+	{ "dock_panes", setupDockPanes, nullptr, nullptr, teardownDockPanes, true },
+	{ "menus_popups", nullptr, frameMenusAndPopups, inputMenusAndPopups, nullptr, false },
+	{ "multiline_text", setupMultilineText, frameMultilineText, nullptr, nullptr, false },
+	{ "glyph_atlas", setupGlyphAtlas, frameGlyphAtlas, nullptr, nullptr, false },
+	{ "shapes_2k", nullptr, frameShapes, nullptr, nullptr, false }
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Running and reporting
+//////////////////////////////////////////////////////////////////////////
+
+struct TimingSamples
+{
+	std::vector<f64> samples;
+
+	FramePhaseTiming compute()
+	{
+		FramePhaseTiming timing;
+
+		if (samples.empty())
+			return timing;
+
+		std::vector<f64> sorted = samples;
+
+		std::sort(sorted.begin(), sorted.end());
+		timing.min = sorted.front();
+
+		for (auto s : sorted)
+		{
+			timing.average += s;
+		}
+
+		timing.average /= sorted.size();
+		timing.p99 = sorted[(size_t)ceil(sorted.size() * 0.99) - 1];
+
+		return timing;
+	}
+};
+
+struct ScenarioResult
+{
+	TimingSamples frameTime;
+	TimingSamples phaseTime[(u32)FramePhase::Count];
+	TimingSamples allocations;
+	TimingSamples allocatedBytes;
+	FrameStats lastStats;
+	u64 rasterizedGlyphCount = 0;
+	u64 atlasPackCount = 0;
+	u64 textCacheHitCount = 0;
+	u64 textCacheMissCount = 0;
+	u64 textCacheBypassCount = 0;
+	u64 glyphRunCacheHitCount = 0;
+	u64 glyphRunCacheMissCount = 0;
+	u64 redrawnCachedLayerCount = 0;
+	f64 damagedArea = 0;
+};
+
+static void runFrame(Scenario& scenario, u32 frameIndex)
+{
+	processInputEvents();
+
+	if (scenario.input)
+		scenario.input(frameIndex);
+
+	forceRepaint();
+
+	if (scenario.docking)
+	{
+		updateDockingSystem();
+		return;
+	}
+
+	Window wnd = getMainWindow();
+	Rect wndRect = { 0, 0, (f32)settings.width, (f32)settings.height };
+
+	auto doFrame = [&](bool lastEvent)
+	{
+		beginFrame();
+		setWindow(wnd);
+		beginWindow(wnd);
+		setDisableRendering(!lastEvent);
+		clearBackground();
+		beginContainer(wndRect);
+		scenario.frame(frameIndex);
+		endContainer();
+		endWindow();
+		endFrame();
+
+		if (lastEvent)
+			presentWindow(wnd);
+	};
+
+	u32 eventCount = getInputEventCount();
+
+	if (!eventCount)
+	{
+		doFrame(true);
+		return;
+	}
+
+	for (u32 i = 0; i < eventCount; i++)
+	{
+		setInputEvent(getInputEventAt(i));
+		doFrame(i == eventCount - 1);
+	}
+}
+
+static void runScenario(Scenario& scenario, ScenarioResult& result)
+{
+	if (scenario.setup)
+		scenario.setup();
+
+	u32 totalFrames = settings.warmupFrameCount + settings.frameCount;
+
+	for (u32 frame = 0; frame < totalFrames; frame++)
+	{
+		u64 allocationsBefore = allocationCount;
+		u64 bytesBefore = allocatedByteCount;
+		auto start = std::chrono::high_resolution_clock::now();
+
+		runFrame(scenario, frame);
+
+		auto end = std::chrono::high_resolution_clock::now();
+		auto& stats = getFrameStats();
+
+		result.rasterizedGlyphCount += stats.rasterizedGlyphCount;
+		result.atlasPackCount += stats.atlasPackCount;
+
+		if (frame < settings.warmupFrameCount)
+			continue;
+
+		result.frameTime.samples.push_back(std::chrono::duration<f64, std::milli>(end - start).count());
+		result.allocations.samples.push_back((f64)(allocationCount - allocationsBefore));
+		result.allocatedBytes.samples.push_back((f64)(allocatedByteCount - bytesBefore));
+		result.textCacheHitCount += stats.textCacheHitCount;
+		result.textCacheMissCount += stats.textCacheMissCount;
+		result.textCacheBypassCount += stats.textCacheBypassCount;
+		result.glyphRunCacheHitCount += stats.glyphRunCacheHitCount;
+		result.glyphRunCacheMissCount += stats.glyphRunCacheMissCount;
+		result.redrawnCachedLayerCount += stats.redrawnCachedLayerCount;
+		result.damagedArea += stats.damagedArea;
+
+		for (u32 p = 0; p < (u32)FramePhase::Count; p++)
+		{
+			result.phaseTime[p].samples.push_back(stats.phaseTime[p]);
+		}
+
+		result.lastStats = stats;
+	}
+
+	if (scenario.teardown)
+		scenario.teardown();
+}
+
+static void writeTiming(FILE* file, const char* name, TimingSamples& samples, bool last)
+{
+	auto timing = samples.compute();
+
+	fprintf(file, "        \"%s\": { \"min\": %.4f, \"average\": %.4f, \"p99\": %.4f }%s\n",
+		name, timing.min, timing.average, timing.p99, last ? "" : ",");
+}
+
+static void writeResult(FILE* file, Scenario& scenario, ScenarioResult& result, bool last)
+{
+	const char* phaseNames[] = { "widgetBuild", "damage", "tessellate", "merge", "upload", "submit" };
+	auto& stats = result.lastStats;
+	u32 frameCount = settings.frameCount ? settings.frameCount : 1;
+
+	fprintf(file, "    {\n");
+	fprintf(file, "      \"name\": \"%s\",\n", scenario.name);
+	fprintf(file, "      \"frameTime\": { \"min\": %.4f, \"average\": %.4f, \"p99\": %.4f },\n",
+		result.frameTime.compute().min, result.frameTime.compute().average, result.frameTime.compute().p99);
+	fprintf(file, "      \"phases\": {\n");
+
+	for (u32 p = 0; p < (u32)FramePhase::Count; p++)
+	{
+		writeTiming(file, phaseNames[p], result.phaseTime[p], p == (u32)FramePhase::Count - 1);
+	}
+
+	fprintf(file, "      },\n");
+	fprintf(file, "      \"allocationsPerFrame\": { \"min\": %.0f, \"average\": %.2f, \"p99\": %.0f },\n",
+		result.allocations.compute().min, result.allocations.compute().average, result.allocations.compute().p99);
+	fprintf(file, "      \"allocatedBytesPerFrame\": { \"min\": %.0f, \"average\": %.2f, \"p99\": %.0f },\n",
+		result.allocatedBytes.compute().min, result.allocatedBytes.compute().average, result.allocatedBytes.compute().p99);
+	fprintf(file, "      \"drawCommandCount\": %u,\n", stats.drawCommandCount);
+	fprintf(file, "      \"culledDrawCommandCount\": %u,\n", stats.culledDrawCommandCount);
+	fprintf(file, "      \"generatedBatchCount\": %u,\n", stats.generatedBatchCount);
+	fprintf(file, "      \"drawnBatchCount\": %u,\n", stats.drawnBatchCount);
+	fprintf(file, "      \"vertexCount\": %u,\n", stats.vertexCount);
+	fprintf(file, "      \"uploadedByteCount\": %llu,\n", (unsigned long long)stats.uploadedByteCount);
+	fprintf(file, "      \"rasterizedGlyphCount\": %llu,\n", (unsigned long long)result.rasterizedGlyphCount);
+	fprintf(file, "      \"atlasPackCount\": %llu,\n", (unsigned long long)result.atlasPackCount);
+	fprintf(file, "      \"textCacheHitsPerFrame\": %.2f,\n", (f64)result.textCacheHitCount / frameCount);
+	fprintf(file, "      \"textCacheMissesPerFrame\": %.2f,\n", (f64)result.textCacheMissCount / frameCount);
+	fprintf(file, "      \"textCacheBypassesPerFrame\": %.2f,\n", (f64)result.textCacheBypassCount / frameCount);
+	fprintf(file, "      \"glyphRunCacheHitsPerFrame\": %.2f,\n", (f64)result.glyphRunCacheHitCount / frameCount);
+	fprintf(file, "      \"glyphRunCacheMissesPerFrame\": %.2f,\n", (f64)result.glyphRunCacheMissCount / frameCount);
+	fprintf(file, "      \"cachedLayerCount\": %u,\n", stats.cachedLayerCount);
+	fprintf(file, "      \"redrawnCachedLayerCount\": %llu,\n", (unsigned long long)result.redrawnCachedLayerCount);
+	fprintf(file, "      \"damagedAreaPerFrame\": %.2f\n", result.damagedArea / frameCount);
+	fprintf(file, "    }%s\n", last ? "" : ",");
+}
+
+static void printUsage()
+{
+	printf("Usage: horus_bench [options]\n");
+	printf("  --frames N        measured frames per scenario (default 300)\n");
+	printf("  --warmup N        unmeasured frames before each scenario (default 10)\n");
+	printf("  --size WxH        window size (default 1280x720)\n");
+	printf("  --threads N       vertex generation threads, 0 for all hardware threads (default 1)\n");
+	printf("  --software        rasterize the frames instead of discarding the draws\n");
+	printf("  --partial-redraw  only redraw the window areas changed since the previous frame\n");
+	printf("  --shader-clipping clip the vertices in the shader instead of on the CPU\n");
+	printf("  --tessellate-shapes draw the shapes as triangles instead of single quads evaluated in the shader\n");
+	printf("  --no-glyph-run-cache look up each glyph and kerning pair when drawing the texts\n");
+	printf("  --distance-field-glyphs render the fonts from a signed distance field glyph atlas\n");
+	printf("  --data PATH       the themes folder (default ../themes)\n");
+	printf("  --scenario NAME   run only this scenario\n");
+	printf("  --output FILE     write the JSON to this file instead of stdout\n");
+	printf("Scenarios:");
+
+	for (auto& scenario : scenarios)
+	{
+		printf(" %s", scenario.name);
+	}
+
+	printf("\n");
+}
+
+static bool parseArgs(int argc, char** args)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = args[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--frames" && hasValue) settings.frameCount = atoi(args[++i]);
+		else if (arg == "--warmup" && hasValue) settings.warmupFrameCount = atoi(args[++i]);
+		else if (arg == "--size" && hasValue) sscanf(args[++i], "%ux%u", &settings.width, &settings.height);
+		else if (arg == "--threads" && hasValue) settings.threadCount = atoi(args[++i]);
+		else if (arg == "--software") settings.software = true;
+		else if (arg == "--partial-redraw") settings.partialRedraw = true;
+		else if (arg == "--shader-clipping") settings.shaderClipping = true;
+		else if (arg == "--tessellate-shapes") settings.tessellateShapes = true;
+		else if (arg == "--no-glyph-run-cache") settings.noGlyphRunCache = true;
+		else if (arg == "--distance-field-glyphs") settings.distanceFieldGlyphs = true;
+		else if (arg == "--data" && hasValue) settings.dataPath = args[++i];
+		else if (arg == "--scenario" && hasValue) settings.scenarioName = args[++i];
+		else if (arg == "--output" && hasValue) settings.outputFilename = args[++i];
+		else return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** args)
+{
+	if (!parseArgs(argc, args))
+	{
+		printUsage();
+		return 1;
+	}
+
+	inputProvider = new NullInputProvider();
+	gfxProvider = new HeadlessGraphicsProvider(settings.software ? HeadlessRenderMode::Software : HeadlessRenderMode::Null);
+
+	auto ctx = createContext(inputProvider, gfxProvider);
+
+	getContextSettings().vertexGenerationThreadCount = settings.threadCount;
+	getContextSettings().partialRedraw = settings.partialRedraw;
+	getContextSettings().shaderClipping = settings.shaderClipping;
+	getContextSettings().shaderShapes = !settings.tessellateShapes;
+	getContextSettings().glyphRunCache = !settings.noGlyphRunCache;
+	getContextSettings().distanceFieldGlyphs = settings.distanceFieldGlyphs;
+	inputProvider->createWindow("horus_bench", settings.width, settings.height);
+	gfxProvider->initialize();
+	initializeContext(ctx);
+
+	theme = loadTheme((settings.dataPath + "/default.theme").c_str());
+
+	if (!theme)
+	{
+		fprintf(stderr, "Cannot load the theme from '%s'\n", settings.dataPath.c_str());
+		return 1;
+	}
+
+	setTheme(theme);
+
+	FILE* file = settings.outputFilename.empty() ? stdout : fopen(settings.outputFilename.c_str(), "w");
+
+	if (!file)
+	{
+		fprintf(stderr, "Cannot write '%s'\n", settings.outputFilename.c_str());
+		return 1;
+	}
+
+	std::vector<Scenario*> selected;
+
+	for (auto& scenario : scenarios)
+	{
+		if (settings.scenarioName.empty() || settings.scenarioName == scenario.name)
+			selected.push_back(&scenario);
+	}
+
+	if (selected.empty())
+	{
+		fprintf(stderr, "Unknown scenario '%s'\n", settings.scenarioName.c_str());
+		printUsage();
+		return 1;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"frameCount\": %u,\n", settings.frameCount);
+	fprintf(file, "  \"warmupFrameCount\": %u,\n", settings.warmupFrameCount);
+	fprintf(file, "  \"width\": %u,\n", settings.width);
+	fprintf(file, "  \"height\": %u,\n", settings.height);
+	fprintf(file, "  \"vertexGenerationThreadCount\": %u,\n", settings.threadCount);
+	fprintf(file, "  \"renderMode\": \"%s\",\n", settings.software ? "software" : "null");
+	fprintf(file, "  \"partialRedraw\": %s,\n", settings.partialRedraw ? "true" : "false");
+	fprintf(file, "  \"shaderClipping\": %s,\n", settings.shaderClipping ? "true" : "false");
+	fprintf(file, "  \"shaderShapes\": %s,\n", settings.tessellateShapes ? "false" : "true");
+	fprintf(file, "  \"glyphRunCache\": %s,\n", settings.noGlyphRunCache ? "false" : "true");
+	fprintf(file, "  \"distanceFieldGlyphs\": %s,\n", settings.distanceFieldGlyphs ? "true" : "false");
+	fprintf(file, "  \"scenarios\": [\n");
+
+	for (size_t i = 0; i < selected.size(); i++)
+	{
+		ScenarioResult result;
+
+		fprintf(stderr, "Running %s...\n", selected[i]->name);
+		runScenario(*selected[i], result);
+		writeResult(file, *selected[i], result, i == selected.size() - 1);
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	if (file != stdout)
+		fclose(file);
+
+	shutdown();
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+project "horus_bench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++11"
+
+	warnings "off"
+	files {
+		"../../examples/common/headless_graphics_provider.*",
+		"../../examples/common/null_input_provider.*",
+		"*.cpp"
+	}
+
+	includedirs {
+		".",
+		"../../include",
+		"../../examples/common"
+	}
+
+	defines "_CONSOLE"
+
+	-- linked statically, so the library's allocations are counted by the bench's operator new
+	using { "horus_static" }
+	distcopy(mytarget())
\ No newline at end of file
@@ -0,0 +1,3 @@
+include "quad_clip_bench"
+include "horus_bench"
+include "draw_command_replay"
\ No newline at end of file
@@ -0,0 +1,76 @@
+// Compares the SIMD quad clipper against the scalar path, on random quads, some of them clipped or outside
+#include "quad_clipper.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace hui;
+
+typedef u32 (*ClipFunction)(const Rect*, const Rect*, const u32*, u32, const Rect&, u32, Vertex*);
+
+static f64 timeClipper(
+	ClipFunction clip, u32 iterations,
+	const std::vector<Rect>& rects, const std::vector<Rect>& uvRects, const std::vector<u32>& textureIndices,
+	const Rect& clipRect, std::vector<Vertex>& vertices, u32& outQuadCount)
+{
+	const u32 runLength = 64; // the renderer clips quads in runs of this size
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (u32 iter = 0; iter < iterations; iter++)
+	{
+		u32 quadCount = 0;
+
+		for (u32 i = 0; i < rects.size(); i += runLength)
+		{
+			u32 count = std::min(runLength, (u32)rects.size() - i);
+
+			quadCount += clip(
+				&rects[i], &uvRects[i], &textureIndices[i], count,
+				clipRect, 0xffffffff, &vertices[quadCount * 4]);
+		}
+
+		outQuadCount = quadCount;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<f64, std::nano>(end - start).count() / ((f64)iterations * rects.size());
+}
+
+int main(int argc, char** args)
+{
+	const u32 quadCount = argc > 2 ? atoi(args[2]) : 100000;
+	const u32 iterations = argc > 1 ? atoi(args[1]) : 200;
+	const Rect clipRect = { 100, 100, 1720, 880 };
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<f32> posX(0, 1920), posY(0, 1080), size(1, 64), uv(0, 0.9f);
+	std::vector<Rect> rects(quadCount), uvRects(quadCount);
+	std::vector<u32> textureIndices(quadCount);
+
+	for (u32 i = 0; i < quadCount; i++)
+	{
+		rects[i] = { posX(rng), posY(rng), size(rng), size(rng) };
+		uvRects[i] = { uv(rng), uv(rng), 0.1f, 0.1f };
+		textureIndices[i] = i % 4;
+	}
+
+	std::vector<Vertex> scalarVertices(quadCount * 4), simdVertices(quadCount * 4);
+	u32 scalarQuadCount = 0, simdQuadCount = 0;
+
+	f64 scalarTime = timeClipper(clipAndEmitQuadsScalar, iterations, rects, uvRects, textureIndices, clipRect, scalarVertices, scalarQuadCount);
+	f64 simdTime = timeClipper(clipAndEmitQuads, iterations, rects, uvRects, textureIndices, clipRect, simdVertices, simdQuadCount);
+
+	bool same = scalarQuadCount == simdQuadCount
+		&& !memcmp(scalarVertices.data(), simdVertices.data(), scalarQuadCount * 4 * sizeof(Vertex));
+
+	printf("Quads: %u, visible: %u, iterations: %u\n", quadCount, scalarQuadCount, iterations);
+	printf("Scalar: %.3f ns/quad\n", scalarTime);
+	printf("%s: %.3f ns/quad\n", getQuadClipperInstructionSet(), simdTime);
+	printf("Speedup: %.2fx\n", scalarTime / simdTime);
+	printf("Output: %s\n", same ? "identical" : "MISMATCH");
+
+	return same ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+project "quad_clip_bench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++11"
+
+	warnings "off"
+	files {
+		"../../src/quad_clipper.h",
+		"../../src/quad_clipper.cpp",
+		"*.cpp"
+	}
+
+	includedirs {
+		".",
+		"../../include",
+		"../../src"
+	}
+
+	defines { "_CONSOLE", "HORUS_STATIC" }
+
+	distcopy(mytarget())
\ No newline at end of file